@@ -0,0 +1,35 @@
+// assembler.cpp - Ensambla un programa ASM a imagen binaria (.pimg)
+//   ./assembler dotprod.asm [dotprod.pimg]
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "parser.h"
+#include "program_image.h"
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Uso: " << argv[0] << " <programa.asm> [salida.pimg]\n";
+        return 1;
+    }
+    std::string in_path = argv[1];
+    std::string out_path;
+    if (argc >= 3) {
+        out_path = argv[2];
+    } else {
+        size_t dot = in_path.rfind('.');
+        out_path = (dot == std::string::npos ? in_path : in_path.substr(0, dot)) + ".pimg";
+    }
+
+    std::vector<Instr> prog;
+    std::unordered_map<std::string,size_t> labels;
+    if (!load_program_file(in_path, prog, labels)) return 1;
+    if (!write_program_image(out_path, prog, labels)) {
+        std::cerr << "Error: no se pudo escribir " << out_path << "\n";
+        return 1;
+    }
+    std::cout << in_path << " -> " << out_path << " (" << prog.size()
+              << " instrucciones, " << labels.size() << " etiquetas)\n";
+    return 0;
+}
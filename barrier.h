@@ -0,0 +1,84 @@
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+// BARRERA ENTRE PEs - una por sistema, la usa la instruccion BARRIER.
+// Por generaciones: el PE que llega anota la generacion actual y espera (sin
+// avanzar el PC) a que cambie. Un PE que ejecuta HALT abandona la barrera,
+// como std::barrier::arrive_and_drop: los que terminan antes no bloquean a
+// los demas. Sirve igual con un hilo por PE o paso a paso round-robin.
+class Barrier {
+public:
+    explicit Barrier(unsigned parties = 0) : parties_(parties) {}
+
+    // Nuevo conjunto de participantes (reinicio del sistema)
+    void reset(unsigned parties) {
+        std::lock_guard<std::mutex> lk(mtx_);
+        parties_ = parties;
+        arrived_ = 0;
+    }
+
+    // Llega un PE: devuelve la generacion a esperar con passed()
+    uint32_t arrive() {
+        std::lock_guard<std::mutex> lk(mtx_);
+        const uint32_t gen = generation_.load(std::memory_order_relaxed);
+        if (++arrived_ >= parties_) release();
+        return gen;
+    }
+
+    // Un PE se detuvo: deja de contar para esta y las siguientes rondas
+    void drop() {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (parties_) --parties_;
+        if (arrived_ && arrived_ >= parties_) release();
+    }
+
+    bool passed(uint32_t gen) const {
+        return generation_.load(std::memory_order_acquire) != gen;
+    }
+
+    unsigned waiting() const {   // PEs detenidos en la ronda actual
+        std::lock_guard<std::mutex> lk(mtx_);
+        return arrived_;
+    }
+
+    // Estado completo, para deshacer pasos (undo.hpp) sin PEs ejecutando
+    struct State {
+        unsigned parties = 0, arrived = 0;
+        uint32_t generation = 0;
+    };
+    State state() const {
+        std::lock_guard<std::mutex> lk(mtx_);
+        return State{parties_, arrived_, generation_.load(std::memory_order_relaxed)};
+    }
+    void restore(const State& s) {
+        std::lock_guard<std::mutex> lk(mtx_);
+        parties_ = s.parties;
+        arrived_ = s.arrived;
+        generation_.store(s.generation, std::memory_order_release);
+    }
+
+private:
+    void release() {
+        arrived_ = 0;
+        generation_.fetch_add(1, std::memory_order_release);
+    }
+
+    mutable std::mutex mtx_;
+    unsigned parties_;
+    unsigned arrived_ = 0;
+    std::atomic<uint32_t> generation_{0};
+};
+
+// Ranuras de S[] para la reduccion en arbol: P redondeado a potencia de 2.
+// Las que no tienen PE quedan en cero y hacen de socio neutro
+inline unsigned reduction_slots(unsigned num_pes) {
+    unsigned s = 1;
+    while (s < num_pes) s <<= 1;
+    return s;
+}
+
+#endif
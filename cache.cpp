@@ -1,5 +1,6 @@
 // cache.cpp
 #include "cache.hpp"
+#include "l2_cache.hpp"
 
 // Definir el mutex global
 std::mutex io_mtx;
@@ -24,22 +25,36 @@ void Interconnect::register_cache(Cache* c) {
 }
 
 SnoopSummary Interconnect::broadcast(const BusMessage& msg, Cache* origin) {
-    std::unique_lock<std::mutex> buslk(bus_mutex_);
-    std::vector<Cache*> local;
-    {
-        std::lock_guard<std::mutex> lk(m_);
-        local = caches_;
-    }
+    // El llamador ya tiene el bus (acquire), asi el snoop y su llenado son atomicos
+    std::lock_guard<std::mutex> lk(m_);
     SnoopSummary sum{};
-    for (auto* c : local) {
+    for (auto* c : caches_) {
         if (c == origin) continue;
         auto resp = c->snoop(msg);
+        // Una copia (o llenado en vuelo) que pierde un BusRdX/BusUpgr queda invalidada
+        if (resp.had_copy && (msg.cmd == BusCmd::BusRdX || msg.cmd == BusCmd::BusUpgr))
+            sharing_.invalidated(Address::block_base(msg.addr), c->pe_id(), msg.src_pe);
         sum.shared_seen = sum.shared_seen || resp.had_copy;
         sum.mod_seen    = sum.mod_seen    || resp.wrote_back;
     }
     return sum;
 }
 
+uint32_t Interconnect::back_invalidate(uint64_t block_addr, uint32_t& writebacks) {
+    std::lock_guard<std::mutex> lk(m_);
+    uint32_t copies = 0;
+    for (auto* c : caches_) {
+        const SnoopResponse r = c->back_invalidate(block_addr);
+        copies += r.had_copy;
+        writebacks += r.wrote_back;
+    }
+    return copies;
+}
+
+void Interconnect::settle_l2() {
+    l2_->settle();
+}
+
 void Interconnect::flush_all() {
     std::unique_lock<std::mutex> buslk(bus_mutex_);
     std::vector<Cache*> local;
@@ -56,114 +71,474 @@ Cache::Cache(int pe_id, IMemory* mem, Interconnect* ic)
     sets_.resize(hw::kSets);
     for (auto& set : sets_) set.fill(CacheLine{});
     stats_ = Stats{};
+    const uint64_t mem_bytes = mem_ ? mem_->size_bytes() : UINT64_MAX;
+    if (mem_bytes != UINT64_MAX) heat_ = std::vector<BlockHeat>(mem_bytes / hw::kBlockBytes);
     if (ic_) ic_->register_cache(this);
 }
 
-double Cache::read_double(uint64_t addr) {
-    uint32_t set_idx;
-    uint32_t way;
+double Cache::read_double(uint64_t addr, int pc) {
+    double v;
+    read_line(addr, &v, 1, pc);
+    return v;
+}
+
+void Cache::write_double(uint64_t addr, double value, int pc) {
+    write_line(addr, &value, 1, pc);
+}
+
+void Cache::read_line(uint64_t addr, double* out, uint32_t n, int pc) {
+    Access a = do_read(addr, out, n);
+    if (prefetcher_) run_prefetcher(pc, addr, a);
+}
+
+void Cache::write_line(uint64_t addr, const double* in, uint32_t n, int pc) {
+    Access a = do_write(addr, in, n);
+    if (prefetcher_) run_prefetcher(pc, addr, a);
+}
+
+MshrRef Cache::read_double_nb(uint64_t addr, double* dst, int pc) {
+    MshrRef ref;
+    Access a = do_read_nb(addr, dst, ref);
+    if (prefetcher_) run_prefetcher(pc, addr, a);
+    return ref;
+}
+
+Cache::Access Cache::do_read(uint64_t addr, double* out, uint32_t n) {
+    assert(Address::split(addr).offset + n * 8 <= hw::kBlockBytes);
+    stats_.read_ops++;
+    ++tick_;
+    count_heat(&BlockHeat::accesses, addr);
+    if (mshrs_busy_) retire_ready();
+    auto f = Address::split(addr);
+    const bool shadow_hit = miss_class_.access(Address::block_base(addr));
+    bool late = mshrs_busy_ ? settle_set(f.index, f.tag) : false;
     {
-        std::lock_guard<std::mutex> lk(m_);
-        stats_.read_ops++;
-        auto f = Address::split(addr);
-        auto [hit, sidx, w] = probe(f.tag, f.index);
-        set_idx = sidx;
-        way = w;
+        // Camino de acierto: solo el candado del set, sin tocar el bus
+        std::lock_guard<std::mutex> lk(set_lock(f.index));
+        auto [hit, set_idx, way] = probe(f.tag, f.index);
         if (hit) {
-            mark_recent(set_idx, way);
-            return load_from_line(set_idx, way, f.offset);
+            bool pf = touch(set_idx, way);
+            for (uint32_t i = 0; i < n; ++i) out[i] = load_from_line(set_idx, way, f.offset + 8 * i);
+            return (pf || late) ? Access::PrefetchHit : Access::Hit;
         }
-        stats_.misses++;
     }
-
+    stats_.misses++;
+    classify_miss(addr, shadow_hit);
+    if (ic_) ic_->sharing().missed(addr, n, pe_id_);
+
+    // Fallo: el bus queda tomado hasta instalar la linea. Solo este PE llena
+    // su cache, asi que el fallo sigue siendo fallo al re-tomar el set
+    Interconnect::BusLock buslk;
+    if (ic_) buslk = ic_->acquire();
     BusMessage m{BusCmd::BusRd, addr, pe_id_};
     stats_.bus_msgs++;
     SnoopSummary sum = ic_ ? ic_->broadcast(m, this) : SnoopSummary{};
 
-    std::lock_guard<std::mutex> lk(m_);
-    auto f2 = Address::split(addr);
+    std::lock_guard<std::mutex> lk(set_lock(f.index));
+    uint32_t set_idx = f.index;
     uint32_t victim = victim_index(set_idx);
     evict_if_dirty(set_idx, victim);
     fill_from_mem(addr, set_idx, victim);
 
     MESI new_state = sum.shared_seen ? MESI::Shared : MESI::Exclusive;
     MESI old_state = sets_[set_idx][victim].state;
-    record_transition(set_idx, victim, old_state, new_state, f2.tag, addr);
+    record_transition(set_idx, victim, old_state, new_state, f.tag, addr);
     sets_[set_idx][victim].state = new_state;
-    sets_[set_idx][victim].tag = f2.tag;
+    sets_[set_idx][victim].tag = f.tag;
     mark_recent(set_idx, victim);
 
-    return load_from_line(set_idx, victim, f2.offset);
+    for (uint32_t i = 0; i < n; ++i) out[i] = load_from_line(set_idx, victim, f.offset + 8 * i);
+    return Access::Miss;
 }
 
-void Cache::write_double(uint64_t addr, double value) {
-    uint32_t set_idx;
-    uint32_t way;
-    MESI cur_state = MESI::Invalid;
+Cache::Access Cache::do_write(uint64_t addr, const double* in, uint32_t n) {
+    assert(Address::split(addr).offset + n * 8 <= hw::kBlockBytes);
+    stats_.write_ops++;
+    ++tick_;
+    count_heat(&BlockHeat::accesses, addr);
+    if (mshrs_busy_) retire_ready();
+    auto f = Address::split(addr);
+    const bool shadow_hit = miss_class_.access(Address::block_base(addr));
+    bool late = mshrs_busy_ ? settle_set(f.index, f.tag) : false;
     {
-        std::lock_guard<std::mutex> lk(m_);
-        stats_.write_ops++;
-        auto f = Address::split(addr);
-        auto [hit, sidx, w] = probe(f.tag, f.index);
-        set_idx = sidx;
-        way = w;
-        if (hit) {
-            cur_state = sets_[set_idx][way].state;
-            if (cur_state == MESI::Exclusive) {
+        // Camino de acierto en E/M: no genera trafico de bus
+        std::lock_guard<std::mutex> lk(set_lock(f.index));
+        auto [hit, set_idx, way] = probe(f.tag, f.index);
+        if (hit && sets_[set_idx][way].state != MESI::Shared) {
+            if (sets_[set_idx][way].state == MESI::Exclusive) {
                 record_transition(set_idx, way, MESI::Exclusive, MESI::Modified, f.tag, addr);
                 sets_[set_idx][way].state = MESI::Modified;
             }
-            if (cur_state != MESI::Shared) {
-                store_into_line(set_idx, way, f.offset, value);
-                mark_recent(set_idx, way);
-                return;
-            }
+            for (uint32_t i = 0; i < n; ++i) store_into_line(set_idx, way, f.offset + 8 * i, in[i]);
+            if (ic_) ic_->sharing().wrote(addr, n, pe_id_);
+            bool pf = touch(set_idx, way);
+            return (pf || late) ? Access::PrefetchHit : Access::Hit;
         }
-        stats_.misses++;
     }
+    stats_.misses++;
+
+    // S o fallo: hace falta propiedad exclusiva. Con el bus tomado nadie mas
+    // puede cambiar nuestras lineas, pero entre el acierto y aqui un BusRdX/BusUpgr
+    // remoto pudo invalidar la copia S: se vuelve a sondear antes de decidir
+    Interconnect::BusLock buslk;
+    if (ic_) buslk = ic_->acquire();
+    std::lock_guard<std::mutex> lk(set_lock(f.index));
+    auto [hit, set_idx, way] = probe(f.tag, f.index);
 
-    auto f2 = Address::split(addr);
-    if (cur_state == MESI::Shared) {
+    if (hit) {
         BusMessage m{BusCmd::BusUpgr, addr, pe_id_};
         stats_.bus_msgs++;
+        count_miss(addr, MissKind::Coherence);
         if (ic_) ic_->broadcast(m, this);
-        
-        std::lock_guard<std::mutex> lk(m_);
-        auto [hit2, sidx2, w2] = probe(f2.tag, f2.index);
-        uint32_t use_way = hit2 ? w2 : victim_index(sidx2);
-        record_transition(sidx2, use_way, MESI::Shared, MESI::Modified, f2.tag, addr);
-        sets_[sidx2][use_way].state = MESI::Modified;
-        sets_[sidx2][use_way].tag = f2.tag;
-        store_into_line(sidx2, use_way, f2.offset, value);
-        mark_recent(sidx2, use_way);
-        return;
+
+        record_transition(set_idx, way, MESI::Shared, MESI::Modified, f.tag, addr);
+        sets_[set_idx][way].state = MESI::Modified;
+        for (uint32_t i = 0; i < n; ++i) store_into_line(set_idx, way, f.offset + 8 * i, in[i]);
+        if (ic_) ic_->sharing().wrote(addr, n, pe_id_);
+        bool pf = touch(set_idx, way);
+        return (pf || late) ? Access::PrefetchHit : Access::Miss;
     } else {
         BusMessage m{BusCmd::BusRdX, addr, pe_id_};
         stats_.bus_msgs++;
+        classify_miss(addr, shadow_hit);
+        if (ic_) {
+            ic_->sharing().missed(addr, n, pe_id_);
+            ic_->broadcast(m, this);
+        }
+
+        uint32_t victim = victim_index(set_idx);
+        evict_if_dirty(set_idx, victim);
+        fill_from_mem(addr, set_idx, victim);
+        MESI old_state = sets_[set_idx][victim].state;
+        record_transition(set_idx, victim, old_state, MESI::Modified, f.tag, addr);
+        sets_[set_idx][victim].state = MESI::Modified;
+        sets_[set_idx][victim].tag = f.tag;
+        for (uint32_t i = 0; i < n; ++i) store_into_line(set_idx, victim, f.offset + 8 * i, in[i]);
+        if (ic_) ic_->sharing().wrote(addr, n, pe_id_);
+        mark_recent(set_idx, victim);
+        return Access::Miss;
+    }
+}
+
+double Cache::fetch_add(uint64_t addr, double delta, int pc) {
+    double old = 0.0;
+    Access a = do_rmw(addr, [&](double& v) { old = v; v += delta; return true; });
+    if (prefetcher_) run_prefetcher(pc, addr, a);
+    return old;
+}
+
+bool Cache::compare_swap(uint64_t addr, double expected, double desired, int pc) {
+    bool swapped = false;
+    Access a = do_rmw(addr, [&](double& v) {
+        swapped = (v == expected);
+        if (swapped) v = desired;
+        return swapped;
+    });
+    if (!swapped) stats_.cas_failures++;
+    if (prefetcher_) run_prefetcher(pc, addr, a);
+    return swapped;
+}
+
+double Cache::load_linked(uint64_t addr, int pc) {
+    // La reserva se toma antes de leer: una escritura remota entre medio la
+    // rompe (el SC falla de mas, nunca de menos)
+    stats_.atomic_ops++;
+    link_.store(Address::block_base(addr), std::memory_order_release);
+    return read_double(addr, pc);
+}
+
+void Cache::break_link(uint64_t block_addr) {
+    if (link_.compare_exchange_strong(block_addr, kNoLink, std::memory_order_acq_rel)) stats_.link_breaks++;
+}
+
+bool Cache::store_conditional(uint64_t addr, double value, int pc) {
+    const uint64_t blk = Address::block_base(addr);
+    // Sin reserva falla sin trafico de bus
+    if (link_.load(std::memory_order_acquire) != blk) {
+        link_.store(kNoLink, std::memory_order_release);
+        stats_.atomic_ops++;
+        stats_.sc_failures++;
+        return false;
+    }
+    // Se consume la reserva con la linea tomada: un snoop al mismo bloque
+    // pudo romperla mientras se pedia la exclusividad
+    bool stored = false;
+    Access a = do_rmw(addr, [&](double& v) {
+        stored = link_.exchange(kNoLink, std::memory_order_acq_rel) == blk;
+        if (stored) v = value;
+        return stored;
+    });
+    if (!stored) stats_.sc_failures++;
+    if (prefetcher_) run_prefetcher(pc, addr, a);
+    return stored;
+}
+
+Cache::Access Cache::do_rmw(uint64_t addr, const std::function<bool(double&)>& op) {
+    stats_.atomic_ops++;
+    ++tick_;
+    count_heat(&BlockHeat::accesses, addr);
+    if (mshrs_busy_) retire_ready();
+    auto f = Address::split(addr);
+    const bool shadow_hit = miss_class_.access(Address::block_base(addr));
+    bool late = mshrs_busy_ ? settle_set(f.index, f.tag) : false;
+    auto apply = [&](uint32_t set_idx, uint32_t way) {
+        double v = load_from_line(set_idx, way, f.offset);
+        if (!op(v)) return;
+        auto& line = sets_[set_idx][way];
+        if (line.state != MESI::Modified) {
+            record_transition(set_idx, way, line.state, MESI::Modified, f.tag, addr);
+            line.state = MESI::Modified;
+        }
+        store_into_line(set_idx, way, f.offset, v);
+        if (ic_) ic_->sharing().wrote(addr, 1, pe_id_);
+    };
+    {
+        // Acierto en E/M: el candado del set basta (los snoops tambien lo toman)
+        std::lock_guard<std::mutex> lk(set_lock(f.index));
+        auto [hit, set_idx, way] = probe(f.tag, f.index);
+        if (hit && sets_[set_idx][way].state != MESI::Shared) {
+            apply(set_idx, way);
+            bool pf = touch(set_idx, way);
+            return (pf || late) ? Access::PrefetchHit : Access::Hit;
+        }
+    }
+    stats_.misses++;
+    stats_.atomic_misses++;
+
+    // S o fallo: exclusividad por el bus, como do_write, pero la escritura
+    // depende del valor leido con el bus aun tomado
+    Interconnect::BusLock buslk;
+    if (ic_) buslk = ic_->acquire();
+    std::lock_guard<std::mutex> lk(set_lock(f.index));
+    auto [hit, set_idx, way] = probe(f.tag, f.index);
+    stats_.bus_msgs++;
+    if (hit) {
+        BusMessage m{BusCmd::BusUpgr, addr, pe_id_};
+        count_miss(addr, MissKind::Coherence);
         if (ic_) ic_->broadcast(m, this);
+        record_transition(set_idx, way, sets_[set_idx][way].state, MESI::Exclusive, f.tag, addr);
+        sets_[set_idx][way].state = MESI::Exclusive;
+    } else {
+        BusMessage m{BusCmd::BusRdX, addr, pe_id_};
+        classify_miss(addr, shadow_hit);
+        if (ic_) {
+            ic_->sharing().missed(addr, 1, pe_id_);
+            ic_->broadcast(m, this);
+        }
+        way = victim_index(set_idx);
+        evict_if_dirty(set_idx, way);
+        fill_from_mem(addr, set_idx, way);
+        record_transition(set_idx, way, sets_[set_idx][way].state, MESI::Exclusive, f.tag, addr);
+        sets_[set_idx][way].state = MESI::Exclusive;
+        sets_[set_idx][way].tag = f.tag;
+    }
+    apply(set_idx, way);
+    mark_recent(set_idx, way);
+    return Access::Miss;
+}
 
-        std::lock_guard<std::mutex> lk(m_);
-        auto [hit3, sidx3, w3] = probe(f2.tag, f2.index);
-        uint32_t victim = victim_index(sidx3);
-        evict_if_dirty(sidx3, victim);
-        fill_from_mem(addr, sidx3, victim);
-        MESI old_state = sets_[sidx3][victim].state;
-        record_transition(sidx3, victim, old_state, MESI::Modified, f2.tag, addr);
-        sets_[sidx3][victim].state = MESI::Modified;
-        sets_[sidx3][victim].tag = f2.tag;
-        store_into_line(sidx3, victim, f2.offset, value);
-        mark_recent(sidx3, victim);
-        return;
+Cache::Access Cache::do_read_nb(uint64_t addr, double* dst, MshrRef& ref) {
+    stats_.read_ops++;
+    ++tick_;
+    count_heat(&BlockHeat::accesses, addr);
+    if (mshrs_busy_) retire_ready();
+    auto f = Address::split(addr);
+    const bool shadow_hit = miss_class_.access(Address::block_base(addr));
+    for (;;) {
+        int killed = -1;
+        {
+            std::lock_guard<std::mutex> lk(set_lock(f.index));
+            auto [hit, set_idx, way] = probe(f.tag, f.index);
+            if (hit) {
+                bool pf = touch(set_idx, way);
+                *dst = load_from_line(set_idx, way, f.offset);
+                return pf ? Access::PrefetchHit : Access::Hit;
+            }
+            // Fallo secundario: se une al MSHR del mismo bloque si sigue vivo
+            for (uint32_t w = 0; w < hw::kWays; ++w) {
+                const auto& pl = sets_[f.index][w];
+                if (!pl.pending || pl.tag != f.tag) continue;
+                int idx = find_mshr(f.index, w);
+                if (pl.fill_state == MESI::Invalid) { killed = idx; break; }
+                auto& e = mshrs_[idx];
+                stats_.mshr_merges++;
+                e.targets.push_back({dst, f.offset});
+                ref = {idx, e.gen};
+                if (!e.prefetch) return Access::Miss;
+                stats_.prefetch_late++;  // El prefetch acerto pero no llego a tiempo
+                e.prefetch = false;
+                return Access::PrefetchHit;
+            }
+        }
+        if (killed < 0) break;
+        // Otro PE pidio exclusividad despues de emitir el fallo: este acceso
+        // es posterior y no puede usar ese dato, se reintenta como fallo nuevo
+        complete_mshr(killed);
+    }
+    stats_.misses++;
+    classify_miss(addr, shadow_hit);
+    if (ic_) ic_->sharing().missed(addr, 1, pe_id_);
+
+    // Hace falta una entrada MSHR libre y una via sin llenado en vuelo
+    if (mshrs_busy_ == hw::kMshrs) {
+        stats_.mshr_full++;
+        int oldest = 0;
+        for (int i = 1; i < int(hw::kMshrs); ++i)
+            if (mshrs_[i].seq < mshrs_[oldest].seq) oldest = i;
+        complete_mshr(oldest);
+    }
+    settle_set(f.index, f.tag);
+
+    int idx = issue_fill(addr);
+    mshrs_[idx].targets.assign(1, {dst, f.offset});
+    ref = {idx, mshrs_[idx].gen};
+    return Access::Miss;
+}
+
+int Cache::issue_fill(uint64_t addr) {
+    auto f = Address::split(addr);
+    Interconnect::BusLock buslk;
+    if (ic_) buslk = ic_->acquire();
+    BusMessage m{BusCmd::BusRd, addr, pe_id_};
+    stats_.bus_msgs++;
+    SnoopSummary sum = ic_ ? ic_->broadcast(m, this) : SnoopSummary{};
+
+    int idx = 0;
+    while (mshrs_[idx].valid) ++idx;
+    auto& e = mshrs_[idx];
+    {
+        std::lock_guard<std::mutex> lk(set_lock(f.index));
+        uint32_t victim = victim_index(f.index);
+        evict_if_dirty(f.index, victim);
+        auto& line = sets_[f.index][victim];
+        line.pending = true;
+        line.tag = f.tag;
+        line.fill_state = sum.shared_seen ? MESI::Shared : MESI::Exclusive;
+        mark_recent(f.index, victim);
+        // La lectura se encola con el bus tomado: cualquier write-back posterior
+        // de este bloque queda detras en la cola de la memoria
+        e.fill = mem_->readBlockAsync(Address::block_base(addr)).share();
+        e.way = victim;
     }
+    e.valid = true;
+    e.prefetch = false;
+    e.block_addr = Address::block_base(addr);
+    e.set = f.index;
+    e.seq = mshr_seq_++;
+    e.issued = tick_;
+    e.targets.clear();
+    mshrs_busy_++;
+    return idx;
+}
+
+void Cache::set_prefetcher(std::unique_ptr<Prefetcher> p) {
+    prefetcher_ = std::move(p);
+}
+
+void Cache::run_prefetcher(int pc, uint64_t addr, Access a) {
+    pf_candidates_.clear();
+    prefetcher_->on_access(pc, addr, a == Access::Miss, a == Access::PrefetchHit, pf_candidates_);
+    for (uint64_t block : pf_candidates_) issue_prefetch(block);
+}
+
+void Cache::issue_prefetch(uint64_t block_addr) {
+    if (block_addr + hw::kBlockBytes > mem_->size_bytes()) return;
+    auto f = Address::split(block_addr);
+    {
+        std::lock_guard<std::mutex> lk(set_lock(f.index));
+        bool way_busy = false;
+        for (uint32_t w = 0; w < hw::kWays; ++w) {
+            const auto& l = sets_[f.index][w];
+            if ((l.state != MESI::Invalid || l.pending) && l.tag == f.tag) return; // Ya esta
+            way_busy = way_busy || l.pending;
+        }
+        // Un prefetch nunca espera: sin MSHR libre o con el set ocupado se descarta
+        if (way_busy || mshrs_busy_ == hw::kMshrs) {
+            stats_.prefetch_dropped++;
+            return;
+        }
+    }
+    int idx = issue_fill(block_addr);
+    mshrs_[idx].prefetch = true;
+    stats_.prefetches++;
+    if (ic_) ic_->sharing().refetched(block_addr, pe_id_);
+    miss_class_.refilled(block_addr);  // El fallo de coherencia no llega a ocurrir
+}
+
+SnoopResponse Cache::back_invalidate(uint64_t block_addr) {
+    auto f = Address::split(block_addr);
+    std::lock_guard<std::mutex> lk(set_lock(f.index));
+    break_link(block_addr);  // La L1 pierde el bloque: otro PE podria escribirlo en silencio
+    SnoopResponse resp;
+    for (uint32_t w = 0; w < hw::kWays; ++w) {
+        auto& line = sets_[f.index][w];
+        if (line.tag != f.tag) continue;
+        if (line.pending) {
+            // Se completa igual (sus destinos ya leyeron el bloque) pero sin instalarse
+            if (line.fill_state != MESI::Invalid) resp.had_copy = true;
+            line.fill_state = MESI::Invalid;
+            continue;
+        }
+        if (line.state == MESI::Invalid) continue;
+        resp.had_copy = true;
+        if (line.state == MESI::Modified) {
+            writeback_line(f.index, w, block_addr);  // Sigue a memoria: el bloque ya no esta en la L2
+            resp.wrote_back = true;
+        }
+        if (line.prefetched) stats_.prefetch_useless++;
+        line.prefetched = false;
+        record_transition(f.index, w, line.state, MESI::Invalid, f.tag, block_addr);
+        line.state = MESI::Invalid;
+    }
+    return resp;
+}
+
+bool Cache::touch(uint32_t set_idx, uint32_t way) {
+    mark_recent(set_idx, way);
+    auto& line = sets_[set_idx][way];
+    if (!line.prefetched) return false;
+    line.prefetched = false;
+    stats_.prefetch_useful++;
+    return true;
+}
+
+bool Cache::wait_fill(const MshrRef& r) {
+    if (!r.pending()) return false;
+    const auto& e = mshrs_[r.idx];
+    if (!e.valid || e.gen != r.gen) return false; // Ya completado
+    return complete_mshr(r.idx);
+}
+
+void Cache::drain_mshrs() {
+    for (int i = 0; i < int(hw::kMshrs); ++i)
+        if (mshrs_[i].valid) complete_mshr(i);
 }
 
 SnoopResponse Cache::snoop(const BusMessage& msg) {
-    std::lock_guard<std::mutex> lk(m_);
     auto f = Address::split(msg.addr);
+    std::lock_guard<std::mutex> lk(set_lock(f.index));
+    if (msg.cmd == BusCmd::BusRdX || msg.cmd == BusCmd::BusUpgr) {
+        // Otro PE va a escribir el bloque: la reserva LL deja de valer
+        break_link(Address::block_base(msg.addr));
+    }
     auto [hit, set_idx, way] = probe(f.tag, f.index);
     SnoopResponse resp;
 
-    if (!hit) return resp;
+    if (!hit) {
+        // Llenado en vuelo del mismo bloque: se degrada el estado con que se instalara
+        for (uint32_t w = 0; w < hw::kWays; ++w) {
+            auto& pl = sets_[f.index][w];
+            if (!pl.pending || pl.tag != f.tag || pl.fill_state == MESI::Invalid) continue;
+            resp.had_copy = true;
+            if (msg.cmd == BusCmd::BusRd) {
+                pl.fill_state = MESI::Shared;
+            } else if (msg.cmd == BusCmd::BusRdX || msg.cmd == BusCmd::BusUpgr) {
+                count_invalidation(msg.addr);
+                pl.fill_state = MESI::Invalid;
+            }
+        }
+        return resp;
+    }
 
     auto& line = sets_[set_idx][way];
     resp.had_copy = (line.state != MESI::Invalid);
@@ -187,18 +562,22 @@ SnoopResponse Cache::snoop(const BusMessage& msg) {
                 resp.wrote_back = true;
             }
             if (line.state != MESI::Invalid) {
-                stats_.invalidations++;
+                count_invalidation(msg.addr);
                 record_transition(set_idx, way, line.state, MESI::Invalid, f.tag, msg.addr);
                 line.state = MESI::Invalid;
             }
+            if (line.prefetched) stats_.prefetch_useless++;
+            line.prefetched = false;
             break;
 
         case BusCmd::BusUpgr:
             if (line.state == MESI::Shared || line.state == MESI::Exclusive) {
-                stats_.invalidations++;
+                count_invalidation(msg.addr);
                 record_transition(set_idx, way, line.state, MESI::Invalid, f.tag, msg.addr);
                 line.state = MESI::Invalid;
             }
+            if (line.prefetched) stats_.prefetch_useless++;
+            line.prefetched = false;
             break;
 
         case BusCmd::Flush:
@@ -208,27 +587,29 @@ SnoopResponse Cache::snoop(const BusMessage& msg) {
 }
 
 void Cache::dump_state(std::ostream& os) {
-    std::lock_guard<std::mutex> lk(m_);
     os << "PE#" << pe_id_ << " Cache state (set:way tag state LRU)\n";
     for (uint32_t s = 0; s < hw::kSets; ++s) {
+        std::lock_guard<std::mutex> lk(set_lock(s));
         for (uint32_t w = 0; w < hw::kWays; ++w) {
             const auto& l = sets_[s][w];
             os << "  " << s << ":" << w
                << " tag=0x" << std::hex << l.tag << std::dec
                << " state=" << mesi_str(l.state)
-               << " recent=" << (l.recent ? '1' : '0') << "\n";
+               << " recent=" << (l.recent ? '1' : '0')
+               << (l.pending ? " (llenado en vuelo)" : "") << "\n";
         }
     }
 }
 
 void Cache::flush_all() {
-    std::lock_guard<std::mutex> lk(m_);
     for (uint32_t s = 0; s < hw::kSets; ++s) {
+        std::lock_guard<std::mutex> lk(set_lock(s));
         for (uint32_t w = 0; w < hw::kWays; ++w) {
             auto &line = sets_[s][w];
             if (line.state == MESI::Modified) {
                 uint64_t block_addr = reconstruct_block_addr(line.tag, s);
                 mem_->writeBlockAligned(block_addr, line.data);
+                if (watch_) watch_->on_transition(pe_id_, block_addr, MESI::Modified, MESI::Exclusive);
                 line.state = MESI::Exclusive;
             }
         }
@@ -236,20 +617,31 @@ void Cache::flush_all() {
 }
 
 MESI Cache::get_state(uint32_t set_idx, uint32_t way) const {
-    std::lock_guard<std::mutex> lk(m_);
+    std::lock_guard<std::mutex> lk(set_lock(set_idx));
     return sets_[set_idx][way].state;
 }
 
 uint64_t Cache::get_tag(uint32_t set_idx, uint32_t way) const {
-    std::lock_guard<std::mutex> lk(m_);
+    std::lock_guard<std::mutex> lk(set_lock(set_idx));
     return sets_[set_idx][way].tag;
 }
 
 bool Cache::get_recent(uint32_t set_idx, uint32_t way) const {
-    std::lock_guard<std::mutex> lk(m_);
+    std::lock_guard<std::mutex> lk(set_lock(set_idx));
     return sets_[set_idx][way].recent;
 }
 
+void Cache::copy_lines(std::vector<LineView>& out) const {
+    out.resize(size_t(hw::kSets) * hw::kWays);
+    for (uint32_t s = 0; s < hw::kSets; ++s) {
+        std::lock_guard<std::mutex> lk(set_lock(s));  // Un candado por set, no por linea
+        for (uint32_t w = 0; w < hw::kWays; ++w) {
+            const auto& l = sets_[s][w];
+            out[s * hw::kWays + w] = LineView{l.state, l.tag, l.recent, l.pending, l.data};
+        }
+    }
+}
+
 // Metodos privados
 std::tuple<bool,uint32_t,uint32_t> Cache::probe(uint64_t tag, uint32_t set_idx) const {
     for (uint32_t w=0; w<hw::kWays; ++w) {
@@ -269,6 +661,9 @@ CacheLine& Cache::choose_victim(uint32_t set_idx) {
 }
 
 uint32_t Cache::victim_index(uint32_t set_idx) const {
+    // Nunca se expulsa una via con llenado en vuelo (settle_set deja una libre)
+    if (sets_[set_idx][0].pending) return 1;
+    if (sets_[set_idx][1].pending) return 0;
     uint32_t w0 = 0, w1 = 1;
     if      (!sets_[set_idx][w0].recent &&  sets_[set_idx][w1].recent) return w0;
     else if ( sets_[set_idx][w0].recent && !sets_[set_idx][w1].recent) return w1;
@@ -283,16 +678,83 @@ void Cache::mark_recent(uint32_t set_idx, uint32_t way) {
 void Cache::evict_if_dirty(uint32_t set_idx, uint32_t& way) {
     way = victim_index(set_idx);
     auto& line = sets_[set_idx][way];
+    if (line.state != MESI::Invalid) break_link(reconstruct_block_addr(line.tag, set_idx));
     if (line.state == MESI::Modified) {
         uint64_t old_block_addr = reconstruct_block_addr(line.tag, set_idx);
         mem_->writeBlockAligned(old_block_addr, line.data);
         stats_.writebacks++;
     }
+    if (line.prefetched) stats_.prefetch_useless++; // Expulsada sin usarse
+    if (watch_ && line.state != MESI::Invalid)
+        watch_->on_transition(pe_id_, reconstruct_block_addr(line.tag, set_idx), line.state, MESI::Invalid);
+    line.prefetched = false;
     line.state = MESI::Invalid;
     line.tag   = 0;
     line.recent = false;
 }
 
+bool Cache::complete_mshr(int idx) {
+    auto& e = mshrs_[idx];
+    bool waited = e.fill.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+    if (waited) stats_.fill_waits++;
+    std::vector<uint8_t> data = e.fill.get();
+    {
+        std::lock_guard<std::mutex> lk(set_lock(e.set));
+        auto& line = sets_[e.set][e.way];
+        std::memcpy(line.data.data(), data.data(), hw::kBlockBytes);
+        record_transition(e.set, e.way, MESI::Invalid, line.fill_state, line.tag, e.block_addr);
+        line.state = line.fill_state;
+        line.pending = false;
+        line.prefetched = e.prefetch && line.state != MESI::Invalid;
+        if (e.prefetch && line.state == MESI::Invalid) stats_.prefetch_useless++;
+    }
+    // Los destinos reciben el dato del bloque aunque la linea haya sido
+    // invalidada en vuelo: esas lecturas quedaron ordenadas antes en el bus
+    for (auto& t : e.targets) {
+        std::memcpy(t.first, data.data() + t.second, 8);
+        if (watch_) watch_->on_access(false, pe_id_, e.block_addr + t.second, 8, t.first);
+    }
+    e.targets.clear();
+    e.valid = false;
+    e.gen++;
+    mshrs_busy_--;
+    return waited;
+}
+
+void Cache::retire_ready() {
+    // La latencia se mide en accesos propios y no en tiempo real: el orden en
+    // que llegan los llenados (y los contadores) no depende del hilo de memoria
+    for (int i = 0; i < int(hw::kMshrs); ++i)
+        if (mshrs_[i].valid && tick_ - mshrs_[i].issued >= hw::kFillLatency) complete_mshr(i);
+}
+
+bool Cache::settle_set(uint32_t set_idx, uint64_t tag) {
+    uint32_t busy_ways = 0;
+    int oldest = -1;
+    bool late = false;
+    for (int i = 0; i < int(hw::kMshrs); ++i) {
+        auto& e = mshrs_[i];
+        if (!e.valid || e.set != set_idx) continue;
+        if (Address::split(e.block_addr).tag == tag) {
+            // Un acceso de demanda espera un prefetch en vuelo: prefetch tardio
+            if (e.prefetch) { stats_.prefetch_late++; e.prefetch = false; late = true; }
+            complete_mshr(i);
+            continue;
+        }
+        busy_ways++;
+        if (oldest < 0 || e.seq < mshrs_[oldest].seq) oldest = i;
+    }
+    // Todas las vias reservadas: se completa la mas vieja para liberar una
+    if (busy_ways >= hw::kWays) complete_mshr(oldest);
+    return late;
+}
+
+int Cache::find_mshr(uint32_t set_idx, uint32_t way) const {
+    for (int i = 0; i < int(hw::kMshrs); ++i)
+        if (mshrs_[i].valid && mshrs_[i].set == set_idx && mshrs_[i].way == way) return i;
+    return -1;
+}
+
 void Cache::fill_from_mem(uint64_t addr, uint32_t set_idx, uint32_t way) {
     auto block_addr = Address::block_base(addr);
     mem_->readBlockAligned(block_addr, sets_[set_idx][way].data);
@@ -301,11 +763,13 @@ void Cache::fill_from_mem(uint64_t addr, uint32_t set_idx, uint32_t way) {
 double Cache::load_from_line(uint32_t set_idx, uint32_t way, uint32_t off) const {
     double val;
     std::memcpy(&val, &sets_[set_idx][way].data[off], 8);
+    if (watch_) watch_->on_access(false, pe_id_, reconstruct_block_addr(sets_[set_idx][way].tag, set_idx) + off, 8, &val);
     return val;
 }
 
 void Cache::store_into_line(uint32_t set_idx, uint32_t way, uint32_t off, double v) {
     std::memcpy(&sets_[set_idx][way].data[off], &v, 8);
+    if (watch_) watch_->on_access(true, pe_id_, reconstruct_block_addr(sets_[set_idx][way].tag, set_idx) + off, 8, &v);
 }
 
 void Cache::writeback_line(uint32_t set_idx, uint32_t way, uint64_t addr_for_block) {
@@ -315,9 +779,76 @@ void Cache::writeback_line(uint32_t set_idx, uint32_t way, uint64_t addr_for_blo
 }
 
 uint64_t Cache::reconstruct_block_addr(uint64_t tag, uint32_t set_idx) const {
-    uint64_t addr = (tag << (Address::kOffBits + Address::kIdxBits)) |
-                    (static_cast<uint64_t>(set_idx) << Address::kOffBits);
-    return addr;
+    return Address::join(tag, set_idx);
+}
+
+void Cache::count_miss(uint64_t addr, MissKind k) {
+    miss_class_.count(Address::block_base(addr), k);
+    count_heat(&BlockHeat::misses, addr);
+    switch (k) {
+        case MissKind::Compulsory: stats_.miss_compulsory++; break;
+        case MissKind::Capacity:   stats_.miss_capacity++; break;
+        case MissKind::Conflict:   stats_.miss_conflict++; break;
+        case MissKind::Coherence:  stats_.miss_coherence++; break;
+    }
+}
+
+void Cache::classify_miss(uint64_t addr, bool shadow_hit) {
+    count_miss(addr, miss_class_.classify(Address::block_base(addr), shadow_hit));
+}
+
+void Cache::count_invalidation(uint64_t addr) {
+    stats_.invalidations++;
+    miss_class_.invalidated(Address::block_base(addr));
+    count_heat(&BlockHeat::invalidations, addr);
+}
+
+Counter Stats::* const Stats::kFields[Stats::kCounters] = {
+    &Stats::read_ops, &Stats::write_ops, &Stats::misses, &Stats::invalidations,
+    &Stats::bus_msgs, &Stats::writebacks, &Stats::upgrades, &Stats::mshr_merges,
+    &Stats::mshr_full, &Stats::fill_waits, &Stats::prefetches, &Stats::prefetch_useful,
+    &Stats::prefetch_late, &Stats::prefetch_useless, &Stats::prefetch_dropped, &Stats::atomic_ops,
+    &Stats::atomic_misses, &Stats::cas_failures, &Stats::sc_failures, &Stats::link_breaks,
+    &Stats::miss_compulsory, &Stats::miss_capacity, &Stats::miss_conflict, &Stats::miss_coherence,
+};
+const char* const Stats::kNames[Stats::kCounters] = {
+    "read_ops", "write_ops", "misses", "invalidations",
+    "bus_msgs", "writebacks", "upgrades", "mshr_merges",
+    "mshr_full", "fill_waits", "prefetches", "prefetch_useful",
+    "prefetch_late", "prefetch_useless", "prefetch_dropped", "atomic_ops",
+    "atomic_misses", "cas_failures", "sc_failures", "link_breaks",
+    "miss_compulsory", "miss_capacity", "miss_conflict", "miss_coherence",
+};
+
+void Cache::save_core(Core& c) const {
+    c.tick = tick_;
+    c.link = link_.load(std::memory_order_relaxed);
+    c.mshr_seq = mshr_seq_;
+    c.mshrs_busy = mshrs_busy_;
+    {
+        std::lock_guard<std::mutex> lk(trans_m_);
+        c.transitions = trans_.size();
+    }
+    for (size_t i = 0; i < Stats::kCounters; ++i) c.stats[i] = stats_.*Stats::kFields[i];
+    miss_class_.save_lru(c.miss_lru);
+}
+
+void Cache::restore_core(const Core& c) {
+    tick_ = c.tick;
+    link_.store(c.link, std::memory_order_relaxed);
+    mshr_seq_ = c.mshr_seq;
+    mshrs_busy_ = c.mshrs_busy;
+    {
+        std::lock_guard<std::mutex> lk(trans_m_);
+        if (c.transitions < trans_.size()) trans_.resize(c.transitions);
+    }
+    for (size_t i = 0; i < Stats::kCounters; ++i) stats_.*Stats::kFields[i] = Counter(c.stats[i]);
+    miss_class_.restore_lru(c.miss_lru);
+}
+
+void Cache::wait_fills() const {
+    for (const Mshr& e : mshrs_)
+        if (e.valid) e.fill.wait();
 }
 
 void Cache::record_transition(uint32_t set, uint32_t way, MESI from, MESI to, uint64_t tag, uint64_t addr) {
@@ -325,6 +856,8 @@ void Cache::record_transition(uint32_t set, uint32_t way, MESI from, MESI to, ui
     if (to == MESI::Modified && from != MESI::Modified) {
         stats_.upgrades++;
     }
+    if (watch_) watch_->on_transition(pe_id_, Address::join(tag, set), from, to);
+    std::lock_guard<std::mutex> lk(trans_m_);
     trans_.push_back(MESITransition{set,way,from,to,tag,addr});
 }
 
@@ -3,9 +3,11 @@
 #include <array>
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <functional>
+#include <future>
 #include <iomanip>
 #include <iostream>
 #include <mutex>
@@ -14,8 +16,14 @@
 #include <string>
 #include <thread>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
+#include "prefetcher.hpp"
+#include "sharing.hpp"
+#include "miss_class.hpp"
+#include "watch.hpp"
+
 extern std::mutex io_mtx;
 
 class SharedMemoryAdapter;
@@ -29,9 +37,13 @@ constexpr size_t kLines      = 16;  // Total de lineas de cache
 constexpr size_t kSets       = kLines / kWays; // 8 sets (16/2)
 static_assert(kSets == 8, "Deben ser 8 sets");
 
+constexpr size_t kMshrs      = 4;   // Fallos en vuelo por cache (MSHRs)
+constexpr uint64_t kFillLatency = 4; // Accesos propios que tarda un llenado en llegar
+
 constexpr size_t kMemDoubles = 512; // Memoria principal: 512 doubles
 constexpr size_t kMemBytes   = kMemDoubles * sizeof(uint64_t);
 }
+static_assert(SharingTracker::kBlockWords == hw::kBlockBytes / 8, "Palabras por bloque del detector de sharing");
 
 // PROTOCOLO MESI
 enum class MESI : uint8_t { 
@@ -67,6 +79,7 @@ struct BusMessage {
 };
 
 class Cache;
+class L2Cache;
 
 // RESUMEN DE SNOOPING
 struct SnoopSummary {
@@ -83,6 +96,17 @@ struct IMemory {
                                 std::array<uint8_t, hw::kBlockBytes>& out) = 0;
     virtual double load64(uint64_t addr) = 0;
     virtual void store64(uint64_t addr, double val) = 0;
+    // Tamano direccionable (el prefetcher no pide bloques fuera de rango)
+    virtual uint64_t size_bytes() const { return UINT64_MAX; }
+    // Lectura de bloque sin esperar (fallos no bloqueantes). Por defecto se
+    // resuelve en el acto con readBlockAligned
+    virtual std::future<std::vector<uint8_t>> readBlockAsync(uint64_t block_addr) {
+        std::array<uint8_t, hw::kBlockBytes> tmp;
+        readBlockAligned(block_addr, tmp);
+        std::promise<std::vector<uint8_t>> p;
+        p.set_value(std::vector<uint8_t>(tmp.begin(), tmp.end()));
+        return p.get_future();
+    }
 };
 
 // CAMPOS DE DIRECCION
@@ -101,16 +125,52 @@ struct Address {
 
     static AddrFields split(uint64_t addr);     // Divide direccion en campos
     static uint64_t block_base(uint64_t addr);  // Obtiene base del bloque
+    static uint64_t join(uint64_t tag, uint32_t index) {  // Base del bloque de una linea
+        return (tag << (kOffBits + kIdxBits)) | (uint64_t(index) << kOffBits);
+    }
 };
 
 // INTERCONEXION
 class Interconnect {
 public:
+    // Bus tomado. Al soltarlo, y ya sin candados de set, corren las
+    // back-invalidations que dejo la L2 inclusiva (l2_cache.hpp)
+    class BusLock {
+    public:
+        BusLock() = default;
+        explicit BusLock(Interconnect* ic) : ic_(ic), lk_(ic->bus_mutex_) {}
+        BusLock(BusLock&& o) noexcept : ic_(o.ic_), lk_(std::move(o.lk_)) { o.ic_ = nullptr; }
+        BusLock& operator=(BusLock&& o) noexcept {  // Lo anterior se suelta con o
+            std::swap(ic_, o.ic_);
+            std::swap(lk_, o.lk_);
+            return *this;
+        }
+        ~BusLock() { if (ic_ && ic_->l2_ && lk_.owns_lock()) ic_->settle_l2(); }
+    private:
+        Interconnect* ic_ = nullptr;
+        std::unique_lock<std::mutex> lk_;
+    };
+
     void register_cache(Cache* c);           // Registrar cache en el bus
-    SnoopSummary broadcast(const BusMessage& msg, Cache* origin); // Broadcast
+    // Adquirir el bus para una transaccion completa (snoop + llenado)
+    BusLock acquire() { return BusLock(this); }
+    // Broadcast a las demas caches. Requiere el bus adquirido con acquire()
+    SnoopSummary broadcast(const BusMessage& msg, Cache* origin);
     void flush_all();                        // Forzar write-back a memoria
+    // L2 compartida debajo de las caches (nullptr: van directo a memoria)
+    void set_l2(L2Cache* l2) { l2_ = l2; }
+    // Invalida el bloque en todas las caches (inclusion de la L2). Con el bus
+    // tomado; devuelve las copias invalidadas y en writebacks las que estaban en M
+    uint32_t back_invalidate(uint64_t block_addr, uint32_t& writebacks);
+    // Clasificacion true/false sharing de los fallos de coherencia
+    SharingTracker& sharing() { return sharing_; }
+    const SharingTracker& sharing() const { return sharing_; }
 
 private:
+    void settle_l2();
+
+    SharingTracker sharing_;
+    L2Cache* l2_ = nullptr;
     std::vector<Cache*> caches_; // Lista de caches conectadas
     std::mutex m_;               // Mutex para lista de caches
     std::mutex bus_mutex_;       // Mutex para acceso al bus
@@ -136,17 +196,87 @@ struct CacheLine {
     uint64_t tag = 0;                             // Tag de la direccion
     std::array<uint8_t, hw::kBlockBytes> data{};  // Datos del bloque
     bool recent = false;                          // Bit LRU
+    // Llenado en vuelo (MSHR): la linea sigue Invalid para probe() pero la via
+    // queda reservada. Los snoops degradan fill_state (E->S, o ->I si otro PE
+    // pide exclusividad) y se aplica al completar el llenado
+    bool pending = false;
+    MESI fill_state = MESI::Invalid;
+    bool prefetched = false; // Traida por prefetch y aun sin uso de demanda
+};
+
+// VISTA DE UNA LINEA - copia para inspeccion (GUI)
+struct LineView {
+    MESI state = MESI::Invalid;
+    uint64_t tag = 0;
+    bool recent = false;
+    bool pending = false;  // Llenado en vuelo
+    std::array<uint8_t, hw::kBlockBytes> data{};
+};
+
+// REFERENCIA A UN FALLO EN VUELO - idx < 0 si la lectura ya se resolvio
+struct MshrRef {
+    int idx = -1;      // Entrada MSHR
+    uint32_t gen = 0;  // Generacion de la entrada (detecta que ya se completo)
+    bool pending() const { return idx >= 0; }
+};
+
+// CONTADOR DE ESTADISTICAS - Atomico relajado pero copiable: el hilo del PE
+// y los snoops de otros PEs lo actualizan sin compartir un candado
+struct Counter {
+    std::atomic<uint64_t> v{0};
+    Counter() = default;
+    Counter(uint64_t x) : v(x) {}
+    Counter(const Counter& o) : v(o.v.load(std::memory_order_relaxed)) {}
+    Counter& operator=(const Counter& o) {
+        v.store(o.v.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+    Counter& operator++() { v.fetch_add(1, std::memory_order_relaxed); return *this; }
+    uint64_t operator++(int) { return v.fetch_add(1, std::memory_order_relaxed); }
+    Counter& operator+=(uint64_t d) { v.fetch_add(d, std::memory_order_relaxed); return *this; }
+    operator uint64_t() const { return v.load(std::memory_order_relaxed); }
 };
 
 // ESTADISTICAS DE CACHE
 struct Stats {
-    uint64_t read_ops  = 0;  // Operaciones de lectura
-    uint64_t write_ops = 0;  // Operaciones de escritura
-    uint64_t misses    = 0;  // Fallos de cache
-    uint64_t invalidations = 0; // Invalidaciones recibidas
-    uint64_t bus_msgs  = 0;  // Mensajes por bus
-    uint64_t writebacks  = 0; // Write-backs a memoria
-    uint64_t upgrades = 0;   // Upgrades a estado Modified
+    Counter read_ops;       // Operaciones de lectura
+    Counter write_ops;      // Operaciones de escritura
+    Counter misses;         // Fallos de cache
+    Counter invalidations;  // Invalidaciones recibidas
+    Counter bus_msgs;       // Mensajes por bus
+    Counter writebacks;     // Write-backs a memoria
+    Counter upgrades;       // Upgrades a estado Modified
+    Counter mshr_merges;    // Fallos secundarios unidos a un MSHR en vuelo
+    Counter mshr_full;      // Esperas por no haber MSHR libre
+    Counter fill_waits;     // Usos de un llenado que aun no habia llegado
+    Counter prefetches;        // Prefetches emitidos al bus
+    Counter prefetch_useful;   // Lineas prefetcheadas usadas por demanda
+    Counter prefetch_late;     // Demanda que llego con el prefetch aun en vuelo
+    Counter prefetch_useless;  // Expulsadas/invalidadas sin usarse
+    Counter prefetch_dropped;  // Descartados por falta de MSHR o via libre
+    Counter atomic_ops;        // FETCH_ADD/CAS/LL/SC ejecutadas
+    Counter atomic_misses;     // Atomicas que tuvieron que pedir la linea por el bus
+    Counter cas_failures;      // CAS que encontraron otro valor
+    Counter sc_failures;       // SC sin reserva (rota o expulsada)
+    Counter link_breaks;       // Reservas LL rotas: escritura de otro PE o linea expulsada
+    Counter miss_compulsory;   // misses por tipo (miss_class.hpp); suman misses
+    Counter miss_capacity;
+    Counter miss_conflict;
+    Counter miss_coherence;
+
+    // Acceso por indice (historial de deshacer, salida JSON del stepper)
+    static constexpr size_t kCounters = 24;
+    static Counter Stats::* const kFields[kCounters];
+    static const char* const kNames[kCounters];  // Nombre de cada campo
+};
+static_assert(sizeof(Stats) == Stats::kCounters * sizeof(Counter), "Stats::kFields debe listar todos los contadores");
+
+// CONTADORES POR BLOQUE - alimentan los mapas de calor de la GUI. Relajados:
+// los escriben el hilo del PE (accesos y fallos) y los snoops (invalidaciones)
+struct BlockHeat {
+    std::atomic<uint32_t> accesses{0};       // Accesos de demanda (incluye atomicas)
+    std::atomic<uint32_t> misses{0};         // Igual criterio que Stats::misses
+    std::atomic<uint32_t> invalidations{0};  // Copias invalidadas por otros PEs
 };
 
 // CACHE L1
@@ -155,31 +285,113 @@ public:
     Cache(int pe_id, IMemory* mem, Interconnect* ic);
     
     // API para el PE
-    double read_double(uint64_t addr);        // Leer double
-    void write_double(uint64_t addr, double value); // Escribir double
+    // pc: instruccion que accede, para el prefetcher de stride (-1 si no aplica)
+    double read_double(uint64_t addr, int pc = -1);        // Leer double
+    void write_double(uint64_t addr, double value, int pc = -1); // Escribir double
+    // Acceso de n doubles consecutivos dentro de un mismo bloque (un solo
+    // acceso a cache; lo usan VLOAD/VSTORE)
+    void read_line(uint64_t addr, double* out, uint32_t n, int pc = -1);
+    void write_line(uint64_t addr, const double* in, uint32_t n, int pc = -1);
+    // Lectura no bloqueante: en acierto escribe *dst y devuelve una ref vacia;
+    // en fallo deja el llenado en vuelo y *dst se escribe al completarlo
+    MshrRef read_double_nb(uint64_t addr, double* dst, int pc = -1);
+    bool wait_fill(const MshrRef& r);  // Completa el llenado; true si hubo que esperar
+    void drain_mshrs();                // Completa todos los llenados en vuelo
+
+    // Atomicas: lectura-modificacion-escritura con la linea en E/M. Si hay que
+    // pedirla, el bus queda tomado hasta escribir: nadie se mete en medio
+    double fetch_add(uint64_t addr, double delta, int pc = -1); // Devuelve el valor previo
+    bool compare_swap(uint64_t addr, double expected, double desired, int pc = -1);
+    double load_linked(uint64_t addr, int pc = -1);   // Lee y reserva el bloque
+    bool store_conditional(uint64_t addr, double value, int pc = -1);
+
+    // Prefetcher opcional (nullptr lo desactiva). Solo lo usa el hilo del PE
+    void set_prefetcher(std::unique_ptr<Prefetcher> p);
+    const Prefetcher* prefetcher() const { return prefetcher_.get(); }
     
     // Snooping para protocolo MESI
     SnoopResponse snoop(const BusMessage& msg);
+    // La L2 inclusiva expulso el bloque: la copia (o el llenado en vuelo) se
+    // invalida, con write-back si estaba en M. Con el bus tomado
+    SnoopResponse back_invalidate(uint64_t block_addr);
     
     // Metricas y utilidades
     const Stats& stats() const { return stats_; }
+    // Fallos por bloque y tipo: leer con el PE detenido
+    const std::unordered_map<uint64_t, MissCounts>& miss_blocks() const { return miss_class_.per_block(); }
     const std::vector<MESITransition>& transitions() const { return trans_; }
+    // Por bloque (addr / kBlockBytes); vacio si la memoria no informa su tamano
+    const std::vector<BlockHeat>& heat() const { return heat_; }
     int pe_id() const { return pe_id_; }
     void dump_state(std::ostream& os);        // Debug: estado de cache
     void flush_all();                         // Forzar write-back
     MESI get_state(uint32_t set_idx, uint32_t way) const;
     uint64_t get_tag(uint32_t set_idx, uint32_t way) const;
     bool get_recent(uint32_t set_idx, uint32_t way) const;
+    // Inspeccion sin efectos: no cambian estados MESI, LRU ni contadores
+    void copy_lines(std::vector<LineView>& out) const;  // kSets*kWays, por set
+    // Watchpoints (watch.hpp): nullptr si no hay ninguno. Cambiar con el PE detenido
+    void set_watch(Watchpoints* w) { watch_ = w; }
+
+    // MSHRs: solo los usa el hilo del PE dueno (los snoops solo ven CacheLine)
+    struct Mshr {
+        bool valid = false;
+        uint64_t block_addr = 0;
+        uint32_t set = 0, way = 0;
+        uint32_t gen = 0;
+        uint64_t seq = 0;  // Orden de emision (se completa el mas viejo si no hay libres)
+        bool prefetch = false; // Emitido por el prefetcher, sin demanda aun
+        uint64_t issued = 0;   // tick_ de emision
+        // Compartido: el historial de deshacer guarda copias de la entrada
+        std::shared_future<std::vector<uint8_t>> fill;
+        std::vector<std::pair<double*, uint32_t>> targets; // Destino y offset
+    };
+    using Mshrs = std::array<Mshr, hw::kMshrs>;
+
+    // ESTADO PARA DESHACER PASOS (undo.hpp) - solo con el PE detenido. Los
+    // contadores por bloque (heat) y el detector de sharing no retroceden
+    using Misses = MissClassifier<hw::kLines>;
+    struct Core {  // Trivialmente copiable: se compara por palabras
+        uint64_t tick, link, mshr_seq, transitions;
+        uint32_t mshrs_busy;
+        uint64_t stats[Stats::kCounters];
+        Misses::Lru miss_lru;
+    };
+    void save_core(Core& c) const;
+    void restore_core(const Core& c);  // Recorta transitions()
+    const CacheLine& line_at(uint32_t set_idx, uint32_t way) const { return sets_[set_idx][way]; }
+    void restore_line(uint32_t set_idx, uint32_t way, const CacheLine& l) { sets_[set_idx][way] = l; }
+    const Mshrs& mshrs() const { return mshrs_; }
+    void restore_mshrs(const Mshrs& m) { mshrs_ = m; }
+    void wait_fills() const;  // Los llenados en vuelo ya leyeron la memoria
+    // Clasificador de fallos: diario de cambios (nullptr: no graba) y copia completa
+    void set_miss_journal(std::vector<MissUndo>* j) { miss_class_.set_journal(j); }
+    void undo_miss(const MissUndo& u) { miss_class_.undo(u); }
+    void save_misses(Misses::State& s) const { miss_class_.save(s); }
+    void restore_misses(const Misses::State& s) { miss_class_.restore(s); }
 
 private:
     friend class Interconnect;
     
+    // Resultado de un acceso de demanda (alimenta al prefetcher)
+    enum class Access : uint8_t { Hit, PrefetchHit, Miss };
+
     // Metodos internos
+    Access do_read(uint64_t addr, double* out, uint32_t n);
+    Access do_write(uint64_t addr, const double* in, uint32_t n);
+    Access do_read_nb(uint64_t addr, double* dst, MshrRef& ref);
+    // op recibe el valor actual y decide si escribir (lo modifica en el lugar)
+    Access do_rmw(uint64_t addr, const std::function<bool(double&)>& op);
+    int issue_fill(uint64_t addr);        // BusRd + llenado asincrono en un MSHR
+    void run_prefetcher(int pc, uint64_t addr, Access a);
+    void issue_prefetch(uint64_t block_addr);
+    bool touch(uint32_t set_idx, uint32_t way); // LRU + uso de linea prefetcheada
     std::tuple<bool,uint32_t,uint32_t> probe(uint64_t tag, uint32_t set_idx) const;
     CacheLine& choose_victim(uint32_t set_idx);
     uint32_t victim_index(uint32_t set_idx) const;
     void mark_recent(uint32_t set_idx, uint32_t way);
     void evict_if_dirty(uint32_t set_idx, uint32_t& way);
+    void break_link(uint64_t block_addr);  // Rompe la reserva LL si es de ese bloque
     void fill_from_mem(uint64_t addr, uint32_t set_idx, uint32_t way);
     double load_from_line(uint32_t set_idx, uint32_t way, uint32_t off) const;
     void store_into_line(uint32_t set_idx, uint32_t way, uint32_t off, double v);
@@ -187,6 +399,22 @@ private:
     uint64_t reconstruct_block_addr(uint64_t tag, uint32_t set_idx) const;
     void record_transition(uint32_t set, uint32_t way, MESI from, MESI to, 
                          uint64_t tag, uint64_t addr);
+    void count_miss(uint64_t addr, MissKind k);          // Tipo ya conocido (upgrade)
+    void classify_miss(uint64_t addr, bool shadow_hit);  // Fallo de demanda
+    void count_invalidation(uint64_t addr);              // Snoop: se pierde la copia
+    void count_heat(std::atomic<uint32_t> BlockHeat::* c, uint64_t addr) {
+        const uint64_t b = addr / hw::kBlockBytes;
+        if (b < heat_.size()) (heat_[b].*c).fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Candado por set, alineado a linea del host para no compartirla entre sets
+    struct alignas(64) SetLock { std::mutex m; };
+    std::mutex& set_lock(uint32_t set_idx) const { return set_locks_[set_idx].m; }
+
+    bool complete_mshr(int idx);
+    bool settle_set(uint32_t set_idx, uint64_t tag); // true si absorbio un prefetch tardio
+    void retire_ready();                  // Completa los llenados con latencia cumplida
+    int find_mshr(uint32_t set_idx, uint32_t way) const;
 
     // Datos miembros
     int pe_id_;         // ID del PE dueno
@@ -195,5 +423,22 @@ private:
     std::vector<std::array<CacheLine, hw::kWays>> sets_; // Array de sets
     Stats stats_;                   // Estadisticas
     std::vector<MESITransition> trans_; // Historial de transiciones
-    mutable std::mutex m_;         // Mutex para acceso thread-safe
+    // Un candado por set: un acierto solo se serializa con snoops al mismo set.
+    // Orden de adquisicion: bus -> set (los snoops llegan con el bus tomado)
+    mutable std::array<SetLock, hw::kSets> set_locks_;
+    mutable std::mutex trans_m_;   // Protege trans_ (lo escriben PE y snoops)
+    Mshrs mshrs_;
+    uint32_t mshrs_busy_ = 0;      // Entradas validas
+    uint64_t mshr_seq_ = 0;
+    uint64_t tick_ = 0;  // Reloj local: accesos de demanda de esta cache (determinista)
+    std::unique_ptr<Prefetcher> prefetcher_;
+    std::vector<uint64_t> pf_candidates_;
+    Misses miss_class_;                      // Sombra LRU, primer toque e invalidados
+    std::vector<BlockHeat> heat_;            // Contadores por bloque de memoria
+    Watchpoints* watch_ = nullptr;           // Ganchos de watchpoints (solo si hay alguno)
+    // Reserva de LL: bloque enlazado o kNoLink. La borran los BusRdX/BusUpgr
+    // de otros PEs al mismo bloque (snoop), la salida de la linea de esta L1
+    // (expulsion o back-invalidacion de la L2) y cualquier SC
+    static constexpr uint64_t kNoLink = UINT64_MAX;
+    std::atomic<uint64_t> link_{kNoLink};
 };
\ No newline at end of file
@@ -1,48 +1,46 @@
 # Codigo para calculo de producto punto
-# Registros: R0-R7
+# Registros: R0-R7 enteros (direcciones, contadores), F0-F15 punto flotante
 
 # --- Configuracion de registros por PE ---
 # R0: direccion inicial segmento A
 # R1: direccion inicial segmento B  
 # R2: direccion suma parcial S[ID]
 # R3: contador de iteraciones
-# R4: acumulador
-# R5-R7: temporales
+# R4: distancia en bytes de S[ID] a S[ID + 1]
+# R5: ID del PE | P redondeado a potencia de 2 (bit centinela de la reduccion)
+# F4: acumulador
+# F5-F7: temporales
 
 # --- Codigo para calculo parcial ---
 MAIN:
-    LOAD R4, [R2]        # Carga acumulador inicial (S[ID])
+    LOAD F4, [R2]        # Carga acumulador inicial (S[ID])
+    JZ R3, REDUCE        # Tramo vacio (N < P)
     
 LOOP:
-    LOAD R5, [R0]        # Carga A[i]
-    LOAD R6, [R1]        # Carga B[i]
-    FMUL R7, R5, R6      # R7 = A[i] * B[i]
-    FADD R4, R4, R7      # Acumula en R4
+    LOAD F5, [R0]        # Carga A[i]
+    LOAD F6, [R1]        # Carga B[i]
+    FMUL F7, F5, F6      # R7 = A[i] * B[i]
+    FADD F4, F4, F7      # Acumula en F4
     INC R0               # Siguiente elemento A (+8 bytes)
     INC R1               # Siguiente elemento B (+8 bytes)
     DEC R3               # Decrementa contador
     JNZ R3, LOOP         # Salta si no es cero
     
-    STORE R4, [R2]       # Guarda suma parcial
-    HALT
+# --- Reduccion en arbol: log2(P) rondas separadas por BARRIER ---
+# En la ronda k, el PE con el bit k del ID en 0 suma S[ID + 2^k]; el que lo
+# tiene en 1 ya publico su parcial y termina. PE0 deja el total en S[0]
+REDUCE:
+    STORE F4, [R2]       # Publica la suma parcial S[ID]
+TREE:
+    ANDI R3, R5, 1       # Bit k del ID (tras la ultima ronda, el centinela)
+    JNZ R3, DONE         # Emisor, o PE0 con el total
+    BARRIER              # El socio ya publico S[ID + 2^k] (o termino)
+    LOAD F5, [R2 + R4]   # Carga S[ID + 2^k]
+    FADD F4, F4, F5      # Acumula en F4
+    STORE F4, [R2]       # S[ID] = suma del subarbol
+    SHLI R4, R4, 1       # Siguiente ronda: socio al doble de distancia
+    SHRI R5, R5, 1
+    JNZ R5, TREE         # R5 no llega a cero antes del centinela
 
-# --- Codigo para suma final (ejecutado por PE0) ---
-FINAL_SUM:
-    # R0: direccion base sumas parciales
-    # R1: numero de PEs
-    # R2: direccion resultado final
-    # R3-R7: temporales
-    
-    LOAD R4, [R0]        # Carga S[0]
-    LOAD R3, 1           # Inicia contador PE en 1
-    
-SUM_LOOP:
-    INC R0               # Siguiente suma parcial
-    LOAD R5, [R0]        # Carga S[i]
-    FADD R4, R4, R5      # Suma al acumulador
-    INC R3               # Incrementa contador PE
-    DEC R1               # Decrementa contador total
-    JNZ R1, SUM_LOOP     # Continua si quedan PEs
-    
-    STORE R4, [R2]       # Guarda resultado final
+DONE:
     HALT
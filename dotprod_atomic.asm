@@ -0,0 +1,26 @@
+# Producto punto con un unico acumulador compartido: cada producto se suma
+# a S[0] con FETCH_ADD (peor caso de contencion, para comparar con las sumas
+# parciales por PE de dotprod.asm)
+
+# --- Configuracion de registros por PE ---
+# R0: direccion inicial segmento A
+# R1: direccion inicial segmento B
+# R3: contador de iteraciones
+# R6: direccion de S[0] (acumulador comun)
+# F5-F8: temporales
+
+MAIN:
+    JZ R3, DONE          # Tramo vacio
+
+LOOP:
+    LOAD F5, [R0]        # Carga A[i]
+    LOAD F6, [R1]        # Carga B[i]
+    FMUL F7, F5, F6      # F7 = A[i] * B[i]
+    FETCH_ADD F8, [R6], F7  # S[0] += F7 (atomico; F8 = valor previo)
+    INC R0               # Siguiente elemento A (+8 bytes)
+    INC R1               # Siguiente elemento B (+8 bytes)
+    DEC R3               # Decrementa contador
+    JNZ R3, LOOP         # Salta si no es cero
+
+DONE:
+    HALT
@@ -0,0 +1,46 @@
+# Producto punto con reparto ciclico: el PE p procesa A[p], A[p+P], A[p+2P]...
+# Registros: R0-R7 enteros, F0-F15 punto flotante
+
+# --- Configuracion de registros por PE ---
+# R0: direccion de A[ID]
+# R1: direccion de B[ID]
+# R2: direccion suma parcial S[ID]
+# R3: elementos de este PE
+# R4: distancia en bytes de S[ID] a S[ID + 1]
+# R5: ID del PE | P redondeado a potencia de 2 (bit centinela de la reduccion)
+# R7: paso entre elementos del PE en bytes (P * 8)
+# F4: acumulador
+# F5-F7: temporales
+
+MAIN:
+    LOAD F4, [R2]        # Carga acumulador inicial (S[ID])
+    JZ R3, REDUCE        # Sin elementos (N < P)
+
+LOOP:
+    LOAD F5, [R0]        # Carga A[i]
+    LOAD F6, [R1]        # Carga B[i]
+    FMUL F7, F5, F6      # F7 = A[i] * B[i]
+    FADD F4, F4, F7      # Acumula en F4
+    ADD R0, R0, R7       # A[i + P]
+    ADD R1, R1, R7       # B[i + P]
+    DEC R3               # Decrementa contador
+    JNZ R3, LOOP         # Salta si no es cero
+
+# --- Reduccion en arbol: log2(P) rondas separadas por BARRIER ---
+# En la ronda k, el PE con el bit k del ID en 0 suma S[ID + 2^k]; el que lo
+# tiene en 1 ya publico su parcial y termina. PE0 deja el total en S[0]
+REDUCE:
+    STORE F4, [R2]       # Publica la suma parcial S[ID]
+TREE:
+    ANDI R3, R5, 1       # Bit k del ID (tras la ultima ronda, el centinela)
+    JNZ R3, DONE         # Emisor, o PE0 con el total
+    BARRIER              # El socio ya publico S[ID + 2^k] (o termino)
+    LOAD F5, [R2 + R4]   # Carga S[ID + 2^k]
+    FADD F4, F4, F5      # Acumula en F4
+    STORE F4, [R2]       # S[ID] = suma del subarbol
+    SHLI R4, R4, 1       # Siguiente ronda: socio al doble de distancia
+    SHRI R5, R5, 1
+    JNZ R5, TREE         # R5 no llega a cero antes del centinela
+
+DONE:
+    HALT
@@ -0,0 +1,53 @@
+# Producto punto con reparto dinamico (self-scheduling): cada PE toma el
+# siguiente chunk con FETCH_ADD sobre el puntero Q hasta agotar la tabla T
+# (pares &A[inicio], largo; el frontend la arma para dynamic o guided)
+# Registros: R0-R7 enteros, F0-F15 punto flotante
+
+# --- Configuracion de registros por PE ---
+# R0: direccion de Q (Q = direccion del siguiente par de T)
+# R1: distancia en bytes de A[i] a B[i]
+# R2: direccion suma parcial S[ID]
+# R4: distancia en bytes de S[ID] a S[ID + 1]
+# R5: ID del PE | P redondeado a potencia de 2 (bit centinela de la reduccion)
+# R7: bytes por par de T (incremento de Q)
+# R3, R6: temporales (direccion en A, largo del chunk)
+# F4: acumulador
+# F5-F7: temporales
+
+MAIN:
+    LOAD F4, [R2]        # Carga acumulador inicial (S[ID])
+
+NEXT:
+    FETCH_ADD R3, [R0], R7  # R3 = &T[k], chunk tomado (Q avanza un par)
+    LOAD R6, [R3 + 8]    # R6 = largo del chunk
+    LOAD R3, [R3]        # R3 = &A[inicio]
+    JZ R6, REDUCE        # Largo 0: no quedan chunks
+
+LOOP:
+    LOAD F5, [R3]        # Carga A[i]
+    LOAD F6, [R3 + R1]   # Carga B[i]
+    FMUL F7, F5, F6      # F7 = A[i] * B[i]
+    FADD F4, F4, F7      # Acumula en F4
+    INC R3               # Siguiente elemento (+8 bytes)
+    DEC R6               # Decrementa largo
+    JNZ R6, LOOP         # Salta si no es cero
+    JZ R6, NEXT          # Chunk terminado: pedir otro
+
+# --- Reduccion en arbol: log2(P) rondas separadas por BARRIER ---
+# En la ronda k, el PE con el bit k del ID en 0 suma S[ID + 2^k]; el que lo
+# tiene en 1 ya publico su parcial y termina. PE0 deja el total en S[0]
+REDUCE:
+    STORE F4, [R2]       # Publica la suma parcial S[ID]
+TREE:
+    ANDI R3, R5, 1       # Bit k del ID (tras la ultima ronda, el centinela)
+    JNZ R3, DONE         # Emisor, o PE0 con el total
+    BARRIER              # El socio ya publico S[ID + 2^k] (o termino)
+    LOAD F5, [R2 + R4]   # Carga S[ID + 2^k]
+    FADD F4, F4, F5      # Acumula en F4
+    STORE F4, [R2]       # S[ID] = suma del subarbol
+    SHLI R4, R4, 1       # Siguiente ronda: socio al doble de distancia
+    SHRI R5, R5, 1
+    JNZ R5, TREE         # R5 no llega a cero antes del centinela
+
+DONE:
+    HALT
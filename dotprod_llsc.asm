@@ -0,0 +1,31 @@
+# Producto punto con suma parcial local y una sola actualizacion atomica de
+# S[0] por PE, con LL/SC: si otro PE escribio S[0] entre LL y SC, se reintenta
+
+# --- Configuracion de registros por PE ---
+# R0: direccion inicial segmento A
+# R1: direccion inicial segmento B
+# R3: contador de iteraciones
+# R6: direccion de S[0] (acumulador comun)
+# F4: acumulador local
+# F5-F7: temporales
+
+MAIN:
+    FZERO F4             # Acumulador local
+    JZ R3, PUBLISH       # Tramo vacio
+
+LOOP:
+    LOAD F5, [R0]        # Carga A[i]
+    LOAD F6, [R1]        # Carga B[i]
+    FMUL F7, F5, F6      # F7 = A[i] * B[i]
+    FADD F4, F4, F7      # Acumula en F4
+    INC R0               # Siguiente elemento A (+8 bytes)
+    INC R1               # Siguiente elemento B (+8 bytes)
+    DEC R3               # Decrementa contador
+    JNZ R3, LOOP         # Salta si no es cero
+
+PUBLISH:
+    LL F5, [R6]          # F5 = S[0] y reserva la linea
+    FADD F5, F5, F4      # Suma la parcial
+    SC R3, [R6], F5      # R3 = 1 si nadie escribio S[0] desde el LL
+    JZ R3, PUBLISH       # Reserva rota: reintentar
+    HALT
@@ -0,0 +1,64 @@
+# Codigo vectorial para calculo de producto punto
+# Registros: R0-R7 enteros, F0-F15 punto flotante, V0-V7 vectoriales (4 doubles = 1 linea)
+
+# --- Configuracion de registros por PE ---
+# R0: direccion inicial segmento A
+# R1: direccion inicial segmento B
+# R2: direccion suma parcial S[ID]
+# R3: iteraciones vectoriales (len / 4)
+# F4: acumulador
+# F5-F6: temporales
+# R7: elementos sobrantes (len % 4)
+# R4: distancia en bytes de S[ID] a S[ID + 1]
+# R5: ID del PE | P redondeado a potencia de 2 (bit centinela de la reduccion)
+# V0-V1: temporales, V2: acumulador vectorial
+
+# --- Codigo para calculo parcial ---
+MAIN:
+    LOAD F4, [R2]        # Carga acumulador inicial (S[ID])
+    VZERO V2             # Acumulador vectorial en cero
+    JNZ R3, VLOOP        # Hay al menos un vector completo
+    JNZ R7, TAIL         # Solo quedan elementos sueltos
+    JZ R7, REDUCE        # Tramo vacio
+
+VLOOP:
+    VLOAD V0, [R0]       # Carga A[i..i+3]
+    VLOAD V1, [R1]       # Carga B[i..i+3]
+    VFMA V2, V0, V1      # V2 += A * B
+    INC R0, 4            # Siguiente vector A (+32 bytes)
+    INC R1, 4            # Siguiente vector B (+32 bytes)
+    DEC R3               # Decrementa contador vectorial
+    JNZ R3, VLOOP        # Salta si no es cero
+
+    VREDUCE F5, V2       # F5 = suma horizontal de V2
+    FADD F4, F4, F5      # Acumula en F4
+    JZ R7, REDUCE        # No quedan elementos sueltos
+
+TAIL:
+    LOAD F5, [R0]        # Carga A[i]
+    LOAD F6, [R1]        # Carga B[i]
+    FMUL F5, F5, F6      # F5 = A[i] * B[i]
+    FADD F4, F4, F5      # Acumula en F4
+    INC R0               # Siguiente elemento A (+8 bytes)
+    INC R1               # Siguiente elemento B (+8 bytes)
+    DEC R7               # Decrementa sobrantes
+    JNZ R7, TAIL         # Salta si no es cero
+
+# --- Reduccion en arbol: log2(P) rondas separadas por BARRIER ---
+# En la ronda k, el PE con el bit k del ID en 0 suma S[ID + 2^k]; el que lo
+# tiene en 1 ya publico su parcial y termina. PE0 deja el total en S[0]
+REDUCE:
+    STORE F4, [R2]       # Publica la suma parcial S[ID]
+TREE:
+    ANDI R3, R5, 1       # Bit k del ID (tras la ultima ronda, el centinela)
+    JNZ R3, DONE         # Emisor, o PE0 con el total
+    BARRIER              # El socio ya publico S[ID + 2^k] (o termino)
+    LOAD F5, [R2 + R4]   # Carga S[ID + 2^k]
+    FADD F4, F4, F5      # Acumula en F4
+    STORE F4, [R2]       # S[ID] = suma del subarbol
+    SHLI R4, R4, 1       # Siguiente ronda: socio al doble de distancia
+    SHRI R5, R5, 1
+    JNZ R5, TREE         # R5 no llega a cero antes del centinela
+
+DONE:
+    HALT
@@ -9,6 +9,15 @@
 #include <fstream>
 #include <unordered_map>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
+#include <array>
+#include <cmath>
+#include <memory>
 
 // ImGui y backend SDL2 + OpenGL3
 #include "imgui/imgui.h"
@@ -19,10 +28,19 @@
 
 // Nuestros archivos del proyecto
 #include "cache.hpp"
+#include "l2_cache.hpp"
+#include "numa.hpp"
 #include "pe.h"
 #include "shared_memory.h"
 #include "shared_memory_adapter.h"
 #include "parser.h"
+#include "program_image.h"
+#include "optimizer.h"
+#include "partition.h"
+#include "report.h"
+#include "timeline.h"
+#include "watch.hpp"
+#include "undo.hpp"
 
 // Función auxiliar para formatear números grandes
 template<typename T>
@@ -32,362 +50,1020 @@ std::string format_number(T num) {
     return ss.str();
 }
 
-// CLASE PRINCIPAL DEL SISTEMA - Coordina todos los componentes del multiprocesador
+// PROGRAMAS DISPONIBLES - escalar y vectorial (VLOAD/VFMA)
+static const char* const kPrograms[] = { "dotprod.asm", "dotprod_simd.asm", "dotprod_atomic.asm", "dotprod_llsc.asm",
+                                          "dotprod_cyclic.asm", "dotprod_dynamic.asm" };
+// Estrategias de reparto, en el orden del enum Partition
+static const char* const kPartitions[] = { "block", "cyclic", "line", "dynamic", "guided" };
+// Prefetchers de L1 disponibles (make_prefetcher devuelve nullptr para "none")
+static const char* const kPrefetchers[] = { "none", "next", "stride" };
+// L2 compartida (geometria por defecto de L2Config)
+static const char* const kL2Modes[] = { "Sin L2", "Inclusiva", "No inclusiva" };
+// Memoria NUMA: ubicacion en el orden de NumaPlacement (demas parametros de NumaConfig)
+static const char* const kNumaModes[] = { "Uniforme", "local", "interleave", "node0" };
+// Metricas de los mapas de calor, en el orden de HeatMap::count (y el dueno al final)
+static const char* const kWatchKinds[] = { "r", "w", "rw", "mesi" };  // Orden de WatchKind
+static const char* const kHeatMetrics[] = { "Accesos L1", "Fallos L1", "Invalidaciones", "Trafico memoria", "Dueno" };
+constexpr int kHeatCounts = 4;
+
+// CONFIGURACIÓN DE LA SIMULACIÓN - la editan los controles y la aplica el hilo de simulación
+struct SimConfig {
+    int num_pes = 4;                 // PEs (y caches L1)
+    int N = 8;                       // Tamano de los vectores A y B
+    int program_idx = 0;             // Programa seleccionado en kPrograms
+    bool optimize_kernel = false;    // Pasar el programa por el optimizador
+    PartitionConfig part;            // Reparto del trabajo entre PEs
+    int prefetch_idx = 0;            // Prefetcher seleccionado en kPrefetchers
+    PrefetchConfig prefetch_cfg;     // Grado y distancia del prefetcher
+    int l2_idx = 0;                  // Modo de L2 en kL2Modes
+    int numa_idx = 0;                // Ubicacion NUMA en kNumaModes (excluye la L2)
+};
+
+// EDICIÓN DE WATCHPOINTS - la GUI la pide y el hilo de simulación la aplica
+// entre rondas (los ganchos leen la lista sin candado)
+struct WatchOp {
+    enum Kind { Add, Remove, ClearLog } op = Add;
+    WatchKind kind = WatchKind::Access;
+    uint64_t lo = 0, hi = 0;         // Add: bytes [lo, hi)
+    int id = 0;                      // Remove
+};
+
+// INSTANTÁNEA DEL SISTEMA - la arma el hilo de simulación entre lotes (con los
+// PEs detenidos) y la GUI solo la lee: dibujar nunca toca PEs, caches ni memoria
+struct PESnapshot {
+    int pc = 0;
+    bool halted = false, at_barrier = false;
+    int64_t r[kIntRegs] = {};
+    double f[kFpRegs] = {};
+    double v[kVecRegs][kVecLanes] = {};
+    decltype(PE::stats) stats;
+    int sb = 0;                      // Entradas ocupadas del store buffer
+};
+
+struct CacheSnapshot {
+    Stats stats;
+    std::string prefetcher;          // Vacío si la cache no tiene
+    std::vector<LineView> lines;     // kSets*kWays, por set
+};
+
+// MAPA DE CALOR - por bloque de memoria. Inmutable: las dos instantaneas lo
+// comparten y se rearma cada kHeatPeriodMs mientras corre (siempre en pausa)
+struct HeatMap {
+    std::array<std::vector<uint32_t>, kHeatCounts> count;  // Sumando las L1 (y memoria)
+    std::vector<int8_t> owner;  // PE con la copia en E/M, kShared (solo S) o kNone
+    static constexpr int8_t kNone = -1, kShared = -2;
+    size_t blocks() const { return owner.size(); }
+};
+constexpr int kHeatPeriodMs = 100;
+
+struct SharedBlock {
+    SharingTracker::BlockStats st;
+    int seg = -1;                    // Segmento dueno (-1 si ninguno)
+};
+
+struct Snapshot {
+    uint64_t gen = 0;                // Número de publicación
+    uint64_t rounds = 0;             // Rondas ejecutadas desde el último reinicio
+    double rounds_per_sec = 0.0;
+    SimConfig cfg;                   // Configuración con la que corre
+    std::string opt_summary;         // Reporte del optimizador
+    DotLayout L;
+    std::vector<PESnapshot> pes;
+    std::vector<CacheSnapshot> caches;
+    std::vector<double> A, B, S;     // Valores coherentes, leídos sin flush
+    double expected = 0.0;           // Producto punto secuencial de A y B
+    std::shared_ptr<const HeatMap> heat;
+    // Series de la linea de tiempo, de la muestra mas vieja a la mas nueva:
+    // [0] global, [1 + p] PE p (sin cola de memoria)
+    std::vector<std::array<std::vector<float>, kSeries>> timeline;
+    Imbalance imb;
+    CoherenceTraffic traffic;
+    bool has_l2 = false;
+    L2Stats l2;                      // Totales de la L2 (si has_l2)
+    bool has_numa = false;
+    NumaStats numa;                  // Totales NUMA (si has_numa)
+    size_t false_lines = 0;          // Líneas con false sharing del layout
+    std::vector<std::pair<std::string, MissCounts>> regions;
+    uint64_t true_sharing = 0, false_sharing = 0;
+    std::vector<SharedBlock> top_shared;
+    std::vector<Watchpoint> watches;
+    std::vector<std::string> watch_log;  // Disparos, el más nuevo al final
+    bool history = false;            // Graba el historial de paso atrás
+    uint64_t undo_steps = 0;         // Instrucciones que se pueden deshacer
+};
+
+// CLASE PRINCIPAL DEL SISTEMA - Coordina todos los componentes del multiprocesador.
+// La simulación corre en su propio hilo; la GUI le manda comandos y dibuja la
+// última instantánea publicada
 class GUISystem {
 private:
-    // COMPONENTES DEL SISTEMA MULTIPROCESADOR
+    // COMPONENTES DEL SISTEMA MULTIPROCESADOR - solo los toca el hilo de simulación
     std::shared_ptr<SharedMemory> shm;           // Memoria compartida (512 posiciones)
     std::unique_ptr<SharedMemoryAdapter> mem;    // Adaptador que conecta caches con memoria
     std::unique_ptr<Interconnect> bus;           // Bus de interconexión para protocolo MESI
+    std::unique_ptr<L2Cache> l2;                 // L2 compartida (nullptr: L1 directo a memoria)
+    std::unique_ptr<NumaMemory> numa;            // Memoria NUMA (nullptr: uniforme)
     std::vector<std::unique_ptr<Cache>> caches;  // 4 caches L1 privadas (una por PE)
     std::vector<std::unique_ptr<PE>> pes;        // 4 Processing Elements
-    
+    Watchpoints watches;                         // Sobreviven a los reinicios
+    std::vector<std::string> watch_log;          // Últimos disparos (kWatchLog)
+    static constexpr size_t kWatchLog = 100;
+    std::unique_ptr<UndoLog> history;            // Paso atrás (nullptr: no graba)
+
     // ESTADO Y CONFIGURACIÓN DEL SISTEMA
-    bool final_sum_executed = false;             // Controla si ya se ejecutó la suma final
-    std::vector<Instr> program;                  // Programa parseado (instrucciones)
-    std::unordered_map<std::string,size_t> labels; // Mapa de etiquetas (MAIN, LOOP, FINAL_SUM)
-    int N = 8;                                   // Tamano de los vectores A y B
-    std::atomic<bool> system_running{false};     // Indica si el sistema está activo
+    Barrier barrier;                             // BARRIER de los programas
+    ProgramPtr program;                          // Programa compartido por los PEs (y etiquetas)
+    std::string loaded_path;                     // Archivo del que viene 'program'
+    bool loaded_optimized = false;               // 'program' ya esta optimizado
+    std::string opt_summary;                     // Reporte del optimizador
+    SimConfig cfg;                               // Configuración aplicada
+    uint64_t rounds = 0;                         // Rondas desde el último reinicio
+    uint64_t published = 0;                      // Instantáneas publicadas
+    double rounds_per_sec = 0.0;
+    std::chrono::steady_clock::time_point rate_t0 = std::chrono::steady_clock::now();
+    uint64_t rate_rounds0 = 0;
+    std::chrono::steady_clock::time_point next_round;  // Modo con límite de velocidad
+    std::shared_ptr<const HeatMap> heat;               // Último mapa de calor
+    Timeline timeline;                                 // Anillos de muestras
+    std::chrono::steady_clock::time_point heat_t0;
+
+    // HILO DE SIMULACIÓN Y COMANDOS DE LA GUI
+    std::thread sim_thread;
+    std::atomic<bool> quit{false};
     std::atomic<bool> pause_execution{true};     // Control de pausa (inicia pausado)
-    std::atomic<bool> single_step{false};        // Bandera para modo paso a paso
-    int steps_per_frame = 1;                     // Pasos ejecutados por frame en modo continuo
+    std::atomic<int> step_requests{0};           // Pasos simples pedidos
+    std::atomic<int> back_requests{0};           // Pasos atrás pedidos
+    std::atomic<bool> record_history{true};      // Grabar el historial de paso atrás
+    std::atomic<int> batch_ms{8};                // Presupuesto de cada lote en modo continuo
+    std::atomic<int> rate_limit{0};              // Rondas por segundo (0 = sin límite)
+    std::atomic<int> sample_rounds{8};           // Rondas entre muestras de la línea de tiempo
+    std::mutex cmd_m;                            // Protege pending*
+    std::condition_variable cmd_cv;
+    std::atomic<bool> wake{false};               // Hay algo para el hilo de simulación
+    bool pending = false, pending_reset = false;
+    SimConfig pending_cfg;
+    std::vector<WatchOp> pending_watch;
+
+    // DOBLE BUFFER - el hilo de simulación escribe el que no es 'front'; la GUI
+    // fija en 'reader' el que dibuja y lo suelta al empezar el frame siguiente.
+    // Si la GUI aún tiene fijado el de atrás, se publica en el próximo lote
+    Snapshot snaps[2];
+    std::atomic<int> front{0};
+    std::atomic<int> reader{-1};
+    bool dirty = true;                           // Cambios sin publicar
+
+    // ESTADO DE LA GUI
+    SimConfig ui;                                // Lo que muestran los controles
+    int new_N = ui.N;                            // Tamano N aun sin aplicar
+    int heat_metric = 0;                         // Indice en kHeatMetrics
+    int heat_per_cell = 1;                       // Bloques agregados en cada celda
+    int watch_kind = 1;                          // Indice en kWatchKinds
+    int watch_addr = 0, watch_bytes = 8;         // Rango del próximo watchpoint
 
 public:
     // CONSTRUCTOR - Inicializa el sistema con 4 PEs y vectores de tamano 8
     GUISystem() {
-        initialize_system(4, 8);
+        initialize_system(ui);
+        publish();
+        sim_thread = std::thread(&GUISystem::sim_loop, this);
     }
 
-    // DESTRUCTOR - Garantiza apagado seguro de todos los componentes
+    // DESTRUCTOR - Detiene el hilo de simulación y apaga los componentes
     ~GUISystem() {
+        quit = true;
+        notify_sim();
+        if (sim_thread.joinable()) sim_thread.join();
         shutdown_system();
     }
 
     // APAGADO SEGURO - Detiene componentes en orden inverso a su creación
     void shutdown_system() {
-        system_running = false;
-        pause_execution = true;
-        
         // Limpiar en orden seguro (inverso al de creación)
+        history.reset();      // 0. Historial (apunta a PEs, caches y memoria)
         pes.clear();          // 1. Eliminar PEs (detienen ejecución)
         caches.clear();       // 2. Eliminar caches L1
-        
+        l2.reset();           //    y la L2 o los puertos NUMA que tenian debajo
+        numa.reset();
+
         if (mem) {
             mem.reset();      // 3. Eliminar adaptador de memoria
         }
-        
+
         if (shm) {
             shm->stop();      // 4. Detener memoria compartida (para hilo worker)
             shm.reset();
         }
-        
+
         bus.reset();          // 5. Eliminar bus de interconexión
     }
 
     // INICIALIZACIÓN DEL SISTEMA - Crea y configura todos los componentes
-    void initialize_system(int num_pes, int vector_size) {
+    void initialize_system(const SimConfig& c) {
         // Primero apagar el sistema anterior de forma segura
         shutdown_system();
-        
-        // Pequena pausa para asegurar limpieza completa
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        
-        N = vector_size;
-        
+
+        cfg = c;
+        rounds = rate_rounds0 = 0;
+        const int num_pes = cfg.num_pes;
+
         // CREAR COMPONENTES EN ORDEN JERÁRQUICO:
         // 1. Memoria compartida - almacenamiento principal
-        shm = std::make_shared<SharedMemory>(512);
+        shm = std::make_shared<SharedMemory>(std::max<size_t>(dot_layout(cfg.N, num_pes, cfg.part).words, 512));
+        add_dot_segments(*shm, cfg.N, num_pes, cfg.part);  // Dueno de cada zona (sharing)
         shm->start();  // Iniciar hilo worker para acceso asíncrono
-        
+
         // 2. Adaptador de memoria - traduce entre caches y memoria compartida
         mem = std::make_unique<SharedMemoryAdapter>(shm.get());
-        
+
         // 3. Bus de interconexión - comunicación para protocolo MESI
         bus = std::make_unique<Interconnect>();
-        
-        // 4. Caches L1 - una por PE, conectadas al bus y memoria
+
+        // 4. L2 compartida opcional y caches L1 - una por PE, conectadas al bus y a la L2 o la memoria
+        if (cfg.l2_idx > 0) {
+            L2Config l2cfg;
+            l2cfg.inclusive = cfg.l2_idx == 1;
+            l2 = std::make_unique<L2Cache>(mem.get(), bus.get(), l2cfg);
+        }
+        if (cfg.numa_idx > 0) {
+            NumaConfig ncfg;
+            ncfg.placement = NumaPlacement(cfg.numa_idx - 1);
+            numa = std::make_unique<NumaMemory>(mem.get(), ncfg, numa_homes(*shm, unsigned(num_pes), ncfg), unsigned(num_pes));
+        }
+        IMemory* below = l2 ? static_cast<IMemory*>(l2.get()) : mem.get();
         for (int i = 0; i < num_pes; ++i) {
-            caches.emplace_back(std::make_unique<Cache>(i, mem.get(), bus.get()));
+            caches.emplace_back(std::make_unique<Cache>(i, numa ? numa->port(i) : below, bus.get()));
+            caches.back()->set_prefetcher(make_prefetcher(kPrefetchers[cfg.prefetch_idx], cfg.prefetch_cfg));
         }
-        
+
         // 5. Processing Elements - unidades de ejecución con caché privada
         for (int i = 0; i < num_pes; ++i) {
             pes.emplace_back(std::make_unique<PE>(i, caches[i].get()));
+            pes.back()->set_barrier(&barrier);
         }
-        
+
         // CONFIGURACIÓN INICIAL DEL SISTEMA
         initialize_memory();  // Inicializar vectores A, B y sumas parciales S
         load_program();       // Cargar y configurar programa en todos los PEs
-        
-        // ESTADO INICIAL
-        system_running = true;
-        pause_execution = true; // Empezar en pausa para permitir inspección
-        single_step = false;
-        final_sum_executed = false; // Resetear bandera de suma final
+        timeline.reset(num_pes);
+        shm->take_peak_depth();  // La carga de memoria no cuenta para la cola
+        watches.take_hits();     // Disparos de la corrida anterior
+        arm_watches();           // Despues de cargar A y B: la carga no dispara
+        reset_history();         // El estado inicial es el origen del historial
+
+        dirty = true;  // Queda en pausa: la pidio request() (o el estado inicial)
     }
 
-    // INICIALIZACIÓN DE MEMORIA - Carga los vectores A, B y prepara sumas parciales
+    // INICIALIZACIÓN DE MEMORIA - vectores A, B, sumas parciales y tabla de chunks
     void initialize_memory() {
-        // LAYOUT DE MEMORIA:
-        // [0..N-1]: Vector A, [N..2N-1]: Vector B, [2N..2N+3]: Sumas parciales S
-        const size_t baseA_words = 0;
-        const size_t baseB_words = baseA_words + static_cast<size_t>(N);
-        const size_t baseS_words = baseB_words + static_cast<size_t>(N);
-        
-        // INICIALIZAR VECTOR A: A[i] = i + 1.0
-        // INICIALIZAR VECTOR B: B[i] = 2 * (i + 1.0)
-        for (int i = 0; i < N; ++i) {
-            mem->store64((baseA_words + i) * 8, double(i + 1));
-            mem->store64((baseB_words + i) * 8, double((i + 1) * 2));
-        }
-        
-        // INICIALIZAR SUMAS PARCIALES: S[0..3] = 0.0
-        for (size_t p = 0; p < pes.size(); ++p) {
-            mem->store64((baseS_words + p) * 8, 0.0);
-        }
+        init_dot_memory(*mem, cfg.N, pes.size(), cfg.part);
     }
 
     // CARGA DE PROGRAMA - Lee, parsea y configura el código ASM en todos los PEs
     void load_program() {
-        std::ifstream fin("dotprod.asm");
-        if (!fin) {
-            std::cerr << "Error: no se pudo abrir dotprod.asm\n";
-            return;
-        }
-        
-        // LEER ARCHIVO COMPLETO
-        std::stringstream buffer;
-        buffer << fin.rdbuf();
-        
-        // PARSEAR: convertir texto ASM a instrucciones ejecutables
-        parse_asm(buffer.str(), program, labels);
-        
-        // CONFIGURACIÓN DE DIRECCIONES DE MEMORIA
-        const size_t baseA_words = 0;
-        const size_t baseB_words = baseA_words + static_cast<size_t>(N);
-        const size_t baseS_words = baseB_words + static_cast<size_t>(N);
-        const size_t result_addr = baseS_words + pes.size(); // Posición resultado final
-        const int num_pes = pes.size();
-        
-        // REPARTO BALANCEADO DE TRABAJO - Divide N elementos entre num_pes PEs
-        const int base_len = N / num_pes;  // Elementos base por PE
-        const int rest = N % num_pes;      // Elementos sobrantes para distribuir
-        
-        // FUNCIONES LAMBDA para cálculo de segmentos por PE
-        auto start_index_of = [&](int pe) { 
-            return pe * base_len + std::min(pe, rest); 
-        };
-        auto len_of = [&](int pe) { 
-            return base_len + (pe < rest ? 1 : 0); 
-        };
-        
-        // CONFIGURAR CADA PE CON SU SEGMENTO CORRESPONDIENTE
-        for (int p = 0; p < num_pes; ++p) {
-            const int start = start_index_of(p); // Índice inicial en vectores A y B
-            const int len   = len_of(p);         // Número de elementos a procesar
-            
-            // Cargar programa idéntico en todos los PEs
-            pes[p]->load_program(program, labels);
-            
-            // CONFIGURAR REGISTROS PARA CÁLCULO PARCIAL:
-            pes[p]->set_reg_int(0, int((baseA_words + start) * 8));  // R0 = &A[inicio_segmento]
-            pes[p]->set_reg_int(1, int((baseB_words + start) * 8));  // R1 = &B[inicio_segmento]
-            pes[p]->set_reg_int(2, int((baseS_words + p) * 8));      // R2 = &S[p] (suma parcial)
-            pes[p]->set_reg_int(3, len);                             // R3 = iteraciones (contador)
-            pes[p]->set_reg_double(4, 0.0);                          // R4 = acumulador (inicia en 0.0)
-        }
-        
-        // INICIALIZAR POSICIÓN DE RESULTADO FINAL
-        mem->store64(result_addr * 8, 0.0);
-        final_sum_executed = false; // Resetear bandera de suma final
-    }
-
-    // EJECUCIÓN POR PASOS - Avanza la simulación según el modo actual
-    void step_system() {
-        if (!system_running) return;
-        
-        // MODO PASO A PASO - Ejecutar una sola instrucción por PE activo
-        if (single_step) {
-            for (auto& pe : pes) {
-                if (!pe->is_halted()) {
-                    pe->step(); // Ejecutar una instrucción
-                }
-            }
-            single_step = false;
-            pause_execution = true; // Volver a pausa después del paso
-            return;
-        }
-        
-        // MODO CONTINUO - Ejecutar múltiples pasos por frame de GUI
-        if (!pause_execution) {
-            for (int i = 0; i < steps_per_frame; ++i) {
-                bool any_advanced = false;
-                for (auto& pe : pes) {
-                    if (!pe->is_halted()) {
-                        pe->step();
-                        any_advanced = true;
-                    }
-                }
-                
-                // DETECCIÓN AUTOMÁTICA DE FINALIZACIÓN - pausar cuando ningún PE avanza
-                if (!any_advanced) {
-                    pause_execution = true;
-                    break;
-                }
+        // El programa solo se vuelve a cargar si cambio el archivo: los
+        // reinicios reutilizan las instrucciones ya ensambladas
+        const char* path = kPrograms[cfg.program_idx];
+        if (loaded_path != path || loaded_optimized != cfg.optimize_kernel) {
+            program = load_shared_program(path);
+            if (!program) { loaded_path.clear(); return; }
+            opt_summary.clear();
+            if (cfg.optimize_kernel) {
+                OptReport rep;
+                program = optimize_program(*program, OptConfig{}, &rep);
+                std::ostringstream os;
+                rep.print(os);
+                opt_summary = os.str();
             }
+            loaded_path = path;
+            loaded_optimized = cfg.optimize_kernel;
         }
+        // Registros de cada PE segun la estrategia de reparto
+        load_dot_program(pes, program, cfg.N, cfg.part);
+        barrier.reset(pes.size()); // Todos los PEs participan en cada BARRIER
     }
 
-    // RENDERIZADO PRINCIPAL DE LA GUI
+    // RENDERIZADO PRINCIPAL DE LA GUI - todo sale de la instantánea fijada
     void render_gui() {
+        const Snapshot& s = acquire_snapshot();
+
         // PANEL DE CONTROL PRINCIPAL
         ImGui::Begin("Control del Sistema");
-        
-        // BOTÓN REINICIAR 
+
+        // BOTÓN REINICIAR
         if (ImGui::Button("Reiniciar Sistema")) {
-            initialize_system(4, N);
+            request(true);
         }
-        
+
         ImGui::SameLine();
-        
+
         // BOTÓN CONTINUAR/PAUSAR - alterna ejecución continua
         if (ImGui::Button(pause_execution ? "Continuar" : "Pausar")) {
             pause_execution = !pause_execution;
-            single_step = false; // Cancelar paso simple si estaba activo
+            notify_sim();
         }
-        
+
         ImGui::SameLine();
-        
-        // BOTÓN PASO SIMPLE - ejecuta una instrucción por PE y vuelve a pausa
+
+        // BOTÓN PASO SIMPLE - ejecuta una instrucción por PE y queda en pausa
         if (ImGui::Button("Paso Simple")) {
-            single_step = true;
-            pause_execution = false; // Temporalmente permitir ejecución para el paso
-        }
-        
-        // CONTROL DE VELOCIDAD - pasos ejecutados por frame en modo continuo
-        ImGui::SliderInt("Pasos/Frame", &steps_per_frame, 1, 100);
-        
-        // CONTROL DE TAMANO DE VECTORES
-        static int new_N = N;
-        bool n_changed = ImGui::SliderInt("Tamaño N", &new_N, 1, 253);
+            pause_execution = true;
+            step_requests++;
+            notify_sim();
+        }
+
         ImGui::SameLine();
-        if (ImGui::Button("Aplicar N") || n_changed) {
-            if (new_N != N) {
-                initialize_system(4, new_N); // Reiniciar sistema con nuevo N
-                N = new_N;
-            }
+
+        // BOTÓN PASO ATRÁS - deshace la última ronda (si el historial la tiene)
+        if (ImGui::Button("Paso Atrás")) {
+            pause_execution = true;
+            back_requests++;
+            notify_sim();
         }
-        
+
+        // HISTORIAL - grabar cuesta velocidad en modo continuo
+        bool rec = record_history;
+        if (ImGui::Checkbox("Grabar historial (paso atrás)", &rec)) {
+            record_history = rec;
+            notify_sim();
+        }
+
+        // SELECCIÓN DE PROGRAMA - reinicia el sistema con el kernel elegido
+        if (ImGui::Combo("Programa", &ui.program_idx, kPrograms, IM_ARRAYSIZE(kPrograms))) {
+            request(true);
+        }
+
+        // OPTIMIZADOR - desenrolla los bucles del kernel (reinicia el sistema)
+        if (ImGui::Checkbox("Optimizar kernel (x4)", &ui.optimize_kernel)) {
+            request(true);
+        }
+        if (ui.optimize_kernel && !s.opt_summary.empty()) ImGui::TextUnformatted(s.opt_summary.c_str());
+
+        // REPARTO DE TRABAJO - cambia tambien al kernel de la estrategia
+        int part_idx = int(ui.part.kind);
+        bool part_changed = ImGui::Combo("Reparto", &part_idx, kPartitions, IM_ARRAYSIZE(kPartitions));
+        if (ui.part.kind == Partition::Dynamic || ui.part.kind == Partition::Guided)
+            part_changed |= ImGui::SliderInt("Chunk", &ui.part.chunk, 1, 32);
+        if (part_changed) {
+            ui.part.kind = Partition(part_idx);
+            const std::string kernel = partition_kernel(ui.part.kind);
+            for (int i = 0; i < IM_ARRAYSIZE(kPrograms); ++i)
+                if (kernel == kPrograms[i]) ui.program_idx = i;
+            request(true);
+        }
+
+        // LAYOUT - relleno a linea de cache para S[p] (sin false sharing)
+        bool padded = ui.part.layout == Layout::Padded;
+        if (ImGui::Checkbox("Sumas S en lineas propias", &padded)) {
+            ui.part.layout = padded ? Layout::Padded : Layout::Packed;
+            request(true);
+        }
+
+        // L2 COMPARTIDA - entre las L1 y la memoria (reinicia el sistema)
+        if (ImGui::Combo("L2", &ui.l2_idx, kL2Modes, IM_ARRAYSIZE(kL2Modes))) {
+            if (ui.l2_idx > 0) ui.numa_idx = 0;
+            request(true);
+        }
+        // MEMORIA NUMA - ubicacion de los bloques en 2 nodos (sin L2; reinicia)
+        if (ImGui::Combo("NUMA", &ui.numa_idx, kNumaModes, IM_ARRAYSIZE(kNumaModes))) {
+            if (ui.numa_idx > 0) ui.l2_idx = 0;
+            request(true);
+        }
+
+        // PREFETCHER DE L1 - se aplica en caliente a todas las caches
+        bool pf_changed = ImGui::Combo("Prefetcher", &ui.prefetch_idx, kPrefetchers, IM_ARRAYSIZE(kPrefetchers));
+        pf_changed |= ImGui::SliderInt("Grado", &ui.prefetch_cfg.degree, 1, 4);
+        pf_changed |= ImGui::SliderInt("Distancia", &ui.prefetch_cfg.distance, 1, 4);
+        if (pf_changed) {
+            request(false);
+        }
+
+        // CONTROL DE VELOCIDAD - el hilo de simulación corre lotes de 'Lote' ms
+        // entre instantáneas; con límite avanza ese número de rondas por segundo
+        int batch = batch_ms, limit = rate_limit;
+        if (ImGui::SliderInt("Lote (ms)", &batch, 1, 50)) batch_ms = batch;
+        if (ImGui::SliderInt("Rondas/s (0 = sin límite)", &limit, 0, 1000)) {
+            rate_limit = limit;
+            notify_sim();
+        }
+
+        // CONTROL DE TAMANO DE VECTORES - se aplica con el boton (reinicia)
+        if (ImGui::InputInt("Tamaño N", &new_N, 1, 1000)) new_N = std::clamp(new_N, 1, 1 << 20);
+        ImGui::SameLine();
+        if (ImGui::Button("Aplicar N") && new_N != ui.N) {
+            ui.N = new_N;
+            request(true); // Reiniciar sistema con nuevo N
+        }
+
         // INFORMACIÓN DE ESTADO GENERAL
         ImGui::Separator();
         int running_pes = 0;
-        for (auto& pe : pes) {
-            if (!pe->is_halted()) running_pes++;
+        for (const auto& pe : s.pes) {
+            if (!pe.halted) running_pes++;
         }
-        ImGui::Text("PEs ejecutando: %d/%zu", running_pes, pes.size());
+        ImGui::Text("PEs ejecutando: %d/%zu", running_pes, s.pes.size());
         ImGui::Text("Estado: %s", pause_execution ? "PAUSADO" : "EJECUTANDO");
-        if (single_step) {
-            ImGui::Text("Modo: Paso Simple");
-        }
-        ImGui::Text("Pasos por frame: %d", steps_per_frame);
-        
+        ImGui::Text("Rondas: %s", format_number(s.rounds).c_str());
+        if (s.history) ImGui::Text("Historial: %s instrucciones atrás", format_number(s.undo_steps).c_str());
+        else ImGui::Text("Historial: apagado");
+        if (!pause_execution) ImGui::Text("Velocidad: %.0f rondas/s", s.rounds_per_sec);
+        ImGui::Text("Instantánea #%s", format_number(s.gen).c_str());
+
         ImGui::End();
 
         // PANEL DE PROCESSING ELEMENTS - estado individual de cada PE
         ImGui::Begin("Processing Elements (PEs)");
-        
+
         if (ImGui::BeginTabBar("PEsTabs")) {
-            for (size_t i = 0; i < pes.size(); ++i) {
+            for (size_t i = 0; i < s.pes.size(); ++i) {
                 if (ImGui::BeginTabItem(("PE" + std::to_string(i)).c_str())) {
-                    render_pe_panel(i);
+                    render_pe_panel(s.pes[i]);
                     ImGui::EndTabItem();
                 }
             }
             ImGui::EndTabBar();
         }
-        
+
         ImGui::End();
 
         // PANEL DE CACHES L1 - estado y estadísticas de cada caché
         ImGui::Begin("Caches L1");
-        
+
         if (ImGui::BeginTabBar("CacheTabs")) {
-            for (size_t i = 0; i < caches.size(); ++i) {
+            for (size_t i = 0; i < s.caches.size(); ++i) {
                 if (ImGui::BeginTabItem(("Cache PE" + std::to_string(i)).c_str())) {
-                    render_cache_panel(i);
+                    render_cache_panel(s.caches[i]);
                     ImGui::EndTabItem();
                 }
             }
             ImGui::EndTabBar();
         }
-        
+
         ImGui::End();
 
         // PANEL DE MEMORIA PRINCIPAL - visualización de vectores A, B y sumas S
         ImGui::Begin("Memoria Principal");
-        render_memory_panel();
+        render_memory_panel(s);
+        ImGui::End();
+
+        // PANEL DE MAPA DE CALOR - contadores por bloque de toda la memoria
+        ImGui::Begin("Mapa de Calor");
+        render_heatmap_panel(s);
+        ImGui::End();
+
+        // PANEL DE LÍNEA DE TIEMPO - series muestreadas por la simulación
+        ImGui::Begin("Línea de Tiempo");
+        render_timeline_panel(s);
+        ImGui::End();
+
+        // PANEL DE WATCHPOINTS - detienen la ejecución al terminar la ronda
+        ImGui::Begin("Watchpoints");
+        render_watch_panel(s);
         ImGui::End();
 
         // PANEL DE ESTADÍSTICAS - métricas globales del sistema
         ImGui::Begin("Estadísticas");
-        render_stats_panel();
+        render_stats_panel(s);
         ImGui::End();
 
         // PANEL DE RESULTADOS - producto punto calculado y validación
         ImGui::Begin("Resultados");
-        render_results_panel();
+        render_results_panel(s);
         ImGui::End();
     }
 
 private:
+    // COMANDOS DE LA GUI - se aplican en el hilo de simulación antes del
+    // siguiente lote; varios pedidos seguidos se funden en uno con la última
+    // configuración (reset: reiniciar el sistema; si no, solo el prefetcher)
+    void request(bool reset) {
+        if (reset) pause_execution = true;  // Reiniciar deja en pausa para permitir inspección
+        {
+            std::lock_guard<std::mutex> lk(cmd_m);
+            pending = true;
+            pending_reset |= reset;
+            pending_cfg = ui;
+            wake = true;
+        }
+        cmd_cv.notify_one();
+    }
+
+    void request_watch(const WatchOp& op) {
+        {
+            std::lock_guard<std::mutex> lk(cmd_m);
+            pending_watch.push_back(op);
+            wake = true;
+        }
+        cmd_cv.notify_one();
+    }
+
+    void notify_sim() {
+        {
+            std::lock_guard<std::mutex> lk(cmd_m);
+            wake = true;
+        }
+        cmd_cv.notify_one();
+    }
+
+    // Espera un comando o hasta 'until' (hilo de simulación)
+    void wait_sim(std::chrono::steady_clock::time_point until) {
+        std::unique_lock<std::mutex> lk(cmd_m);
+        cmd_cv.wait_until(lk, until, [&]{ return wake.load(); });
+    }
+
+    void apply_commands() {
+        SimConfig c;
+        bool config, reset;
+        std::vector<WatchOp> ops;
+        {
+            std::lock_guard<std::mutex> lk(cmd_m);
+            wake = false;  // Lo que se pidio hasta aca se atiende en esta vuelta
+            ops.swap(pending_watch);
+            config = pending;
+            c = pending_cfg;
+            reset = pending_reset;
+            pending = pending_reset = false;
+        }
+        if (!ops.empty()) apply_watch_ops(ops);
+        if (!config) return;
+        if (reset) {
+            initialize_system(c);
+            return;
+        }
+        cfg.prefetch_idx = c.prefetch_idx;
+        cfg.prefetch_cfg = c.prefetch_cfg;
+        for (auto& cache : caches) cache->set_prefetcher(make_prefetcher(kPrefetchers[cfg.prefetch_idx], cfg.prefetch_cfg));
+        if (history) history->clear();  // Los deltas no deshacen el cambio de prefetcher
+        dirty = true;
+    }
+
+    // HILO DE SIMULACIÓN - comandos, pasos y publicación, sin esperar a la GUI
+    void sim_loop() {
+        using clock = std::chrono::steady_clock;
+        while (!quit) {
+            apply_commands();
+            if (record_history != bool(history)) reset_history();
+
+            // MODO PASO A PASO - una instrucción por PE activo por cada pedido
+            for (int n = back_requests.exchange(0); n > 0; --n) step_back();
+            for (int n = step_requests.exchange(0); n > 0; --n) step_round();
+
+            // MODO CONTINUO - lotes por tiempo en vez de pasos por frame
+            const bool running = !pause_execution;
+            if (running) run_batch();
+
+            publish();
+
+            // En pausa (o con la instantánea aún pendiente) dormir hasta un comando
+            if (!running || rate_limit > 0)
+                wait_sim(rate_limit > 0 && running ? next_round
+                                                   : clock::now() + std::chrono::milliseconds(dirty ? 2 : 100));
+        }
+    }
+
+    // UNA RONDA - una instrucción por PE activo; false si ya terminaron todos
+    bool step_round() {
+        bool any_advanced = false;
+        for (auto& pe : pes) {
+            if (!pe->is_halted()) {
+                if (history) history->step(pe->pe_id(), !any_advanced);  // Cada ronda es un grupo
+                else pe->step();
+                any_advanced = true;
+            }
+        }
+        if (any_advanced) {
+            rounds++;
+            dirty = true;
+            if (rounds % uint64_t(std::max(1, sample_rounds.load())) == 0) sample_timeline();
+        } else {
+            sample_timeline();  // El último tramo (reducción final) aunque no complete el período
+        }
+        if (watches.triggered()) take_watch_hits();
+        return any_advanced;
+    }
+
+    // PASO ATRÁS - deshace la última ronda grabada
+    void step_back() {
+        if (!history || !history->back_group()) return;
+        rounds--;
+        timeline.rebase(pes, caches, rounds);  // Las muestras no retroceden
+        dirty = true;
+    }
+
+    void reset_history() {
+        history.reset();
+        if (record_history) history = std::make_unique<UndoLog>(pes, caches, *shm, barrier, l2.get(), numa.get());
+        dirty = true;
+    }
+
+    // WATCHPOINTS - ganchos en caches y memoria solo si hay alguno
+    void arm_watches() {
+        Watchpoints* w = watches.empty() ? nullptr : &watches;
+        shm->set_watch(w);
+        for (auto& cache : caches) cache->set_watch(w);
+    }
+
+    void apply_watch_ops(const std::vector<WatchOp>& ops) {
+        for (const WatchOp& op : ops) {
+            if (op.op == WatchOp::Add) watches.add(op.kind, op.lo, op.hi);
+            else if (op.op == WatchOp::Remove) watches.remove(op.id);
+            else watch_log.clear();
+        }
+        arm_watches();
+        dirty = true;
+    }
+
+    // Un disparo pausa la ejecución (al terminar la ronda) y queda en el registro
+    void take_watch_hits() {
+        uint64_t dropped = 0;
+        for (const WatchHit& h : watches.take_hits(&dropped)) {
+            std::ostringstream os;
+            os << "ronda " << rounds << ": ";
+            print_watch_hit(os, h);
+            std::string line = os.str();
+            line.pop_back();  // '\n'
+            watch_log.push_back(std::move(line));
+        }
+        if (dropped) watch_log.push_back("(" + std::to_string(dropped) + " disparos más)");
+        if (watch_log.size() > kWatchLog) watch_log.erase(watch_log.begin(), watch_log.end() - kWatchLog);
+        pause_execution = true;
+        dirty = true;
+    }
+
+    void sample_timeline() { timeline.sample(pes, caches, *shm, rounds); }
+
+    // LOTE EN MODO CONTINUO - sin límite corre 'batch_ms' ms; con límite, una
+    // ronda y sim_loop espera hasta que toque la siguiente
+    void run_batch() {
+        using clock = std::chrono::steady_clock;
+        const int limit = rate_limit;
+        if (limit > 0) {
+            const auto now = clock::now();
+            next_round = std::max(next_round, now - std::chrono::milliseconds(100)) +
+                         std::chrono::microseconds(1000000 / limit);
+            if (!step_round()) pause_execution = true;
+            return;
+        }
+        const auto deadline = clock::now() + std::chrono::milliseconds(batch_ms.load());
+        do {
+            for (int i = 0; i < 64; ++i) {  // Revisar el reloj cada 64 rondas
+                // DETECCIÓN AUTOMÁTICA DE FINALIZACIÓN - pausar cuando ningún PE avanza
+                if (!step_round()) {
+                    pause_execution = true;
+                    return;
+                }
+                if (pause_execution) return;  // Disparó un watchpoint
+            }
+        } while (clock::now() < deadline && !wake);
+    }
+
+    // PUBLICACIÓN - arma la instantánea en el buffer de atrás y lo pasa al frente
+    void publish() {
+        if (!dirty) return;
+        const int back = 1 - front.load();
+        if (reader.load() == back) return;  // La GUI aún dibuja con él
+        capture(snaps[back]);
+        front.store(back);
+        dirty = false;
+    }
+
+    // La GUI fija el buffer del frente para todo el frame (sin candados)
+    const Snapshot& acquire_snapshot() {
+        int i;
+        do {
+            i = front.load();
+            reader.store(i);
+        } while (front.load() != i);
+        return snaps[i];
+    }
+
+    // LECTURA COHERENTE SIN EFECTOS - la memoria y encima las copias válidas de
+    // las L1 ya copiadas en la instantánea (si hay una en M es la única).
+    // count palabras desde base, cada stride. No hace flush ni cambia estados MESI
+    void coherent_words(const Snapshot& s, size_t base, size_t count, size_t stride,
+                        std::vector<double>& out) const {
+        out.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            const uint64_t raw = shm->peek_word(uint32_t(base + i * stride));
+            std::memcpy(&out[i], &raw, sizeof(double));
+        }
+        for (const CacheSnapshot& c : s.caches) {
+            for (size_t i = 0; i < c.lines.size(); ++i) {
+                const LineView& l = c.lines[i];
+                if (l.state == MESI::Invalid) continue;
+                const size_t word0 = Address::join(l.tag, uint32_t(i / hw::kWays)) / 8;
+                for (size_t k = 0; k < hw::kBlockBytes / 8; ++k) {
+                    const size_t w = word0 + k;
+                    if (w < base || (w - base) % stride || (w - base) / stride >= count) continue;
+                    std::memcpy(&out[(w - base) / stride], &l.data[k * 8], sizeof(double));
+                }
+            }
+        }
+    }
+
+    // MAPA DE CALOR - contadores de cada L1 y de la memoria, y el dueno actual
+    std::shared_ptr<const HeatMap> capture_heat(const Snapshot& s) const {
+        auto h = std::make_shared<HeatMap>();
+        const size_t n = shm->size_blocks();
+        for (auto& v : h->count) v.assign(n, 0);
+        h->owner.assign(n, HeatMap::kNone);
+        for (const auto& cache : caches) {
+            const std::vector<BlockHeat>& bh = cache->heat();
+            for (size_t b = 0; b < std::min(n, bh.size()); ++b) {
+                h->count[0][b] += bh[b].accesses.load(std::memory_order_relaxed);
+                h->count[1][b] += bh[b].misses.load(std::memory_order_relaxed);
+                h->count[2][b] += bh[b].invalidations.load(std::memory_order_relaxed);
+            }
+        }
+        for (size_t b = 0; b < n; ++b) h->count[3][b] = shm->block_traffic(uint32_t(b));
+        for (size_t p = 0; p < s.caches.size(); ++p) {
+            const std::vector<LineView>& lines = s.caches[p].lines;
+            for (size_t i = 0; i < lines.size(); ++i) {
+                const LineView& l = lines[i];
+                if (l.state == MESI::Invalid) continue;
+                const size_t b = Address::join(l.tag, uint32_t(i / hw::kWays)) / hw::kBlockBytes;
+                if (b >= n) continue;
+                h->owner[b] = l.state == MESI::Shared ? HeatMap::kShared : int8_t(p);
+            }
+        }
+        return h;
+    }
+
+    // CAPTURA - hilo de simulación, entre rondas: ningún acceso en curso
+    void capture(Snapshot& s) {
+        const auto now = std::chrono::steady_clock::now();
+        const double dt = std::chrono::duration<double>(now - rate_t0).count();
+        if (dt >= 0.5 || rounds < rate_rounds0) {
+            rounds_per_sec = rounds >= rate_rounds0 ? (rounds - rate_rounds0) / dt : 0.0;
+            rate_t0 = now;
+            rate_rounds0 = rounds;
+        }
+        s.gen = ++published;
+        s.rounds = rounds;
+        s.rounds_per_sec = rounds_per_sec;
+        s.cfg = cfg;
+        s.opt_summary = opt_summary;
+        s.history = bool(history);
+        s.undo_steps = history ? history->steps() - history->oldest() : 0;
+
+        const unsigned P = pes.size();
+        s.L = dot_layout(cfg.N, P, cfg.part);
+        s.pes.resize(P);
+        for (unsigned p = 0; p < P; ++p) {
+            const PE& pe = *pes[p];
+            PESnapshot& d = s.pes[p];
+            d.pc = pe.get_pc();
+            d.halted = pe.is_halted();
+            d.at_barrier = pe.at_barrier();
+            for (int i = 0; i < kIntRegs; ++i) d.r[i] = pe.get_reg_int(i);
+            for (int i = 0; i < kFpRegs; ++i) d.f[i] = pe.get_reg_double(i);
+            for (int v = 0; v < kVecRegs; ++v) std::memcpy(d.v[v], pe.get_vreg(v), sizeof(d.v[v]));
+            d.stats = pe.stats;
+            d.sb = pe.store_buffer_size();
+        }
+        s.caches.resize(P);
+        for (unsigned p = 0; p < P; ++p) {
+            const Cache& c = *caches[p];
+            s.caches[p].stats = c.stats();
+            s.caches[p].prefetcher = c.prefetcher() ? c.prefetcher()->name() : "";
+            c.copy_lines(s.caches[p].lines);
+        }
+
+        coherent_words(s, s.L.baseA, cfg.N, 1, s.A);
+        coherent_words(s, s.L.baseB, cfg.N, 1, s.B);
+        coherent_words(s, s.L.baseS, P, s.L.strideS, s.S);
+        s.expected = 0.0;
+        for (int i = 0; i < cfg.N; ++i) s.expected += s.A[i] * s.B[i];
+
+        // El mapa de calor recorre toda la memoria: mientras corre, cada tanto
+        if (!heat || pause_execution || now - heat_t0 >= std::chrono::milliseconds(kHeatPeriodMs)) {
+            heat = capture_heat(s);
+            heat_t0 = now;
+        }
+        s.heat = heat;
+
+        s.timeline.resize(P + 1);
+        for (int t = 0; t <= int(P); ++t)
+            for (size_t k = 0; k < kSeries; ++k) timeline.series(t - 1, Series(k)).copy_to(s.timeline[t][k]);
+
+        s.imb = load_imbalance(pes);
+        s.traffic = coherence_traffic(caches);
+        s.has_l2 = bool(l2);
+        if (l2) s.l2 = l2->stats();
+        s.has_numa = bool(numa);
+        if (numa) s.numa = numa->total();
+        s.false_lines = false_shared_lines(s.L, P, cfg.part);
+        s.regions = misses_by_region(caches, s.L);
+        const SharingTracker& sh = bus->sharing();
+        s.true_sharing = sh.true_sharing();
+        s.false_sharing = sh.false_sharing();
+        s.top_shared.clear();
+        for (const auto& b : sh.top(3)) s.top_shared.push_back({b, shm->owner_segment(uint32_t(b.block))});
+        s.watches = watches.list();
+        s.watch_log = watch_log;
+    }
+
+    // COLORES DEL MAPA - escala logaritmica de azul oscuro a amarillo; el dueno
+    // con un color por PE (gris: compartido en S)
+    static ImU32 heat_color(uint32_t v, uint32_t max) {
+        if (!v || !max) return IM_COL32(35, 35, 40, 255);
+        const float t = std::log1p(float(v)) / std::log1p(float(max));
+        return IM_COL32(int(40 + 215 * t), int(40 + 180 * t * t), int(120 * (1.0f - t)), 255);
+    }
+    static ImU32 owner_color(int owner) {
+        static const ImU32 kPe[] = { IM_COL32(230, 80, 80, 255), IM_COL32(80, 200, 90, 255),
+                                     IM_COL32(80, 130, 240, 255), IM_COL32(230, 200, 60, 255),
+                                     IM_COL32(200, 90, 220, 255), IM_COL32(70, 210, 210, 255),
+                                     IM_COL32(240, 150, 60, 255), IM_COL32(160, 160, 240, 255) };
+        if (owner == HeatMap::kNone) return IM_COL32(35, 35, 40, 255);
+        if (owner == HeatMap::kShared) return IM_COL32(150, 150, 150, 255);
+        return kPe[owner % IM_ARRAYSIZE(kPe)];
+    }
+
+    // RENDERIZADO DEL MAPA DE CALOR - una celda por 'heat_per_cell' bloques; solo
+    // se dibujan las filas visibles (ListClipper), asi que escala con N
+    void render_heatmap_panel(const Snapshot& s) {
+        if (!s.heat || !s.heat->blocks()) return;
+        const HeatMap& h = *s.heat;
+        ImGui::Combo("Metrica", &heat_metric, kHeatMetrics, IM_ARRAYSIZE(kHeatMetrics));
+        ImGui::SliderInt("Bloques por celda", &heat_per_cell, 1, 256);
+        const bool owners = heat_metric == kHeatCounts;
+
+        const size_t per = size_t(heat_per_cell);
+        const size_t cells = (h.blocks() + per - 1) / per;
+        auto cell_value = [&](size_t c) {
+            uint32_t v = 0;
+            for (size_t b = c * per; b < std::min(h.blocks(), (c + 1) * per); ++b) v += h.count[heat_metric][b];
+            return v;
+        };
+        auto cell_owner = [&](size_t c) {
+            int o = HeatMap::kNone;
+            for (size_t b = c * per; b < std::min(h.blocks(), (c + 1) * per); ++b) {
+                if (h.owner[b] == HeatMap::kNone) continue;
+                o = (o == HeatMap::kNone || o == h.owner[b]) ? h.owner[b] : HeatMap::kShared;
+            }
+            return o;
+        };
+        uint32_t max = 0;
+        if (!owners)
+            for (size_t c = 0; c < cells; ++c) max = std::max(max, cell_value(c));
+
+        if (owners) {
+            for (size_t p = 0; p < s.pes.size(); ++p) {
+                ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(owner_color(int(p))), "PE%zu", p);
+                ImGui::SameLine();
+            }
+            ImGui::TextColored(ImGui::ColorConvertU32ToFloat4(owner_color(HeatMap::kShared)), "compartido");
+        } else {
+            ImGui::Text("%zu bloques (%zu celdas), maximo por celda: %u", h.blocks(), cells, max);
+        }
+
+        if (ImGui::BeginChild("HeatGrid", ImVec2(0, 0), true)) {
+            const float cell = 10.0f;
+            const size_t cols = std::max<size_t>(1, size_t(ImGui::GetContentRegionAvail().x / cell));
+            const size_t rows = (cells + cols - 1) / cols;
+            ImDrawList* dl = ImGui::GetWindowDrawList();
+            ImGuiListClipper clipper;
+            clipper.Begin(int(rows), cell);
+            while (clipper.Step()) {
+                for (int r = clipper.DisplayStart; r < clipper.DisplayEnd; ++r) {
+                    const ImVec2 p0 = ImGui::GetCursorScreenPos();
+                    for (size_t c = size_t(r) * cols; c < std::min(cells, size_t(r + 1) * cols); ++c) {
+                        const ImVec2 a(p0.x + (c % cols) * cell, p0.y);
+                        const ImVec2 b(a.x + cell - 1, a.y + cell - 1);
+                        dl->AddRectFilled(a, b, owners ? owner_color(cell_owner(c)) : heat_color(cell_value(c), max));
+                        if (ImGui::IsMouseHoveringRect(a, b)) render_heat_tooltip(s, c * per, std::min(h.blocks(), (c + 1) * per));
+                    }
+                    ImGui::Dummy(ImVec2(cols * cell, cell));
+                }
+            }
+            clipper.End();
+        }
+        ImGui::EndChild();
+    }
+
+    // RENDERIZADO DE LÍNEA DE TIEMPO - una pestana global y una por PE; cada
+    // serie con su último valor encima
+    void render_timeline_panel(const Snapshot& s) {
+        int period = sample_rounds;
+        if (ImGui::SliderInt("Rondas por muestra", &period, 1, 256)) sample_rounds = period;
+        if (s.timeline.empty()) return;
+        ImGui::Text("Últimas %zu muestras (hasta %zu)", s.timeline[0][0].size(), Timeline::kSamples);
+        if (!ImGui::BeginTabBar("TimelineTabs")) return;
+        for (size_t t = 0; t < s.timeline.size(); ++t) {
+            if (!ImGui::BeginTabItem(t ? ("PE" + std::to_string(t - 1)).c_str() : "Global")) continue;
+            for (size_t k = 0; k < kSeries; ++k) {
+                const std::vector<float>& v = s.timeline[t][k];
+                if (v.empty()) continue;
+                char overlay[32];
+                std::snprintf(overlay, sizeof(overlay), "%.2f", v.back());
+                const bool pct = Series(k) == Series::HitRate;
+                ImGui::PlotLines(series_name(Series(k)), v.data(), int(v.size()), 0, overlay,
+                                 pct ? 0.0f : FLT_MAX, pct ? 100.0f : FLT_MAX, ImVec2(0, 60));
+            }
+            ImGui::EndTabItem();
+        }
+        ImGui::EndTabBar();
+    }
+
+    // Bloques [b0, b1) bajo el cursor: direcciones, zona del layout y contadores
+    void render_heat_tooltip(const Snapshot& s, size_t b0, size_t b1) {
+        const HeatMap& h = *s.heat;
+        uint64_t sum[kHeatCounts] = {};
+        for (size_t b = b0; b < b1; ++b)
+            for (int k = 0; k < kHeatCounts; ++k) sum[k] += h.count[k][b];
+        const int owner = b1 - b0 == 1 ? h.owner[b0] : HeatMap::kNone;
+        std::string who = owner == HeatMap::kShared ? "compartido" : owner >= 0 ? "PE" + std::to_string(owner) : "-";
+        ImGui::SetTooltip("Bloques 0x%llx-0x%llx (M[%zu..%zu], zona %s)\n"
+                          "Accesos L1 %llu, fallos %llu, invalidaciones %llu, trafico memoria %llu\nDueno: %s",
+                          (unsigned long long)(b0 * hw::kBlockBytes), (unsigned long long)(b1 * hw::kBlockBytes - 1),
+                          b0 * hw::kBlockBytes / 8, b1 * hw::kBlockBytes / 8 - 1,
+                          dot_region(s.L, b0 * hw::kBlockBytes),
+                          (unsigned long long)sum[0], (unsigned long long)sum[1],
+                          (unsigned long long)sum[2], (unsigned long long)sum[3], who.c_str());
+    }
+
     // RENDERIZADO DE PANEL DE PE INDIVIDUAL - muestra estado y registros
-    void render_pe_panel(int pe_id) {
-        auto& pe = pes[pe_id];
-        
+    void render_pe_panel(const PESnapshot& pe) {
         // INFORMACIÓN BÁSICA DEL PE
-        ImGui::Text("PC: %d", pe->get_pc());
-        ImGui::Text("Estado: %s", pe->is_halted() ? "HALTED" : "RUNNING");
-        
+        ImGui::Text("PC: %d", pe.pc);
+        ImGui::Text("Estado: %s", pe.halted ? "HALTED" : pe.at_barrier ? "BARRIER" : "RUNNING");
+
         ImGui::Separator();
         ImGui::Text("Registros:");
-        
-        // MOSTRAR LOS 8 REGISTROS (R0-R7) como doubles y enteros
-        for (int i = 0; i < 8; ++i) {
-            double reg_val = pe->get_reg_double(i);
-            ImGui::Text("R%d: %.2f (int: %d)", i, reg_val, pe->get_reg_int(i));
+
+        // BANCOS ENTERO (R0-R7) Y DE PUNTO FLOTANTE (F0-F15)
+        for (int i = 0; i < kFpRegs; ++i) {
+            if (i < kIntRegs) ImGui::Text("R%d: %lld", i, (long long)pe.r[i]);
+            else ImGui::Text(" ");
+            ImGui::SameLine(140);
+            ImGui::Text("F%d: %.2f", i, pe.f[i]);
         }
-        
+
+        // REGISTROS VECTORIALES (V0-V7), 4 doubles cada uno
+        for (int v = 0; v < kVecRegs; ++v) {
+            const double* l = pe.v[v];
+            ImGui::Text("V%d: [%.2f, %.2f, %.2f, %.2f]", v, l[0], l[1], l[2], l[3]);
+        }
+
         // ESTADÍSTICAS SIMPLES DEL PE
         ImGui::Separator();
         ImGui::Text("Estadísticas PE:");
-        ImGui::Text("Loads: %s", format_number(pe->stats.loads).c_str());
-        ImGui::Text("Stores: %s", format_number(pe->stats.stores).c_str());
+        ImGui::Text("Instrucciones: %s", format_number(pe.stats.instrs).c_str());
+        ImGui::Text("Loads: %s", format_number(pe.stats.loads).c_str());
+        ImGui::Text("Stores: %s", format_number(pe.stats.stores).c_str());
+        ImGui::Text("Esperas load-use: %s", format_number(pe.stats.load_use_stalls).c_str());
+        ImGui::Text("Store buffer: %d/%d", pe.sb, PE::kSbEntries);
+        ImGui::Text("Esperas SB lleno: %s", format_number(pe.stats.sb_full_stalls).c_str());
+        ImGui::Text("Loads desde SB: %s", format_number(pe.stats.sb_forwards).c_str());
+        ImGui::Text("Esperas en barrera: %s", format_number(pe.stats.barrier_stalls).c_str());
     }
 
     // RENDERIZADO DE PANEL DE CACHÉ - muestra estadísticas y estado de líneas
-    void render_cache_panel(int cache_id) {
-        auto& cache = caches[cache_id];
-        auto& stats = cache->stats();
-        
+    void render_cache_panel(const CacheSnapshot& cache) {
+        const Stats& stats = cache.stats;
+
         // ESTADÍSTICAS DE LA CACHÉ
         ImGui::Text("Estadísticas Cache:");
         ImGui::Text("Reads: %s", format_number(stats.read_ops).c_str());
         ImGui::Text("Writes: %s", format_number(stats.write_ops).c_str());
         ImGui::Text("Misses: %s", format_number(stats.misses).c_str());
+        ImGui::Text("  compulsory %s, capacity %s, conflict %s, coherence %s",
+                    format_number(stats.miss_compulsory).c_str(), format_number(stats.miss_capacity).c_str(),
+                    format_number(stats.miss_conflict).c_str(), format_number(stats.miss_coherence).c_str());
         ImGui::Text("Invalidations: %s", format_number(stats.invalidations).c_str());
         ImGui::Text("Mensajes Bus: %s", format_number(stats.bus_msgs).c_str());
         ImGui::Text("Write-backs: %s", format_number(stats.writebacks).c_str());
-        ImGui::Text("Upgrades a M: %s", format_number(stats.upgrades).c_str()); 
-        
+        ImGui::Text("Upgrades a M: %s", format_number(stats.upgrades).c_str());
+        ImGui::Text("Fallos unidos (MSHR): %s", format_number(stats.mshr_merges).c_str());
+        ImGui::Text("Esperas de llenado: %s", format_number(stats.fill_waits).c_str());
+        if (!cache.prefetcher.empty()) {
+            ImGui::Text("Prefetch (%s): %s emitidos, %s utiles, %s tardios",
+                        cache.prefetcher.c_str(),
+                        format_number(stats.prefetches).c_str(),
+                        format_number(stats.prefetch_useful).c_str(),
+                        format_number(stats.prefetch_late).c_str());
+            ImGui::Text("Prefetch inutiles/descartados: %s / %s",
+                        format_number(stats.prefetch_useless).c_str(),
+                        format_number(stats.prefetch_dropped).c_str());
+        }
+        if (stats.atomic_ops) {
+            ImGui::Text("Atomicas: %s (%s por bus)", format_number(stats.atomic_ops).c_str(),
+                        format_number(stats.atomic_misses).c_str());
+            ImGui::Text("Fallos CAS/SC: %s / %s, reservas rotas: %s",
+                        format_number(stats.cas_failures).c_str(),
+                        format_number(stats.sc_failures).c_str(),
+                        format_number(stats.link_breaks).c_str());
+        }
+
         // CÁLCULO DE TASA DE ACIERTOS (HIT RATE)
-        float hit_rate = stats.read_ops > 0 ? 
+        float hit_rate = stats.read_ops > 0 ?
             (1.0f - (float)stats.misses / stats.read_ops) * 100.0f : 0.0f;
         ImGui::Text("Hit Rate: %.2f%%", hit_rate);
-        
+
         // ESTADO DETALLADO DE LÍNEAS DE CACHÉ
         ImGui::Separator();
         ImGui::Text("Estado de Líneas de Cache:");
-        
+
         if (ImGui::BeginChild("CacheLines", ImVec2(0, 300), true)) {
             // RECORRER TODOS LOS SETS (8 sets en total)
             for (uint32_t set = 0; set < hw::kSets; ++set) {
@@ -395,13 +1071,12 @@ private:
                 if (ImGui::TreeNode((void*)(intptr_t)set, "Set %d", set)) {
                     // RECORRER AMBOS WAYS POR SET (2-way associative)
                     for (uint32_t way = 0; way < hw::kWays; ++way) {
-                        MESI state = cache->get_state(set, way);
-                        uint64_t tag = cache->get_tag(set, way);
-                        bool recent = cache->get_recent(set, way);
-                        
+                        const LineView& l = cache.lines[set * hw::kWays + way];
+
                         // MOSTRAR INFORMACIÓN DE LA LÍNEA
-                        ImGui::Text("Way %d: Tag=0x%lX State=%s LRU=%s",
-                                   way, tag, mesi_str(state), recent ? "1" : "0");
+                        ImGui::Text("Way %d: Tag=0x%lX State=%s LRU=%s%s",
+                                   way, l.tag, mesi_str(l.state), l.recent ? "1" : "0",
+                                   l.pending ? " (llenado en vuelo)" : "");
                     }
                     ImGui::TreePop();
                 }
@@ -412,61 +1087,62 @@ private:
     }
 
     // RENDERIZADO DE PANEL DE MEMORIA - muestra vectores A, B y sumas parciales
-    void render_memory_panel() {
-        const size_t baseA_words = 0;
-        const size_t baseB_words = baseA_words + static_cast<size_t>(N);
-        const size_t baseS_words = baseB_words + static_cast<size_t>(N);
-        
+    void render_memory_panel(const Snapshot& s) {
         // PESTANAS PARA DIFERENTES SECCIONES DE MEMORIA
         if (ImGui::BeginTabBar("MemoryTabs")) {
             if (ImGui::BeginTabItem("Vector A")) {
-                render_memory_segment(baseA_words, N, "A");
+                render_memory_segment(s.A, "A");
                 ImGui::EndTabItem();
             }
             if (ImGui::BeginTabItem("Vector B")) {
-                render_memory_segment(baseB_words, N, "B");
+                render_memory_segment(s.B, "B");
                 ImGui::EndTabItem();
             }
             if (ImGui::BeginTabItem("Sumas S")) {
-                render_memory_segment(baseS_words, pes.size(), "S");
+                render_memory_segment(s.S, "S");
                 ImGui::EndTabItem();
             }
             ImGui::EndTabBar();
         }
     }
 
-    // RENDERIZADO DE SEGMENTO DE MEMORIA - muestra un rango de direcciones
-    void render_memory_segment(size_t base, size_t count, const char* prefix) {
+    // RENDERIZADO DE SEGMENTO DE MEMORIA - valores copiados en la instantánea;
+    // solo las filas visibles (ListClipper)
+    void render_memory_segment(const std::vector<double>& values, const char* prefix) {
         if (ImGui::BeginChild("MemoryView", ImVec2(0, 300), true)) {
-            for (size_t i = 0; i < count; ++i) {
-                double value = mem->load64((base + i) * 8);
-                ImGui::Text("%s[%zu] = %.2f", prefix, i, value);
+            ImGuiListClipper clipper;
+            clipper.Begin(int(values.size()));
+            while (clipper.Step()) {
+                for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+                    ImGui::Text("%s[%d] = %.2f", prefix, i, values[i]);
+                }
             }
-            ImGui::EndChild();
+            clipper.End();
         }
+        ImGui::EndChild();
     }
 
     // RENDERIZADO DE ESTADÍSTICAS GLOBALES - suma estadísticas de todas las caches
-    void render_stats_panel() {
+    void render_stats_panel(const Snapshot& s) {
         ImGui::Text("Estadísticas Globales del Sistema:");
         ImGui::Separator();
-        
+
         // ACUMULAR ESTADÍSTICAS DE TODAS LAS CACHES
         uint64_t total_reads = 0, total_writes = 0, total_misses = 0;
         uint64_t total_invalidations = 0, total_bus_msgs = 0;
-        uint64_t total_writebacks = 0, total_upgrades = 0; 
-        
-        for (auto& cache : caches) {
-            auto& stats = cache->stats();
+        uint64_t total_writebacks = 0, total_upgrades = 0;
+
+        for (const auto& cache : s.caches) {
+            const Stats& stats = cache.stats;
             total_reads += stats.read_ops;
             total_writes += stats.write_ops;
             total_misses += stats.misses;
             total_invalidations += stats.invalidations;
             total_bus_msgs += stats.bus_msgs;
             total_writebacks += stats.writebacks;
-            total_upgrades += stats.upgrades; 
+            total_upgrades += stats.upgrades;
         }
-        
+
         // MOSTRAR ESTADÍSTICAS ACUMULADAS
         ImGui::Text("Total Reads: %s", format_number(total_reads).c_str());
         ImGui::Text("Total Writes: %s", format_number(total_writes).c_str());
@@ -475,75 +1151,124 @@ private:
         ImGui::Text("Total Mensajes Bus: %s", format_number(total_bus_msgs).c_str());
         ImGui::Text("Total Write-backs: %s", format_number(total_writebacks).c_str());
         ImGui::Text("Total Upgrades a M: %s", format_number(total_upgrades).c_str());
-        
+
         // CALCULAR Y MOSTRAR HIT RATE GLOBAL
-        float global_hit_rate = total_reads > 0 ? 
+        float global_hit_rate = total_reads > 0 ?
             (1.0f - (float)total_misses / total_reads) * 100.0f : 0.0f;
         ImGui::Text("Hit Rate Global: %.2f%%", global_hit_rate);
+
+        // FALLOS POR TIPO Y ZONA DEL LAYOUT (3C + coherencia)
+        ImGui::Separator();
+        ImGui::Text("Fallos por zona: compulsory / capacity / conflict / coherence");
+        for (const auto& [region, m] : s.regions)
+            ImGui::Text("  %s: %llu / %llu / %llu / %llu", region.c_str(), (unsigned long long)m[0],
+                        (unsigned long long)m[1], (unsigned long long)m[2], (unsigned long long)m[3]);
+
+        // FALLOS DE COHERENCIA - true/false sharing y bloques que mas sufren
+        ImGui::Separator();
+        ImGui::Text("Fallos de coherencia: true sharing %s, false sharing %s",
+                    format_number(s.true_sharing).c_str(), format_number(s.false_sharing).c_str());
+        for (const auto& [b, seg] : s.top_shared) {
+            ImGui::Text("  0x%llx (seg %s): false=%llu true=%llu PEs 0x%x",
+                        (unsigned long long)b.block, seg < 0 ? "-" : ("PE" + std::to_string(seg)).c_str(),
+                        (unsigned long long)b.false_misses, (unsigned long long)b.true_misses, b.pes);
+        }
     }
 
     // RENDERIZADO DE PANEL DE RESULTADOS - muestra producto punto y validación
-    void render_results_panel() {
-        // FORZAR FLUSH DE CACHES - garantiza que memoria tenga datos actualizados
-        for (auto& cache : caches) cache->flush_all();
-        if (bus) bus->flush_all();
-        
-        // CONFIGURACIÓN DE DIRECCIONES DE MEMORIA
-        const size_t baseA_words = 0;
-        const size_t baseB_words = baseA_words + static_cast<size_t>(N);
-        const size_t baseS_words = baseB_words + static_cast<size_t>(N);
-        const size_t result_addr = baseS_words + pes.size();
-        
-        // VERIFICAR SI TODOS LOS PEs TERMINARON CÁLCULO PARCIAL
-        bool all_partial_done = true;
-        for (auto& pe : pes) {
-            if (!pe->is_halted()) {
-                all_partial_done = false;
-                break;
+    void render_watch_panel(const Snapshot& s) {
+        // NUEVO WATCHPOINT - rango en bytes; mesi cubre los bloques que toca
+        ImGui::Combo("Tipo", &watch_kind, kWatchKinds, IM_ARRAYSIZE(kWatchKinds));
+        if (ImGui::InputInt("Dirección (bytes)", &watch_addr, 8, 256)) watch_addr = std::max(watch_addr, 0);
+        if (ImGui::InputInt("Bytes", &watch_bytes, 8, 32)) watch_bytes = std::max(watch_bytes, 1);
+        if (ImGui::Button("Añadir watchpoint")) {
+            WatchOp op;
+            op.kind = WatchKind(watch_kind);
+            op.lo = uint64_t(watch_addr);
+            op.hi = op.lo + uint64_t(watch_bytes);
+            request_watch(op);
+        }
+        // Ayuda: rangos de A, B y S con el layout actual
+        ImGui::Text("A @%zu, B @%zu, S @%zu (paso %zu bytes)", s.L.baseA * 8, s.L.baseB * 8,
+                    s.L.baseS * 8, s.L.strideS * 8);
+
+        ImGui::Separator();
+        if (s.watches.empty()) ImGui::Text("Sin watchpoints");
+        for (const Watchpoint& w : s.watches) {
+            ImGui::PushID(w.id);
+            ImGui::Text("#%d %s [0x%llx, 0x%llx)", w.id, watch_kind_str(w.kind),
+                        (unsigned long long)w.lo, (unsigned long long)w.hi);
+            ImGui::SameLine();
+            if (ImGui::Button("Quitar")) {
+                WatchOp op;
+                op.op = WatchOp::Remove;
+                op.id = w.id;
+                request_watch(op);
             }
+            ImGui::PopID();
         }
-        
-        // DETECCIÓN Y CONFIGURACIÓN DE SUMA FINAL
-        // Solo ejecutar una vez cuando todos los PEs terminen cálculo parcial
-        if (all_partial_done && !final_sum_executed) {
-            // Buscar posición de la etiqueta FINAL_SUM en el programa
-            auto it = labels.find("FINAL_SUM");
-            if (it != labels.end()) {
-                // RECONFIGURAR PE0 PARA EJECUTAR SUMA FINAL
-                pes[0]->set_pc(it->second); // Saltar directamente a FINAL_SUM
-                pes[0]->set_reg_int(0, int(baseS_words * 8));     // R0 = &S[0] (base sumas)
-                pes[0]->set_reg_int(1, int(pes.size()));          // R1 = 4 (número de PEs)
-                pes[0]->set_reg_int(2, int(result_addr * 8));     // R2 = dirección resultado
-                pes[0]->set_reg_double(4, 0.0);                   // R4 = acumulador (reset)
+
+        // DISPAROS - el más nuevo arriba
+        ImGui::Separator();
+        ImGui::Text("Disparos: %zu", s.watch_log.size());
+        if (!s.watch_log.empty()) {
+            ImGui::SameLine();
+            if (ImGui::Button("Limpiar")) {
+                WatchOp op;
+                op.op = WatchOp::ClearLog;
+                request_watch(op);
             }
-            final_sum_executed = true; // Marcar que suma final está en progreso
-        }
-        
-        // LEER RESULTADO ACTUAL DE LA MEMORIA
-        double total = mem->load64(result_addr * 8);
-        
-        // CALCULAR VALOR ESPERADO (secuencial) para validación
-        double expected = 0.0;
-        for (int i = 0; i < N; ++i) {
-            double a = mem->load64((baseA_words + i) * 8);
-            double b = mem->load64((baseB_words + i) * 8);
-            expected += a * b;
-        }
-        
+        }
+        for (auto it = s.watch_log.rbegin(); it != s.watch_log.rend(); ++it) ImGui::TextUnformatted(it->c_str());
+    }
+
+    void render_results_panel(const Snapshot& s) {
+        // LEER RESULTADO: la reduccion en arbol del programa lo deja en S[0].
+        // Los valores de la instantánea ya son los coherentes: sin flush
+        double total = s.S.empty() ? 0.0 : s.S[0];
+
+        // VALOR ESPERADO (secuencial) para validación, calculado al capturar
+        double expected = s.expected;
+
         // MOSTRAR RESULTADOS Y VALIDACIÓN
         ImGui::Text("Producto Punto Calculado: %.2f", total);
         ImGui::Text("Producto Punto Esperado:  %.2f", expected);
-        
-        // VALIDAR PRECISIÓN (tolerancia 1e-10 para doubles)
-        bool correct = std::abs(total - expected) < 1e-10;
+
+        // VALIDAR PRECISIÓN (tolerancia relativa 1e-10: con N grande las sumas
+        // pasan de 2^53 y el orden de la reduccion cambia los ultimos bits)
+        bool correct = std::abs(total - expected) <= 1e-10 * std::max(1.0, std::abs(expected));
         ImGui::Text("Resultado: %s", correct ? "CORRECTO" : "INCORRECTO");
-        
+
         // MOSTRAR SUMAS PARCIALES DE CADA PE
         ImGui::Separator();
-        ImGui::Text("Sumas Parciales:");
-        for (size_t p = 0; p < pes.size(); ++p) {
-            double partial = mem->load64((baseS_words + p) * 8);
-            ImGui::Text("S[%zu] = %.2f", p, partial);
+        ImGui::Text("Sumas Parciales (S[p] = suma del subarbol de p):");
+        for (size_t p = 0; p < s.S.size(); ++p) {
+            ImGui::Text("S[%zu] = %.2f", p, s.S[p]);
+        }
+
+        // DESBALANCE DE CARGA - instrucciones por PE con el reparto elegido
+        ImGui::Separator();
+        ImGui::Text("Reparto %s: max/media = %.2f (PE%d mas cargado, %llu instr.)",
+                    partition_name(s.cfg.part.kind), s.imb.ratio(), s.imb.slowest, (unsigned long long)s.imb.max);
+
+        // LAYOUT - lineas con false sharing y trafico de coherencia de esta corrida
+        ImGui::Text("Layout %s: %zu lineas con false sharing; bus=%llu inval=%llu upgrades=%llu",
+                    layout_name(s.cfg.part.layout), s.false_lines,
+                    (unsigned long long)s.traffic.bus_msgs, (unsigned long long)s.traffic.invalidations,
+                    (unsigned long long)s.traffic.upgrades);
+        if (s.has_l2) {
+            const uint64_t reads = s.l2.reads, hits = s.l2.read_hits;
+            ImGui::Text("L2 %s: lecturas=%llu aciertos=%llu (%.1f%%) expulsiones=%llu back-invalidations=%llu",
+                        kL2Modes[s.cfg.l2_idx], (unsigned long long)reads, (unsigned long long)hits,
+                        reads ? 100.0 * double(hits) / double(reads) : 0.0,
+                        (unsigned long long)uint64_t(s.l2.evictions), (unsigned long long)uint64_t(s.l2.back_invalidations));
+        }
+        if (s.has_numa) {
+            const uint64_t remote = s.numa.remote(), blocks = s.numa.total();
+            ImGui::Text("NUMA %s: bloques remotos=%llu de %llu (%.1f%%) tiempo de memoria=%llu ciclos (en cola %llu)",
+                        kNumaModes[s.cfg.numa_idx], (unsigned long long)remote, (unsigned long long)blocks,
+                        blocks ? 100.0 * double(remote) / double(blocks) : 0.0,
+                        (unsigned long long)s.numa.cycles, (unsigned long long)s.numa.queued);
         }
     }
 };
@@ -579,7 +1304,7 @@ int main(int, char**) {
     // CONTEXTO OPENGL
     SDL_GLContext gl_context = SDL_GL_CreateContext(window);
     SDL_GL_MakeCurrent(window, gl_context);
-    SDL_GL_SetSwapInterval(1); // VSync activado
+    const bool vsync = SDL_GL_SetSwapInterval(1) == 0; // VSync activado (marca el ritmo del loop)
 
     // INICIALIZACIÓN DE ImGui
     IMGUI_CHECKVERSION();
@@ -593,7 +1318,7 @@ int main(int, char**) {
     ImGui_ImplSDL2_InitForOpenGL(window, gl_context);
     ImGui_ImplOpenGL3_Init("#version 130");
 
-    // CREACIÓN DEL SISTEMA MULTIPROCESADOR
+    // CREACIÓN DEL SISTEMA MULTIPROCESADOR (arranca el hilo de simulación)
     GUISystem gui_system;
 
     // LOOP PRINCIPAL DE LA APLICACIÓN
@@ -614,9 +1339,6 @@ int main(int, char**) {
         ImGui_ImplSDL2_NewFrame();
         ImGui::NewFrame();
 
-        // EJECUTAR SIMULACIÓN - avanzar según modo actual (pausa/continuo/paso)
-        gui_system.step_system();
-        
         // RENDERIZAR INTERFAZ GRÁFICA
         gui_system.render_gui();
 
@@ -628,8 +1350,9 @@ int main(int, char**) {
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
         SDL_GL_SwapWindow(window); // Intercambiar buffers
 
-        // PEQUENA PAUSA PARA NO SATURAR LA CPU (~60 FPS)
-        std::this_thread::sleep_for(std::chrono::milliseconds(16));
+        // SIN VSYNC: PEQUENA PAUSA PARA NO SATURAR LA CPU (~60 FPS). La
+        // simulacion corre en su propio hilo y no depende de este ritmo
+        if (!vsync) std::this_thread::sleep_for(std::chrono::milliseconds(16));
     }
 
     // LIMPIEZA FINAL - destruir recursos en orden inverso
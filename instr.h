@@ -1,8 +1,8 @@
 #ifndef INSTR_H
 #define INSTR_H
 
-#include <string>
 #include <cstdint>
+#include <type_traits>
 
 // CODIGOS DE OPERACIÓN - Conjunto de instrucciones soportado
 enum class OpCode {
@@ -13,25 +13,75 @@ enum class OpCode {
     FADD,   // Suma de punto flotante
     INC,    // Incrementar registro (para punteros)
     DEC,    // Decrementar registro (para contadores)
+    ADDI,   // Suma un inmediato con signo a un registro entero
+    ADD,    // Rd = Ra + Rb (entero)
+    ANDI,   // Rd = Ra & imm (entero)
+    SHRI,   // Rd = Ra >> imm (entero, desplazamiento logico)
+    SHLI,   // Rd = Ra << imm (entero)
     JNZ,    // Salto condicional si no es cero
-    HALT    // Terminar ejecución
+    JZ,     // Salto condicional si es cero
+    FZERO,  // Pone en cero un registro de punto flotante
+    HALT,   // Terminar ejecución
+    FENCE,  // Espera a que el store buffer se vacie
+    BARRIER, // FENCE + espera a que lleguen (o terminen) todos los PEs
+
+    // Atomicas (lectura-modificacion-escritura con la linea en exclusiva).
+    // Vacian el store buffer antes, como FENCE
+    FETCH_ADD, // d = M[dir]; M[dir] += b (Rd/Rb enteros o Fd/Fb doubles)
+    CAS,       // Si M[dir] == b: M[dir] = c. Rd = 1 si escribio, 0 si no
+    LL,        // Load-linked: carga y reserva la linea
+    SC,        // Store-conditional: M[dir] = b si la reserva sigue. Rd = 1/0
+
+    // Instrucciones vectoriales (un vector = una linea de cache = 4 doubles)
+    VLOAD,   // Carga 4 doubles consecutivos a registro vectorial
+    VSTORE,  // Almacena registro vectorial en 4 doubles consecutivos
+    VFMUL,   // Multiplicación elemento a elemento
+    VFADD,   // Suma elemento a elemento
+    VFMA,    // Vd += Va * Vb elemento a elemento
+    VREDUCE, // Suma horizontal de un vector a registro escalar
+    VZERO    // Pone en cero un registro vectorial
 };
 
+constexpr int kIntRegs  = 8; // registros enteros de 64 bits R0-R7
+constexpr int kFpRegs   = 16; // registros de punto flotante F0-F15
+constexpr int kVecLanes = 4; // doubles por registro vectorial (32 bytes)
+constexpr int kVecRegs  = 8; // registros vectoriales V0-V7
+
+inline bool is_vector_op(OpCode op) {
+    return op >= OpCode::VLOAD && op <= OpCode::VZERO;
+}
+
+inline bool is_atomic_op(OpCode op) {
+    return op >= OpCode::FETCH_ADD && op <= OpCode::SC;
+}
+
 // ESTRUCTURA DE INSTRUCCIÓN - Representa una instrucción decodificada
 struct Instr {
     OpCode op = OpCode::NOP; // Código de operación
     
-    // Campos de registro (dependen de la instrucción)
+    // Campos de registro (dependen de la instrucción). FMUL/FADD/FZERO usan el
+    // banco F; INC/DEC/JNZ/JZ/ADDI/ADD/ANDI/SHRI/SHLI y las direcciones, el banco R. En las
+    // vectoriales indican registros V, salvo el destino escalar de VREDUCE (F)
     int rd = 0;  // Registro destino
-    int ra = 0;  // Registro operando A  
+    int ra = 0;  // Registro operando A (base en accesos a memoria)
     int rb = 0;  // Registro operando B
+    int rc = 0;  // CAS: valor nuevo
+    int count = 1; // INC: elementos (doubles) a avanzar
+    bool fp = false; // LOAD/STORE/atomicas: el dato es Fn (si no, Rn)
+    int64_t imm = 0; // ADDI/ANDI/SHRI/SHLI: inmediato; memoria: desplazamiento en bytes
     
-    // Campos de dirección/memoria
+    // Campos de dirección/memoria: dir = (ra o address) + imm + R[ri]*scale
     bool addr_is_reg = false; // True si la dirección viene de registro
     size_t address = 0;       // Dirección inmediata (si addr_is_reg es false)
+    int ri = -1;              // Registro indice (-1 si no hay)
+    int scale = 1;            // Escala del indice: 1, 2, 4 u 8
     
-    // Campo para saltos
-    std::string label;        // Etiqueta destino para saltos
+    // Campo para saltos: la etiqueta se resuelve al ensamblar
+    int target = -1;          // Indice de la instruccion destino (-1 si no existe)
 };
 
+// Sin punteros ni strings: un programa se copia (y se guarda en la imagen
+// binaria) como bloque de memoria
+static_assert(std::is_trivially_copyable<Instr>::value, "Instr debe ser POD");
+
 #endif
\ No newline at end of file
@@ -0,0 +1,218 @@
+// l2_cache.cpp
+#include "l2_cache.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+bool parse_l2(const std::string& s, L2Config& cfg) {
+    std::istringstream ss(s);
+    std::string policy;
+    std::getline(ss, policy, ':');
+    if (policy == "inclusive") cfg.inclusive = true;
+    else if (policy == "noninclusive") cfg.inclusive = false;
+    else return false;
+    uint32_t* fields[] = {&cfg.lines, &cfg.ways, &cfg.banks};
+    for (uint32_t* f : fields) {
+        std::string v;
+        if (!std::getline(ss, v, ':')) break;
+        try {
+            size_t p = 0;
+            const unsigned long x = std::stoul(v, &p);
+            if (p != v.size() || x == 0 || x > (1u << 20)) return false;
+            *f = uint32_t(x);
+        } catch (...) { return false; }
+    }
+    // Al menos un set por banco y sin lineas sobrantes
+    return ss.eof() && cfg.lines % (cfg.ways * cfg.banks) == 0 && cfg.sets_per_bank() > 0;
+}
+
+std::string l2_name(const L2Config& cfg) {
+    std::ostringstream os;
+    os << (cfg.inclusive ? "inclusive" : "noninclusive") << ":" << cfg.lines
+       << ":" << cfg.ways << ":" << cfg.banks;
+    return os.str();
+}
+
+L2Cache::L2Cache(IMemory* next, Interconnect* ic, const L2Config& cfg)
+    : next_(next), ic_(ic), cfg_(cfg), banks_(new Bank[cfg.banks]) {
+    if (!next_) throw std::runtime_error("L2Cache: next == nullptr");
+    for (uint32_t b = 0; b < cfg_.banks; ++b) banks_[b].lines.resize(size_t(cfg_.sets_per_bank()) * cfg_.ways);
+    if (ic_) ic_->set_l2(this);
+}
+
+int L2Cache::find(Bank& b, uint32_t set, uint64_t block_addr) const {
+    for (uint32_t w = 0; w < cfg_.ways; ++w) {
+        const L2Line& l = b.lines[set * cfg_.ways + w];
+        if (l.valid && l.block == block_addr) return int(w);
+    }
+    return -1;
+}
+
+void L2Cache::modify(uint32_t bank, uint32_t set, uint32_t way) {
+    if (!journal_) return;
+    const uint32_t idx = (bank * cfg_.sets_per_bank() + set) * cfg_.ways + way;
+    journal_->push_back(L2Undo{idx, banks_[bank].lines[set * cfg_.ways + way]});
+}
+
+uint64_t L2Cache::install(uint32_t bank, uint32_t set, uint64_t block_addr, const uint8_t* data) {
+    Bank& b = banks_[bank];
+    uint32_t victim = 0;
+    for (uint32_t w = 0; w < cfg_.ways; ++w) {
+        const L2Line& l = b.lines[set * cfg_.ways + w];
+        if (!l.valid) { victim = w; break; }
+        if (l.used < b.lines[set * cfg_.ways + victim].used) victim = w;
+    }
+    modify(bank, set, victim);
+    L2Line& l = b.lines[set * cfg_.ways + victim];
+    const uint64_t out = l.valid ? l.block : UINT64_MAX;
+    if (l.valid) { b.stats.evictions++; stats_.evictions++; }
+    l.valid = true;
+    l.block = block_addr;
+    l.used = ++b.clock;
+    std::memcpy(l.data.data(), data, hw::kBlockBytes);
+    b.stats.fills++;
+    stats_.fills++;
+    return out;
+}
+
+void L2Cache::readBlockAligned(uint64_t block_addr, std::array<uint8_t, hw::kBlockBytes>& out) {
+    const uint32_t bank = bank_of(block_addr), set = set_of(block_addr);
+    Bank& b = banks_[bank];
+    uint64_t victim = UINT64_MAX;
+    {
+        std::lock_guard<std::mutex> lk(b.m);
+        b.stats.reads++;
+        stats_.reads++;
+        const int w = find(b, set, block_addr);
+        if (w >= 0) {
+            b.stats.read_hits++;
+            stats_.read_hits++;
+            modify(bank, set, uint32_t(w));
+            L2Line& l = b.lines[set * cfg_.ways + uint32_t(w)];
+            l.used = ++b.clock;
+            out = l.data;
+            return;
+        }
+        next_->readBlockAligned(block_addr, out);
+        victim = install(bank, set, block_addr, out.data());
+    }
+    if (victim != UINT64_MAX && cfg_.inclusive) evicted(victim);
+}
+
+std::future<std::vector<uint8_t>> L2Cache::readBlockAsync(uint64_t block_addr) {
+    std::array<uint8_t, hw::kBlockBytes> tmp;
+    readBlockAligned(block_addr, tmp);
+    std::promise<std::vector<uint8_t>> p;
+    p.set_value(std::vector<uint8_t>(tmp.begin(), tmp.end()));
+    return p.get_future();
+}
+
+void L2Cache::writeBlockAligned(uint64_t block_addr, const std::array<uint8_t, hw::kBlockBytes>& data) {
+    const uint32_t bank = bank_of(block_addr), set = set_of(block_addr);
+    Bank& b = banks_[bank];
+    std::lock_guard<std::mutex> lk(b.m);
+    b.stats.writes++;
+    stats_.writes++;
+    const int w = find(b, set, block_addr);
+    if (w >= 0) {
+        b.stats.write_hits++;
+        stats_.write_hits++;
+        modify(bank, set, uint32_t(w));
+        L2Line& l = b.lines[set * cfg_.ways + uint32_t(w)];
+        l.data = data;
+        l.used = ++b.clock;
+    }
+    // No inclusiva: el write-back de una L1 deja el bloque en la L2 (la
+    // expulsion es silenciosa). Inclusiva: un bloque ausente ya no esta en
+    // ninguna L1 salvo que sea el write-back de una back-invalidation
+    else if (!cfg_.inclusive) install(bank, set, block_addr, data.data());
+    next_->writeBlockAligned(block_addr, data);
+}
+
+double L2Cache::load64(uint64_t addr) {
+    std::array<uint8_t, hw::kBlockBytes> blk;
+    readBlockAligned(Address::block_base(addr), blk);
+    double d;
+    std::memcpy(&d, blk.data() + Address::split(addr).offset, sizeof(d));
+    return d;
+}
+
+void L2Cache::store64(uint64_t addr, double val) {
+    const uint64_t block_addr = Address::block_base(addr);
+    const uint32_t bank = bank_of(block_addr), set = set_of(block_addr);
+    Bank& b = banks_[bank];
+    std::lock_guard<std::mutex> lk(b.m);
+    const int w = find(b, set, block_addr);
+    if (w >= 0) {
+        modify(bank, set, uint32_t(w));
+        std::memcpy(b.lines[set * cfg_.ways + uint32_t(w)].data.data() + Address::split(addr).offset, &val, sizeof(val));
+    }
+    next_->store64(addr, val);
+}
+
+void L2Cache::evicted(uint64_t block_addr) {
+    if (!ic_) return;
+    std::lock_guard<std::mutex> lk(victims_m_);
+    victims_.push_back(block_addr);
+}
+
+void L2Cache::settle() {
+    std::vector<uint64_t> blocks;
+    {
+        std::lock_guard<std::mutex> lk(victims_m_);
+        if (victims_.empty()) return;
+        blocks.swap(victims_);
+    }
+    for (uint64_t blk : blocks) {
+        uint32_t writebacks = 0;
+        const uint32_t copies = ic_->back_invalidate(blk, writebacks);
+        Bank& b = banks_[bank_of(blk)];
+        b.stats.back_invalidations += copies;
+        b.stats.back_writebacks += writebacks;
+        stats_.back_invalidations += copies;
+        stats_.back_writebacks += writebacks;
+    }
+}
+
+uint32_t L2Cache::valid_lines() const {
+    uint32_t n = 0;
+    for (uint32_t b = 0; b < cfg_.banks; ++b)
+        for (const L2Line& l : banks_[b].lines) n += l.valid;
+    return n;
+}
+
+void L2Cache::report(std::ostream& os) const {
+    auto pct = [](uint64_t a, uint64_t b) {
+        std::ostringstream s;
+        s << std::fixed << std::setprecision(1) << (b ? 100.0 * double(a) / double(b) : 0.0) << "%";
+        return s.str();
+    };
+    os << "L2 " << l2_name(cfg_) << " (" << cfg_.sets_per_bank() << " sets por banco, "
+       << valid_lines() << "/" << cfg_.lines << " lineas validas)\n"
+       << "  lecturas=" << stats_.reads << " aciertos=" << stats_.read_hits
+       << " (" << pct(stats_.read_hits, stats_.reads) << ", lecturas a memoria evitadas)"
+       << " escrituras=" << stats_.writes << " (presentes " << stats_.write_hits << ")\n"
+       << "  llenados=" << stats_.fills << " expulsiones=" << stats_.evictions
+       << " back-invalidations=" << stats_.back_invalidations
+       << " (con write-back " << stats_.back_writebacks << ")\n";
+    for (uint32_t b = 0; b < cfg_.banks; ++b) {
+        const L2Stats& s = banks_[b].stats;
+        os << "  banco " << b << ": lecturas=" << s.reads << " aciertos=" << s.read_hits
+           << " (" << pct(s.read_hits, s.reads) << ") escrituras=" << s.writes
+           << " expulsiones=" << s.evictions << "\n";
+    }
+}
+
+void L2Cache::save(State& s) const {
+    s.clear();
+    for (uint32_t b = 0; b < cfg_.banks; ++b) s.insert(s.end(), banks_[b].lines.begin(), banks_[b].lines.end());
+}
+
+void L2Cache::restore(const State& s) {
+    const size_t per_bank = size_t(cfg_.sets_per_bank()) * cfg_.ways;
+    for (uint32_t b = 0; b < cfg_.banks; ++b)
+        std::copy(s.begin() + b * per_bank, s.begin() + (b + 1) * per_bank, banks_[b].lines.begin());
+}
@@ -0,0 +1,126 @@
+// l2_cache.hpp
+#pragma once
+#include <array>
+#include <cstdint>
+#include <future>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "cache.hpp"
+
+// L2 COMPARTIDA - entre las L1 y la memoria, como IMemory: las L1 la usan en
+// lugar del SharedMemoryAdapter. Asociativa por conjuntos con LRU, repartida
+// en bancos por bloque (bloque % bancos), un candado por banco.
+//   Lecturas   acierto: el bloque sale de la L2 sin ir a memoria
+//              fallo: se lee de la memoria y se instala
+//   Escrituras write-through (la memoria siempre esta al dia: peek_word, el
+//              resultado final y el historial de deshacer la leen directo).
+//              Si el bloque esta se actualiza; si no, solo se instala en
+//              modo no inclusivo
+// Inclusiva: expulsar un bloque invalida las copias de las L1
+// (back-invalidation, con write-back si estaban en M). La L1 pide el bloque
+// con el candado de su set tomado, asi que las invalidaciones se difieren al
+// Interconnect y corren al soltar el bus (Interconnect::BusLock)
+struct L2Config {
+    bool inclusive = true;
+    uint32_t lines = 128;  // Total (8 veces las 16 lineas de una L1)
+    uint32_t ways = 4;
+    uint32_t banks = 2;
+    uint32_t sets_per_bank() const { return lines / (ways * banks); }
+};
+// inclusive|noninclusive[:lineas[:vias[:bancos]]]
+bool parse_l2(const std::string& s, L2Config& cfg);
+std::string l2_name(const L2Config& cfg);
+
+struct L2Stats {
+    Counter reads;              // Bloques pedidos por las L1
+    Counter read_hits;          // Servidos sin ir a memoria
+    Counter writes;             // Write-backs de las L1 (siempre siguen a memoria)
+    Counter write_hits;         // Bloque presente: se actualizo la copia
+    Counter fills;              // Bloques instalados (fallos de lectura y, no inclusiva, de escritura)
+    Counter evictions;          // Bloques validos reemplazados
+    Counter back_invalidations; // Copias de L1 invalidadas por inclusion
+    Counter back_writebacks;    // De esas, las que estaban en M
+};
+
+// Cambio a una linea, para deshacerlo (undo.hpp)
+struct L2Line {
+    bool valid = false;
+    uint64_t block = 0;  // Direccion base
+    uint64_t used = 0;   // Reloj LRU del banco en el ultimo uso
+    std::array<uint8_t, hw::kBlockBytes> data{};
+};
+struct L2Undo {
+    uint32_t idx;  // Linea global (banco, set, via)
+    L2Line old;
+};
+
+class L2Cache : public IMemory {
+public:
+    // next: memoria de abajo. ic: bus de las L1 (back-invalidation; nullptr sin L1s)
+    L2Cache(IMemory* next, Interconnect* ic, const L2Config& cfg);
+
+    void writeBlockAligned(uint64_t block_addr, const std::array<uint8_t, hw::kBlockBytes>& data) override;
+    void readBlockAligned(uint64_t block_addr, std::array<uint8_t, hw::kBlockBytes>& out) override;
+    double load64(uint64_t addr) override;
+    void store64(uint64_t addr, double val) override;
+    uint64_t size_bytes() const override { return next_->size_bytes(); }
+    // Sincrona: un acierto se resuelve en el acto y un fallo espera la memoria
+    // (con el bus tomado, asi que el orden contra los write-backs se mantiene).
+    // El futuro vuelve listo: con L2 los llenados de las MSHR no se solapan
+    // con la memoria en el host (fill_waits y load_use_stalls en 0); la latencia
+    // simulada de las MSHR (kFillLatency accesos) no cambia
+    std::future<std::vector<uint8_t>> readBlockAsync(uint64_t block_addr) override;
+
+    // Back-invalidations pendientes: las corre el Interconnect al soltar el bus
+    void settle();
+
+    const L2Config& config() const { return cfg_; }
+    const L2Stats& stats() const { return stats_; }
+    const L2Stats& bank_stats(uint32_t b) const { return banks_[b].stats; }
+    // Bloques validos (inspeccion, con los PEs detenidos)
+    uint32_t valid_lines() const;
+    void report(std::ostream& os) const;
+
+    // HISTORIAL DE DESHACER (undo.hpp), con los PEs detenidos. Retroceden las
+    // lineas (datos, tags y LRU), no los contadores
+    void set_journal(std::vector<L2Undo>* j) { journal_ = j; }
+    void undo(const L2Undo& u) { line(u.idx) = u.old; }
+    using State = std::vector<L2Line>;
+    void save(State& s) const;
+    void restore(const State& s);
+
+private:
+    struct Bank {
+        std::mutex m;
+        std::vector<L2Line> lines;  // sets_per_bank * ways, por set
+        uint64_t clock = 0;         // Reloj LRU
+        L2Stats stats;
+    };
+    uint32_t bank_of(uint64_t block_addr) const { return uint32_t(block_addr / hw::kBlockBytes % cfg_.banks); }
+    uint32_t set_of(uint64_t block_addr) const {
+        return uint32_t(block_addr / hw::kBlockBytes / cfg_.banks % cfg_.sets_per_bank());
+    }
+    L2Line& line(uint32_t idx) {
+        const uint32_t per_bank = cfg_.sets_per_bank() * cfg_.ways;
+        return banks_[idx / per_bank].lines[idx % per_bank];
+    }
+    // Via con el bloque (o -1) dentro del set; con el candado del banco
+    int find(Bank& b, uint32_t set, uint64_t block_addr) const;
+    // Instala el bloque (LRU o via libre); devuelve el bloque expulsado o UINT64_MAX
+    uint64_t install(uint32_t bank, uint32_t set, uint64_t block_addr, const uint8_t* data);
+    void modify(uint32_t bank, uint32_t set, uint32_t way);  // Anota en el diario antes de cambiar
+    void evicted(uint64_t block_addr);  // Back-invalidation diferida (inclusiva)
+
+    IMemory* next_;
+    Interconnect* ic_;
+    L2Config cfg_;
+    std::unique_ptr<Bank[]> banks_;
+    L2Stats stats_;  // Totales
+    std::vector<L2Undo>* journal_ = nullptr;  // Solo mientras graba el historial
+    std::mutex victims_m_;
+    std::vector<uint64_t> victims_;  // Expulsados que aun pueden estar en alguna L1
+};
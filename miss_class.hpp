@@ -0,0 +1,142 @@
+// miss_class.hpp
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// CLASIFICACION DE FALLOS (3C + coherencia), en este orden:
+//   compulsory  primer acceso de esta cache al bloque
+//   coherence   el bloque estaba y lo invalido un BusRdX/BusUpgr remoto
+//               (tambien los upgrades S->M: el dato estaba, falta la propiedad)
+//   capacity    tambien falla una cache sombra totalmente asociativa LRU de
+//               la misma capacidad
+//   conflict    la cache sombra acierta: lo expulso la asociatividad
+// La sombra ve solo los accesos de demanda (no los prefetches)
+enum class MissKind : uint8_t { Compulsory, Capacity, Conflict, Coherence };
+constexpr size_t kMissKinds = 4;
+inline const char* miss_kind_str(MissKind k) {
+    switch (k) {
+        case MissKind::Compulsory: return "compulsory";
+        case MissKind::Capacity:   return "capacity";
+        case MissKind::Conflict:   return "conflict";
+        case MissKind::Coherence:  return "coherence";
+    }
+    return "?";
+}
+
+using MissCounts = std::array<uint64_t, kMissKinds>;
+
+// Cambio a los conjuntos del clasificador, para deshacerlo (undo.hpp)
+struct MissUndo {
+    enum Op : uint8_t { Touched, Counted, Invalidated, Revalidated } op;
+    MissKind kind;  // Counted
+    uint64_t block;
+};
+
+template <size_t Lines>
+class MissClassifier {
+public:
+    // Acceso de demanda al bloque: actualiza la sombra LRU. Devuelve si la
+    // sombra acertaba (se llama antes de clasificar el fallo)
+    bool access(uint64_t block) {
+        size_t i = 0;
+        while (i < used_ && lru_[i] != block) ++i;
+        const bool hit = i < used_;
+        if (!hit) i = used_ < Lines ? used_++ : Lines - 1;  // Sin lugar: sale el LRU
+        for (; i > 0; --i) lru_[i] = lru_[i - 1];
+        lru_[0] = block;
+        return hit;
+    }
+
+    // Tipo de un fallo de demanda (no lo cuenta: ver count)
+    MissKind classify(uint64_t block, bool shadow_hit) {
+        MissKind k;
+        if (touched_.insert(block).second) {
+            k = MissKind::Compulsory;
+            if (journal_) journal_->push_back(MissUndo{MissUndo::Touched, k, block});
+        }
+        else if (take_invalidated(block)) k = MissKind::Coherence;
+        else k = shadow_hit ? MissKind::Conflict : MissKind::Capacity;
+        return k;
+    }
+
+    void count(uint64_t block, MissKind k) {
+        per_block_[block][size_t(k)]++;
+        if (journal_) journal_->push_back(MissUndo{MissUndo::Counted, k, block});
+    }
+
+    // Snoop remoto (otro hilo): la copia se perdio por coherencia
+    void invalidated(uint64_t block) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (invalidated_.insert(block).second && journal_)
+            journal_->push_back(MissUndo{MissUndo::Invalidated, MissKind::Coherence, block});
+    }
+    // El bloque volvio sin fallo de demanda (prefetch)
+    void refilled(uint64_t block) { take_invalidated(block); }
+
+    // Fallos por bloque: solo desde el hilo del PE o con el PE detenido
+    const std::unordered_map<uint64_t, MissCounts>& per_block() const { return per_block_; }
+
+    // HISTORIAL DE DESHACER (undo.hpp), con los PEs detenidos. La sombra LRU
+    // es chica y se compara entera; los conjuntos se deshacen con el diario
+    struct Lru {  // Trivialmente copiable
+        std::array<uint64_t, Lines> blocks;
+        uint64_t used;
+    };
+    void save_lru(Lru& l) const { l.blocks = lru_; l.used = used_; }
+    void restore_lru(const Lru& l) { lru_ = l.blocks; used_ = size_t(l.used); }
+    void set_journal(std::vector<MissUndo>* j) { journal_ = j; }
+    void undo(const MissUndo& u) {
+        switch (u.op) {
+            case MissUndo::Touched: touched_.erase(u.block); break;
+            case MissUndo::Counted: {
+                auto it = per_block_.find(u.block);
+                if (it == per_block_.end()) break;
+                MissCounts& c = it->second;
+                c[size_t(u.kind)]--;
+                if (c == MissCounts{}) per_block_.erase(it);
+                break;
+            }
+            case MissUndo::Invalidated: invalidated_.erase(u.block); break;
+            case MissUndo::Revalidated: invalidated_.insert(u.block); break;
+        }
+    }
+    // Copia completa (checkpoints)
+    struct State {
+        Lru lru;
+        std::unordered_set<uint64_t> touched, invalidated;
+        std::unordered_map<uint64_t, MissCounts> per_block;
+    };
+    void save(State& s) const {
+        save_lru(s.lru);
+        s.touched = touched_;
+        s.invalidated = invalidated_;
+        s.per_block = per_block_;
+    }
+    void restore(const State& s) {
+        restore_lru(s.lru);
+        touched_ = s.touched;
+        invalidated_ = s.invalidated;
+        per_block_ = s.per_block;
+    }
+
+private:
+    bool take_invalidated(uint64_t block) {
+        std::lock_guard<std::mutex> lk(m_);
+        if (invalidated_.erase(block) == 0) return false;
+        if (journal_) journal_->push_back(MissUndo{MissUndo::Revalidated, MissKind::Coherence, block});
+        return true;
+    }
+
+    std::array<uint64_t, Lines> lru_{};  // Sombra: [0] = mas reciente
+    size_t used_ = 0;
+    std::unordered_set<uint64_t> touched_;
+    std::unordered_map<uint64_t, MissCounts> per_block_;
+    std::mutex m_;  // Protege invalidated_ (lo escriben los snoops)
+    std::unordered_set<uint64_t> invalidated_;
+    std::vector<MissUndo>* journal_ = nullptr;  // Solo mientras graba el historial
+};
@@ -0,0 +1,166 @@
+// numa.cpp
+#include "numa.hpp"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+bool parse_numa(const std::string& s, NumaConfig& cfg) {
+    std::istringstream ss(s);
+    std::string placement;
+    std::getline(ss, placement, ':');
+    if (placement == "local") cfg.placement = NumaPlacement::Local;
+    else if (placement == "interleave") cfg.placement = NumaPlacement::Interleave;
+    else if (placement == "node0") cfg.placement = NumaPlacement::Node0;
+    else return false;
+    uint32_t* fields[] = {&cfg.nodes, &cfg.local, &cfg.remote, &cfg.local_occ, &cfg.remote_occ};
+    for (uint32_t* f : fields) {
+        std::string v;
+        if (!std::getline(ss, v, ':')) break;
+        try {
+            size_t p = 0;
+            const unsigned long x = std::stoul(v, &p);
+            if (p != v.size() || x > (1u << 20)) return false;
+            *f = uint32_t(x);
+        } catch (...) { return false; }
+    }
+    // El hogar de cada bloque se guarda en un byte
+    return ss.eof() && cfg.nodes >= 1 && cfg.nodes <= 255;
+}
+
+const char* placement_name(NumaPlacement p) {
+    switch (p) {
+        case NumaPlacement::Local:      return "local";
+        case NumaPlacement::Interleave: return "interleave";
+        case NumaPlacement::Node0:      return "node0";
+    }
+    return "?";
+}
+
+std::string numa_name(const NumaConfig& cfg) {
+    std::ostringstream os;
+    os << placement_name(cfg.placement) << ":" << cfg.nodes << ":" << cfg.local << ":" << cfg.remote
+       << ":" << cfg.local_occ << ":" << cfg.remote_occ;
+    return os.str();
+}
+
+// PUERTO DE UN PE - la IMemory de su L1: cuenta el bloque y sigue abajo
+class NumaMemory::Port : public IMemory {
+public:
+    Port(NumaMemory* numa, int pe) : numa_(numa), pe_(pe) {}
+    void writeBlockAligned(uint64_t block_addr, const std::array<uint8_t, hw::kBlockBytes>& data) override {
+        numa_->access(pe_, block_addr, true);
+        numa_->next_->writeBlockAligned(block_addr, data);
+    }
+    void readBlockAligned(uint64_t block_addr, std::array<uint8_t, hw::kBlockBytes>& out) override {
+        numa_->access(pe_, block_addr, false);
+        numa_->next_->readBlockAligned(block_addr, out);
+    }
+    // Palabras sueltas: no las usan las L1 (solo la inicializacion, que va directo)
+    double load64(uint64_t addr) override { return numa_->next_->load64(addr); }
+    void store64(uint64_t addr, double val) override { numa_->next_->store64(addr, val); }
+    uint64_t size_bytes() const override { return numa_->next_->size_bytes(); }
+    std::future<std::vector<uint8_t>> readBlockAsync(uint64_t block_addr) override {
+        numa_->access(pe_, block_addr, false);
+        return numa_->next_->readBlockAsync(block_addr);
+    }
+
+private:
+    NumaMemory* numa_;
+    int pe_;
+};
+
+NumaMemory::NumaMemory(IMemory* next, const NumaConfig& cfg, std::vector<uint8_t> homes, unsigned num_pes)
+    : next_(next), cfg_(cfg), homes_(std::move(homes)), num_pes_(num_pes),
+      st_(size_t(cfg.nodes) * kNodeWords + size_t(num_pes) * kPeWords, 0) {
+    if (!next_) throw std::runtime_error("NumaMemory: next == nullptr");
+    ports_.reserve(num_pes);
+    for (unsigned p = 0; p < num_pes; ++p) ports_.push_back(std::make_unique<Port>(this, int(p)));
+}
+
+NumaMemory::~NumaMemory() = default;
+
+IMemory* NumaMemory::port(int pe) { return ports_[size_t(pe)].get(); }
+
+void NumaMemory::access(int pe, uint64_t block_addr, bool write) {
+    const uint32_t h = home(block_addr);
+    const bool local = h == node_of(pe);
+    std::lock_guard<std::mutex> lk(m_);
+    auto bump = [&](uint32_t idx) { set(idx, st_[idx] + 1); };
+    bump(pe_word(pe, write ? (local ? kLocalWrites : kRemoteWrites) : (local ? kLocalReads : kRemoteReads)));
+    bump(node_word(h, kBlocks));
+
+    // Emision: un write-back sale con el reloj del PE; una lectura ademas
+    // espera que llegue la que ocupaba su ranura (kMshrs en vuelo)
+    const uint32_t slot = pe_word(pe, kInFlight + uint32_t(st_[pe_word(pe, kSlot)] % hw::kMshrs));
+    uint64_t t = st_[pe_word(pe, kClock)];
+    if (!write) t = std::max(t, st_[slot]);
+    uint64_t start = std::max(t, st_[node_word(h, kMemFree)]);
+    if (!local) start = std::max(start, st_[node_word(h, kLinkFree)]);
+    set(node_word(h, kMemFree), start + cfg_.local_occ);
+    if (!local) set(node_word(h, kLinkFree), start + cfg_.remote_occ);
+    if (write) return;
+
+    const uint64_t arrival = start + (local ? cfg_.local : cfg_.remote);
+    set(slot, arrival);
+    set(pe_word(pe, kSlot), st_[pe_word(pe, kSlot)] + 1);
+    set(pe_word(pe, kClock), t);
+    set(pe_word(pe, kQueued), st_[pe_word(pe, kQueued)] + (start - t));
+    if (arrival > st_[pe_word(pe, kDone)]) set(pe_word(pe, kDone), arrival);
+}
+
+NumaStats NumaMemory::stats(int pe) const {
+    std::lock_guard<std::mutex> lk(m_);
+    NumaStats s;
+    s.local_reads = st_[pe_word(pe, kLocalReads)];
+    s.remote_reads = st_[pe_word(pe, kRemoteReads)];
+    s.local_writes = st_[pe_word(pe, kLocalWrites)];
+    s.remote_writes = st_[pe_word(pe, kRemoteWrites)];
+    s.cycles = st_[pe_word(pe, kDone)];
+    s.queued = st_[pe_word(pe, kQueued)];
+    return s;
+}
+
+NumaStats NumaMemory::total() const {
+    NumaStats t;
+    for (unsigned p = 0; p < num_pes_; ++p) {
+        const NumaStats s = stats(int(p));
+        t.local_reads += s.local_reads;
+        t.remote_reads += s.remote_reads;
+        t.local_writes += s.local_writes;
+        t.remote_writes += s.remote_writes;
+        t.cycles = std::max(t.cycles, s.cycles);
+        t.queued += s.queued;
+    }
+    return t;
+}
+
+uint64_t NumaMemory::node_blocks(uint32_t node) const {
+    std::lock_guard<std::mutex> lk(m_);
+    return st_[node_word(node, kBlocks)];
+}
+
+uint64_t NumaMemory::makespan() const { return total().cycles; }
+
+void NumaMemory::report(std::ostream& os) const {
+    auto pct = [](uint64_t a, uint64_t b) {
+        std::ostringstream s;
+        s << std::fixed << std::setprecision(1) << (b ? 100.0 * double(a) / double(b) : 0.0) << "%";
+        return s.str();
+    };
+    const NumaStats t = total();
+    os << "NUMA " << numa_name(cfg_) << ": " << t.total() << " bloques, remotos " << t.remote()
+       << " (" << pct(t.remote(), t.total()) << "), tiempo de memoria " << t.cycles << " ciclos\n";
+    for (unsigned p = 0; p < num_pes_; ++p) {
+        const NumaStats s = stats(int(p));
+        os << "  PE" << p << " (nodo " << node_of(int(p)) << "): lecturas local=" << s.local_reads
+           << " remota=" << s.remote_reads << " write-backs local=" << s.local_writes
+           << " remoto=" << s.remote_writes << " (" << pct(s.remote(), s.total()) << " remotos)"
+           << " tiempo=" << s.cycles << " en cola=" << s.queued << "\n";
+    }
+    for (uint32_t n = 0; n < cfg_.nodes; ++n) {
+        const uint64_t owned = uint64_t(std::count(homes_.begin(), homes_.end(), uint8_t(n)));
+        os << "  nodo " << n << ": " << owned << " bloques hogar, atendio " << node_blocks(n) << "\n";
+    }
+}
@@ -0,0 +1,119 @@
+// numa.hpp
+#pragma once
+#include <cstdint>
+#include <future>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "cache.hpp"
+
+// MEMORIA NUMA - la memoria se reparte entre nodos y cada bloque tiene un nodo
+// hogar fijo (ubicacion decidida por el layout: numa_homes en partition.h).
+// Los PEs se agrupan en nodos contiguos (node_of_pe). Cada L1 llega a memoria
+// por su propio puerto (port(pe)), que clasifica el bloque en local o remoto
+// y lo pasa tal cual a la memoria de abajo: el dato y el orden no cambian.
+// Modelo de tiempo (ciclos, determinista con el stepper RR): el tiempo de
+// memoria de un kernel limitado por memoria. Cada PE emite sus lecturas de
+// bloque en orden con hasta kMshrs en vuelo (como su L1); una lectura emitida
+// en t espera a la memoria del nodo hogar y, si es remota, a su enlace:
+//   inicio = max(t, libre_memoria[hogar] [, libre_enlace[hogar]])
+//   llega  = inicio + local|remote
+// y los ocupa local_occ / remote_occ ciclos (la inversa del ancho de banda).
+// Los write-backs ocupan igual pero no detienen al PE
+enum class NumaPlacement : uint8_t {
+    Local,       // Tramo de A/B y ranura de S de cada PE en su nodo; el resto intercalado
+    Interleave,  // Bloque b en el nodo b % nodos
+    Node0        // Todo en el nodo 0 (primer toque del hilo que inicializa)
+};
+
+struct NumaConfig {
+    NumaPlacement placement = NumaPlacement::Local;
+    uint32_t nodes = 2;
+    uint32_t local = 100, remote = 250;      // Latencia de un bloque (ciclos)
+    uint32_t local_occ = 8, remote_occ = 16; // Ocupacion por bloque: memoria del nodo y su enlace
+};
+// local|interleave|node0[:nodos[:local:remota[:ocup_memoria:ocup_enlace]]]
+bool parse_numa(const std::string& s, NumaConfig& cfg);
+std::string numa_name(const NumaConfig& cfg);
+const char* placement_name(NumaPlacement p);
+// Nodo del PE: grupos contiguos (con 4 PEs y 2 nodos: 0,0,1,1)
+inline uint32_t node_of_pe(int pe, unsigned num_pes, uint32_t nodes) {
+    return num_pes ? uint32_t(uint64_t(pe) * nodes / num_pes) : 0;
+}
+
+struct NumaStats {
+    uint64_t local_reads = 0, remote_reads = 0;    // Bloques leidos (llenados de la L1)
+    uint64_t local_writes = 0, remote_writes = 0;  // Write-backs
+    uint64_t cycles = 0;  // Llegada de su ultima lectura: tiempo de memoria del PE
+    uint64_t queued = 0;  // Ciclos que sus lecturas esperaron memoria o enlace ocupados
+    uint64_t remote() const { return remote_reads + remote_writes; }
+    uint64_t total() const { return local_reads + remote_reads + local_writes + remote_writes; }
+};
+
+// Cambio a una palabra del estado del modelo, para deshacerlo (undo.hpp)
+struct NumaUndo {
+    uint32_t idx;
+    uint64_t old;
+};
+
+class NumaMemory {
+public:
+    // next: memoria de abajo. homes: nodo hogar de cada bloque de next
+    NumaMemory(IMemory* next, const NumaConfig& cfg, std::vector<uint8_t> homes, unsigned num_pes);
+    ~NumaMemory();
+    NumaMemory(const NumaMemory&) = delete;
+    NumaMemory& operator=(const NumaMemory&) = delete;
+
+    IMemory* port(int pe);  // Memoria de la L1 del PE
+
+    const NumaConfig& config() const { return cfg_; }
+    uint32_t node_of(int pe) const { return node_of_pe(pe, num_pes_, cfg_.nodes); }
+    uint32_t home(uint64_t block_addr) const {  // O(1): tabla por bloque
+        const uint64_t b = block_addr / hw::kBlockBytes;
+        return b < homes_.size() ? homes_[b] : 0;
+    }
+    // Con los PEs detenidos
+    NumaStats stats(int pe) const;
+    NumaStats total() const;
+    uint64_t node_blocks(uint32_t node) const;  // Bloques que atendio el nodo (locales y remotos)
+    uint64_t makespan() const;                  // Mayor tiempo de memoria de los PEs
+    void report(std::ostream& os) const;
+
+    // HISTORIAL DE DESHACER (undo.hpp), con los PEs detenidos: relojes,
+    // ocupaciones y contadores viven en un solo vector de palabras
+    void set_journal(std::vector<NumaUndo>* j) { journal_ = j; }
+    void undo(const NumaUndo& u) { st_[u.idx] = u.old; }
+    using State = std::vector<uint64_t>;
+    void save(State& s) const { s = st_; }
+    void restore(const State& s) { st_ = s; }
+
+private:
+    class Port;
+    // Un bloque de pe pasa por su puerto: contadores y modelo de tiempo
+    void access(int pe, uint64_t block_addr, bool write);
+
+    // Palabras de st_. Por nodo: libre_memoria, libre_enlace, bloques. Por PE:
+    // contadores de NumaStats, reloj de emision, proxima ranura y la llegada
+    // de las ultimas kMshrs lecturas (ranura libre cuando llego la suya)
+    enum : uint32_t { kMemFree, kLinkFree, kBlocks, kNodeWords };
+    enum : uint32_t { kLocalReads, kRemoteReads, kLocalWrites, kRemoteWrites, kDone, kQueued,
+                      kClock, kSlot, kInFlight, kPeWords = kInFlight + uint32_t(hw::kMshrs) };
+    uint32_t node_word(uint32_t node, uint32_t w) const { return node * kNodeWords + w; }
+    uint32_t pe_word(int pe, uint32_t w) const { return cfg_.nodes * kNodeWords + uint32_t(pe) * kPeWords + w; }
+    void set(uint32_t idx, uint64_t v) {
+        if (journal_) journal_->push_back(NumaUndo{idx, st_[idx]});
+        st_[idx] = v;
+    }
+
+    IMemory* next_;
+    NumaConfig cfg_;
+    std::vector<uint8_t> homes_;
+    unsigned num_pes_;
+    std::vector<std::unique_ptr<Port>> ports_;
+    mutable std::mutex m_;  // st_: los write-backs de snoops llegan desde otros hilos
+    std::vector<uint64_t> st_;
+    std::vector<NumaUndo>* journal_ = nullptr;  // Solo mientras graba el historial
+};
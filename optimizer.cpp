@@ -0,0 +1,465 @@
+#include "optimizer.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+namespace {
+
+// ---------------- REGISTROS COMO BITS ----------------
+// R en los bits 0-15, F en 16-31, V en 32-47
+enum RegFile { kInt = 0, kFp = 1, kVec = 2 };
+using RegMask = uint64_t;
+constexpr int kRegBits = 48;
+
+inline int reg_bit(RegFile f, int r) { return int(f) * 16 + r; }
+inline RegMask bit_mask(int b) { return RegMask(1) << b; }
+
+// Recorre los operandos de registro de I: fn(campo, banco, lee, escribe).
+// Es la unica descripcion de operandos: de aqui salen lecturas, escrituras
+// y el renombrado
+template <class In, class Fn>
+void for_each_reg(In &I, Fn fn) {
+    auto addr = [&] {
+        if (I.addr_is_reg) fn(I.ra, kInt, true, false);
+        if (I.ri >= 0) fn(I.ri, kInt, true, false);
+    };
+    switch (I.op) {
+        case OpCode::LOAD:   addr(); fn(I.rd, I.fp ? kFp : kInt, false, true); break;
+        case OpCode::STORE:  addr(); fn(I.rd, I.fp ? kFp : kInt, true, false); break;
+        case OpCode::FETCH_ADD:
+            addr(); fn(I.rb, I.fp ? kFp : kInt, true, false); fn(I.rd, I.fp ? kFp : kInt, false, true);
+            break;
+        case OpCode::CAS:
+            addr(); fn(I.rb, I.fp ? kFp : kInt, true, false); fn(I.rc, I.fp ? kFp : kInt, true, false);
+            fn(I.rd, kInt, false, true);
+            break;
+        case OpCode::LL: addr(); fn(I.rd, I.fp ? kFp : kInt, false, true); break;
+        case OpCode::SC:
+            addr(); fn(I.rb, I.fp ? kFp : kInt, true, false); fn(I.rd, kInt, false, true);
+            break;
+        case OpCode::VLOAD:  addr(); fn(I.rd, kVec, false, true); break;
+        case OpCode::VSTORE: addr(); fn(I.rd, kVec, true, false); break;
+        case OpCode::FMUL:
+        case OpCode::FADD:
+            fn(I.ra, kFp, true, false); fn(I.rb, kFp, true, false); fn(I.rd, kFp, false, true);
+            break;
+        case OpCode::INC:
+        case OpCode::DEC:
+        case OpCode::ADDI:
+            fn(I.rd, kInt, true, true);
+            break;
+        case OpCode::ANDI:
+        case OpCode::SHRI:
+        case OpCode::SHLI:
+            fn(I.ra, kInt, true, false); fn(I.rd, kInt, false, true);
+            break;
+        case OpCode::ADD:
+            fn(I.ra, kInt, true, false); fn(I.rb, kInt, true, false); fn(I.rd, kInt, false, true);
+            break;
+        case OpCode::JNZ:
+        case OpCode::JZ:
+            fn(I.rd, kInt, true, false);
+            break;
+        case OpCode::VFMUL:
+        case OpCode::VFADD:
+            fn(I.ra, kVec, true, false); fn(I.rb, kVec, true, false); fn(I.rd, kVec, false, true);
+            break;
+        case OpCode::VFMA:
+            fn(I.ra, kVec, true, false); fn(I.rb, kVec, true, false); fn(I.rd, kVec, true, true);
+            break;
+        case OpCode::VREDUCE:
+            fn(I.ra, kVec, true, false); fn(I.rd, kFp, false, true);
+            break;
+        case OpCode::VZERO: fn(I.rd, kVec, false, true); break;
+        case OpCode::FZERO: fn(I.rd, kFp, false, true); break;
+        default: break;
+    }
+}
+
+RegMask reads(const Instr &I) {
+    RegMask m = 0;
+    for_each_reg(I, [&](const int &r, RegFile f, bool rd, bool) { if (rd) m |= bit_mask(reg_bit(f, r)); });
+    return m;
+}
+
+RegMask writes(const Instr &I) {
+    RegMask m = 0;
+    for_each_reg(I, [&](const int &r, RegFile f, bool, bool wr) { if (wr) m |= bit_mask(reg_bit(f, r)); });
+    return m;
+}
+
+inline bool is_jump(OpCode op)  { return op == OpCode::JNZ || op == OpCode::JZ; }
+inline bool is_load(OpCode op)  { return op == OpCode::LOAD || op == OpCode::VLOAD; }
+inline bool is_store(OpCode op) { return op == OpCode::STORE || op == OpCode::VSTORE || is_atomic_op(op); }
+inline bool is_mem(OpCode op)   { return is_load(op) || is_store(op); }
+
+// Registros R que un acceso a memoria usa como dato (no como direccion)
+RegMask int_data_regs(const Instr &I) {
+    if (!is_mem(I.op)) return 0;
+    Instr d = I;
+    d.addr_is_reg = false;  // Sin los operandos de direccion
+    d.ri = -1;
+    RegMask m = 0;
+    for_each_reg(d, [&](const int &r, RegFile f, bool, bool) { if (f == kInt) m |= bit_mask(reg_bit(f, r)); });
+    return m;
+}
+
+// Registros solo usados para formar la direccion (no el dato) de un acceso
+RegMask addr_regs(const Instr &I) {
+    if (!is_mem(I.op)) return 0;
+    RegMask m = 0;
+    if (I.addr_is_reg) m |= bit_mask(reg_bit(kInt, I.ra));
+    if (I.ri >= 0) m |= bit_mask(reg_bit(kInt, I.ri));
+    return m;
+}
+
+// Vivos a la entrada de cada instruccion (in[n]: fin del programa)
+std::vector<RegMask> live_in(const std::vector<Instr> &code) {
+    const size_t n = code.size();
+    std::vector<RegMask> in(n + 1, 0);
+    for (bool changed = true; changed; ) {
+        changed = false;
+        for (size_t i = n; i-- > 0; ) {
+            const Instr &I = code[i];
+            RegMask out = 0;
+            if (I.op != OpCode::HALT) out |= in[i + 1];
+            if (is_jump(I.op) && I.target >= 0) out |= in[I.target];
+            RegMask v = reads(I) | (out & ~writes(I));
+            if (v != in[i]) { in[i] = v; changed = true; }
+        }
+    }
+    return in;
+}
+
+Instr make(OpCode op, int rd) {
+    Instr I;
+    I.op = op;
+    I.rd = rd;
+    return I;
+}
+
+// ---------------- PLAN DE UN BUCLE ----------------
+struct Induction {
+    int reg;         // Registro R del puntero
+    int64_t step;    // Bytes que avanza por iteracion
+    size_t pos;      // Posicion del incremento en el cuerpo
+};
+
+struct LoopPlan {
+    size_t head = 0, jnz = 0;   // Cabeza del bucle y su JNZ (DEC en jnz-1)
+    int rc = 0, rt = 0;         // Contador original y contador del resto
+    int factor = 1;
+    bool renamed = false;
+    bool hoisted = false;
+    std::vector<Induction> ind;
+    std::vector<int> accs;      // Bits de los acumuladores
+    std::vector<std::array<int, kRegBits>> rename; // Por copia: bit -> bit
+};
+
+// Instruccion que solo acumula en r: FADD r,r,x / VFADD r,r,x / VFMA r,a,b
+bool is_accumulation(const Instr &I, int b) {
+    RegFile f = RegFile(b / 16);
+    int r = b % 16;
+    if (I.op == OpCode::FADD && f == kFp)
+        return I.rd == r && ((I.ra == r) != (I.rb == r));
+    if (I.op == OpCode::VFADD && f == kVec)
+        return I.rd == r && ((I.ra == r) != (I.rb == r));
+    if (I.op == OpCode::VFMA && f == kVec)
+        return I.rd == r && I.ra != r && I.rb != r;
+    return false;
+}
+
+int floor_pow2(int v) {
+    int p = 1;
+    while (p * 2 <= v) p *= 2;
+    return p;
+}
+
+bool plan_loop(const std::vector<Instr> &code, size_t h, size_t j,
+               const std::vector<RegMask> &live, RegMask used,
+               const OptConfig &cfg, LoopPlan &P) {
+    const int rc = code[j].rd;
+    if (j < h + 2 || code[j - 1].op != OpCode::DEC || code[j - 1].rd != rc) return false;
+    const size_t b0 = h, b1 = j - 1;   // Cuerpo: [b0, b1)
+    const RegMask rc_bit = bit_mask(reg_bit(kInt, rc));
+    for (size_t p = b0; p < b1; ++p) {
+        const Instr &I = code[p];
+        if (is_jump(I.op) || I.op == OpCode::HALT) return false;
+        if ((reads(I) | writes(I)) & rc_bit) return false;
+    }
+
+    // Registros libres: los que el programa no menciona nunca
+    std::vector<int> free_int, free_fp, free_vec;
+    for (int r = 0; r < kIntRegs; ++r) if (!(used & bit_mask(reg_bit(kInt, r)))) free_int.push_back(r);
+    for (int r = 0; r < kFpRegs; ++r)  if (!(used & bit_mask(reg_bit(kFp, r))))  free_fp.push_back(r);
+    for (int r = 0; r < kVecRegs; ++r) if (!(used & bit_mask(reg_bit(kVec, r)))) free_vec.push_back(r);
+    if (free_int.empty()) return false;
+
+    P = LoopPlan{};
+    P.head = h; P.jnz = j; P.rc = rc; P.rt = free_int[0];
+    const int max_factor = floor_pow2(cfg.unroll);
+    if (max_factor < 2) return false;
+
+    // Clasifica cada registro escrito en el cuerpo: puntero (R), acumulador
+    // o temporal (F/V). Cualquier otra cosa obliga a copiar literal
+    RegMask wbody = 0;
+    for (size_t p = b0; p < b1; ++p) wbody |= writes(code[p]);
+    std::vector<int> temps;
+    bool ok = true;
+    for (int b = 0; b < kRegBits && ok; ++b) {
+        if (!(wbody & bit_mask(b))) continue;
+        std::vector<size_t> refs;
+        for (size_t p = b0; p < b1; ++p)
+            if ((reads(code[p]) | writes(code[p])) & bit_mask(b)) refs.push_back(p);
+
+        if (b / 16 == kInt) {
+            // Puntero: un unico INC/ADDI y el resto de los usos como direccion
+            int writers = 0;
+            Induction ind{b % 16, 0, 0};
+            for (size_t p : refs) {
+                const Instr &I = code[p];
+                if (writes(I) & bit_mask(b)) {
+                    writers++;
+                    if (I.op == OpCode::INC) ind.step = int64_t(I.count) * 8;
+                    else if (I.op == OpCode::ADDI) ind.step = I.imm;
+                    else ok = false;
+                    ind.pos = p - b0;
+                } else if (!(addr_regs(I) & bit_mask(b)) || (int_data_regs(I) & bit_mask(b))) {
+                    ok = false;  // Usado como dato, no solo como direccion
+                }
+            }
+            if (writers != 1) ok = false;
+            if (ok) P.ind.push_back(ind);
+        } else if (refs.size() == 1 && is_accumulation(code[refs[0]], b)) {
+            P.accs.push_back(b);
+        } else {
+            // Temporal: se escribe antes de leerse y no sale vivo del bucle
+            const Instr &first = code[refs[0]];
+            if ((reads(first) & bit_mask(b)) || (live[j + 1] & bit_mask(b))) ok = false;
+            else temps.push_back(b);
+        }
+    }
+
+    P.factor = max_factor;
+    if (ok) {
+        auto need = [&](RegFile f) {
+            int n = 0;
+            for (int b : P.accs) n += (b / 16 == f);
+            for (int b : temps) n += (b / 16 == f);
+            return n;
+        };
+        while (P.factor >= 2 &&
+               (need(kFp) * (P.factor - 1) > int(free_fp.size()) ||
+                need(kVec) * (P.factor - 1) > int(free_vec.size())))
+            P.factor /= 2;
+        if (P.factor < 2) ok = false;
+    }
+    if (!ok) {
+        P.factor = max_factor;
+        P.ind.clear();
+        P.accs.clear();
+        return true;
+    }
+    P.renamed = true;
+
+    // Renombrado: cada copia k>0 recibe registros libres propios
+    size_t next_fp = 0, next_vec = 0;
+    P.rename.resize(P.factor);
+    for (int k = 0; k < P.factor; ++k) {
+        auto &m = P.rename[k];
+        for (int b = 0; b < kRegBits; ++b) m[b] = b;
+        if (k == 0) continue;
+        auto assign = [&](int b) {
+            if (b / 16 == kFp) m[b] = reg_bit(kFp, free_fp[next_fp++]);
+            else m[b] = reg_bit(kVec, free_vec[next_vec++]);
+        };
+        for (int b : P.accs) assign(b);
+        for (int b : temps) assign(b);
+    }
+
+    // Adelantar LOADs: sin stores, FENCE ni BARRIER en el cuerpo, y sin que el destino
+    // de un LOAD se use antes en la misma copia
+    P.hoisted = true;
+    bool any_load = false;
+    for (size_t p = b0; p < b1 && P.hoisted; ++p) {
+        const Instr &I = code[p];
+        if (is_store(I.op) || I.op == OpCode::FENCE || I.op == OpCode::BARRIER) P.hoisted = false;
+        if (!is_load(I.op)) continue;
+        any_load = true;
+        for (size_t q = b0; q < p; ++q)
+            if (!is_load(code[q].op) && ((reads(code[q]) | writes(code[q])) & writes(I)))
+                P.hoisted = false;
+    }
+    P.hoisted = P.hoisted && any_load;
+    return true;
+}
+
+// Copia k de la instruccion p del cuerpo (desplazamientos y renombrado)
+Instr copy_of(const std::vector<Instr> &code, const LoopPlan &P, size_t p, int k) {
+    Instr c = code[p];
+    if (!P.renamed) return c;
+    const size_t pos = p - P.head;
+    if (is_mem(c.op)) {
+        for (const auto &ind : P.ind) {
+            int64_t delta = k * ind.step + (ind.pos < pos ? ind.step : 0);
+            if (c.addr_is_reg && c.ra == ind.reg) c.imm += delta;
+            if (c.ri == ind.reg) c.imm += delta * c.scale;
+        }
+    }
+    const auto &m = P.rename[k];
+    for_each_reg(c, [&](int &r, RegFile f, bool, bool) {
+        if (f != kInt) r = m[reg_bit(f, r)] % 16;
+    });
+    return c;
+}
+
+bool is_increment(const LoopPlan &P, size_t p) {
+    for (const auto &ind : P.ind)
+        if (ind.pos == p - P.head) return true;
+    return false;
+}
+
+} // namespace
+
+void OptReport::print(std::ostream &os) const {
+    os << "Optimizador: " << instrs_before << " -> " << instrs_after << " instrucciones estaticas\n";
+    for (const auto &L : loops) {
+        os << "  " << (L.label.empty() ? "(bucle)" : L.label) << ": cuerpo " << L.body
+           << ", x" << L.factor;
+        if (!L.renamed) os << " (copia literal)";
+        else if (L.accumulators > 1) os << ", " << L.accumulators << " acumuladores";
+        if (L.hoisted) os << ", LOADs adelantados";
+        os << "\n";
+    }
+}
+
+void optimize(std::vector<Instr> &code, std::unordered_map<std::string,size_t> &labels,
+              const OptConfig &cfg, OptReport *report) {
+    const size_t n = code.size();
+    if (report) { *report = OptReport{}; report->instrs_before = n; }
+
+    RegMask used = 0;
+    for (const auto &I : code) used |= reads(I) | writes(I);
+    const std::vector<RegMask> live = live_in(code);
+
+    // Bucles candidatos: JNZ hacia atras sin otros saltos que caigan dentro
+    std::vector<int> loop_at(n, -1);   // Cabeza -> indice en plans
+    std::vector<LoopPlan> plans;
+    for (size_t j = 0; j < n; ++j) {
+        const Instr &J = code[j];
+        if (J.op != OpCode::JNZ || J.target < 0 || size_t(J.target) >= j) continue;
+        const size_t h = size_t(J.target);
+        bool entered = false;
+        for (size_t i = 0; i < n && !entered; ++i)
+            if (i != j && is_jump(code[i].op) && code[i].target > int(h) && code[i].target <= int(j))
+                entered = true;
+        LoopPlan P;
+        if (entered || loop_at[h] >= 0 || !plan_loop(code, h, j, live, used, cfg, P)) continue;
+        loop_at[h] = int(plans.size());
+        plans.push_back(std::move(P));
+    }
+
+    struct Out { Instr I; bool remap; }; // remap: I.target es un indice viejo
+    std::vector<Out> out;
+    std::vector<size_t> old_to_new(n + 1, 0);
+    out.reserve(n * 2);
+    auto emit = [&](const Instr &I, bool remap = false) {
+        out.push_back({I, remap});
+        return out.size() - 1;
+    };
+
+    for (size_t i = 0; i < n; ) {
+        if (loop_at[i] < 0) {
+            old_to_new[i] = out.size();
+            emit(code[i], is_jump(code[i].op));
+            ++i;
+            continue;
+        }
+        const LoopPlan &P = plans[loop_at[i]];
+        const size_t b0 = P.head, b1 = P.jnz - 1;
+        const int U = P.factor;
+        for (size_t q = P.head; q <= P.jnz; ++q) old_to_new[q] = out.size();
+
+        // Preambulo: iteraciones del cuerpo desenrollado y del resto
+        Instr andi = make(OpCode::ANDI, P.rt); andi.ra = P.rc; andi.imm = U - 1;
+        Instr shri = make(OpCode::SHRI, P.rc); shri.ra = P.rc;
+        while ((int64_t(1) << shri.imm) < U) shri.imm++;
+        emit(andi);
+        emit(shri);
+        // Sin iteraciones completas se salta directo al resto: ni ceros ni sumas
+        const size_t skip_main = emit(make(OpCode::JZ, P.rc));
+        for (int b : P.accs)
+            for (int k = 1; k < U; ++k)
+                emit(make(b / 16 == kFp ? OpCode::FZERO : OpCode::VZERO, P.rename[k][b] % 16));
+
+        // Cuerpo desenrollado
+        const size_t main_start = out.size();
+        if (P.hoisted) {
+            for (int k = 0; k < U; ++k)
+                for (size_t p = b0; p < b1; ++p)
+                    if (is_load(code[p].op)) emit(copy_of(code, P, p, k));
+            for (int k = 0; k < U; ++k)
+                for (size_t p = b0; p < b1; ++p)
+                    if (!is_load(code[p].op) && !is_increment(P, p)) emit(copy_of(code, P, p, k));
+        } else {
+            for (int k = 0; k < U; ++k)
+                for (size_t p = b0; p < b1; ++p)
+                    if (!(P.renamed && is_increment(P, p))) emit(copy_of(code, P, p, k));
+        }
+        for (const auto &ind : P.ind) {
+            Instr addi = make(OpCode::ADDI, ind.reg);
+            addi.imm = ind.step * U;
+            emit(addi);
+        }
+        emit(make(OpCode::DEC, P.rc));
+        Instr back = make(OpCode::JNZ, P.rc); back.target = int(main_start);
+        emit(back);
+
+        // Salida: junta los acumuladores y corre el resto
+        for (int b : P.accs)
+            for (int k = 1; k < U; ++k) {
+                Instr add = make(b / 16 == kFp ? OpCode::FADD : OpCode::VFADD, b % 16);
+                add.ra = b % 16;
+                add.rb = P.rename[k][b] % 16;
+                emit(add);
+            }
+        out[skip_main].I.target = int(out.size());
+        Instr skip_rest = make(OpCode::JZ, P.rt); skip_rest.target = int(P.jnz + 1);
+        emit(skip_rest, true);
+        const size_t rest_start = out.size();
+        for (size_t p = b0; p < b1; ++p) emit(code[p]);
+        emit(make(OpCode::DEC, P.rt));
+        Instr rest_back = make(OpCode::JNZ, P.rt); rest_back.target = int(rest_start);
+        emit(rest_back);
+
+        if (report) {
+            OptReport::Loop L;
+            for (const auto &[name, at] : labels) if (at == P.head) L.label = name;
+            L.body = int(b1 - b0);
+            L.factor = U;
+            L.accumulators = P.accs.empty() ? 1 : U;
+            L.renamed = P.renamed;
+            L.hoisted = P.hoisted;
+            report->loops.push_back(L);
+        }
+        i = P.jnz + 1;
+    }
+    old_to_new[n] = out.size();
+
+    code.clear();
+    code.reserve(out.size());
+    for (auto &o : out) {
+        if (o.remap && o.I.target >= 0) o.I.target = int(old_to_new[o.I.target]);
+        code.push_back(o.I);
+    }
+    for (auto &[name, at] : labels) at = old_to_new[at];
+    if (report) report->instrs_after = code.size();
+}
+
+ProgramPtr optimize_program(const Program &prog, const OptConfig &cfg, OptReport *report) {
+    std::vector<Instr> code(prog.code(), prog.code() + prog.size());
+    std::unordered_map<std::string,size_t> labels = prog.labels();
+    optimize(code, labels, cfg, report);
+    return std::make_shared<const Program>(code, std::move(labels));
+}
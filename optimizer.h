@@ -0,0 +1,48 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "instr.h"
+#include "program_image.h"
+
+// OPTIMIZADOR DE ENSAMBLADOR - pasada opcional entre parse_asm y
+// PE::load_program. Para cada bucle contado "DEC Rc / JNZ Rc, L" sin saltos
+// internos:
+//   - desenrolla el cuerpo con un bucle de resto (Rc & (U-1) iteraciones)
+//   - usa un acumulador por copia (FADD/VFADD/VFMA) y los suma a la salida
+//   - cambia los incrementos de punteros por desplazamientos [Rp + k*paso]
+//   - adelanta los LOAD de todas las copias al inicio del cuerpo
+// Si no alcanzan los registros libres, el factor baja; si el cuerpo no se
+// puede renombrar, se copia literal (sigue ahorrando DEC/JNZ).
+// Separar acumuladores cambia el orden de las sumas de punto flotante
+struct OptConfig {
+    int unroll = 4;  // Factor maximo (potencia de 2)
+};
+
+struct OptReport {
+    struct Loop {
+        std::string label;     // Etiqueta de la cabeza del bucle
+        int body = 0;          // Instrucciones del cuerpo (sin DEC/JNZ)
+        int factor = 1;
+        int accumulators = 1;  // Acumuladores por variable de reduccion
+        bool renamed = false;  // Copias con registros propios (si no, literal)
+        bool hoisted = false;  // LOADs adelantados
+    };
+    std::vector<Loop> loops;
+    size_t instrs_before = 0;  // Instrucciones estaticas
+    size_t instrs_after = 0;
+
+    void print(std::ostream &os) const;
+};
+
+// Optimiza en el lugar; las etiquetas se reubican a las nuevas posiciones
+void optimize(std::vector<Instr> &code, std::unordered_map<std::string,size_t> &labels,
+              const OptConfig &cfg, OptReport *report = nullptr);
+
+// Version para un programa compartido: devuelve uno nuevo
+ProgramPtr optimize_program(const Program &prog, const OptConfig &cfg, OptReport *report = nullptr);
+
+#endif
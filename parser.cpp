@@ -1,4 +1,5 @@
 #include "parser.h"
+#include <iostream>
 #include <sstream>
 #include <cctype>
 #include <algorithm>
@@ -13,12 +14,17 @@ static inline std::string trim(const std::string &s) {
     return s.substr(a, b - a + 1);
 }
 
-// Divide una línea en tokens (separados por espacios o comas)
+// Divide una línea en tokens (separados por espacios o comas). Un operando
+// de memoria "[R0 + 8]" queda como un solo token, sin espacios
 static std::vector<std::string> tokenize_line(const std::string &line) {
     std::vector<std::string> toks;
     std::string cur;
+    bool in_bracket = false;
     for (size_t i = 0; i < line.size(); ++i) {
         char c = line[i];
+        if (c == '[') in_bracket = true;
+        else if (c == ']') in_bracket = false;
+        if (in_bracket && (c == ',' || isspace((unsigned char)c))) continue;
         if (c == ',') {
             if (!cur.empty()) { toks.push_back(cur); cur.clear(); }
             continue;
@@ -33,15 +39,38 @@ static std::vector<std::string> tokenize_line(const std::string &line) {
     return toks;
 }
 
-// Verifica si un token es un registro (R0-R7)
-static bool is_register_token(const std::string &tok, int &reg_out) {
-    if (tok.size() >= 2 && (tok[0] == 'R' || tok[0] == 'r')) {
-        try {
-            int r = std::stoi(tok.substr(1));
-            if (r >= 0 && r < 8) { reg_out = r; return true; }
-        } catch(...) {}
+// Registro "<prefijo><n>" con 0 <= n < limit, sin excepciones
+static bool parse_reg(const std::string &tok, char prefix, int limit, int &reg_out) {
+    if (tok.size() < 2 || toupper((unsigned char)tok[0]) != prefix) return false;
+    int r = 0;
+    for (size_t i = 1; i < tok.size(); ++i) {
+        if (!isdigit((unsigned char)tok[i]) || r >= limit) return false;
+        r = r * 10 + (tok[i] - '0');
     }
-    return false;
+    if (r >= limit) return false;
+    reg_out = r;
+    return true;
+}
+
+// Verifica si un token es un registro entero (R0-R7)
+static bool is_register_token(const std::string &tok, int &reg_out) {
+    return parse_reg(tok, 'R', kIntRegs, reg_out);
+}
+
+// Verifica si un token es un registro de punto flotante (F0-F15)
+static bool is_fp_token(const std::string &tok, int &reg_out) {
+    return parse_reg(tok, 'F', kFpRegs, reg_out);
+}
+
+// Operando de un slot FP (FMUL, FADD, destino de VREDUCE). Acepta tambien
+// "Rn" por compatibilidad con programas viejos: en ese slot es Fn
+static bool is_fp_slot_token(const std::string &tok, int &reg_out) {
+    return is_fp_token(tok, reg_out) || is_register_token(tok, reg_out);
+}
+
+// Verifica si un token es un registro vectorial (V0-V7)
+static bool is_vector_token(const std::string &tok, int &reg_out) {
+    return parse_reg(tok, 'V', kVecRegs, reg_out);
 }
 
 // Convierte string a número (soporta decimal y hexadecimal)
@@ -54,52 +83,142 @@ static bool parse_number(const std::string &tok, size_t &out) {
     } catch(...) { return false; }
 }
 
+// Inmediato con signo (decimal o 0x hexadecimal)
+static bool parse_imm(const std::string &tok, int64_t &out) {
+    try {
+        size_t p = 0;
+        out = std::stoll(tok, &p, 0);
+        return p == tok.size();
+    } catch(...) { return false; }
+}
+
+// Operando de memoria: número (inmediata) o entre corchetes una suma de
+// base, desplazamiento e indice escalado: "[Rb]", "[Rb + imm]", "[Rb - imm]",
+// "[Rb + Ri*scale]", "[Rb + Ri*scale + imm]", "[imm]". false si un indice
+// escalado no es "Ri*1|2|4|8" (no se descarta en silencio)
+static bool parse_mem_operand(const std::string &operand, Instr &I) {
+    if (operand.size() >= 3 && operand.front()=='[' && operand.back()==']') {
+        std::string inner = operand.substr(1, operand.size()-2);
+        size_t i = 0;
+        while (i < inner.size()) {
+            bool neg = false;
+            if (inner[i] == '+' || inner[i] == '-') { neg = inner[i] == '-'; ++i; }
+            size_t j = inner.find_first_of("+-", i);
+            // Un signo justo despues de '*' o al inicio pertenece al numero
+            while (j != std::string::npos && j > i && inner[j-1] == '*') j = inner.find_first_of("+-", j + 1);
+            std::string term = inner.substr(i, j == std::string::npos ? std::string::npos : j - i);
+            i = (j == std::string::npos) ? inner.size() : j;
+
+            int r;
+            int64_t v;
+            size_t star = term.find('*');
+            if (star != std::string::npos) {
+                if (!is_register_token(term.substr(0, star), r) || !parse_imm(term.substr(star + 1), v) ||
+                    (v != 1 && v != 2 && v != 4 && v != 8) || neg)
+                    return false;
+                I.ri = r; I.scale = int(v);
+            } else if (is_register_token(term, r) && !neg) {
+                if (!I.addr_is_reg) { I.addr_is_reg = true; I.ra = r; }
+                else { I.ri = r; I.scale = 1; }
+            } else if (parse_imm(term, v)) {
+                I.imm += neg ? -v : v;
+            }
+        }
+    } else {
+        size_t addr;
+        if (parse_number(operand, addr)) { I.addr_is_reg = false; I.address = addr; }
+    }
+    return true;
+}
+
+// Indice de una etiqueta (-1 si no existe)
+static int resolve_label(const std::unordered_map<std::string,size_t> &labels, const std::string &name) {
+    auto it = labels.find(name);
+    return it == labels.end() ? -1 : int(it->second);
+}
+
 // CONSTRUYE INSTRUCCIÓN A PARTIR DE TOKENS
-static Instr make_instr_from_tokens(const std::vector<std::string> &toks) {
+// err queda con el motivo si un operando es invalido
+static Instr make_instr_from_tokens(const std::vector<std::string> &toks,
+                                    const std::unordered_map<std::string,size_t> &labels,
+                                    std::string &err) {
     Instr I;
     if (toks.empty()) return I;
     std::string op = toks[0];
     std::transform(op.begin(), op.end(), op.begin(), ::toupper);
 
     // PARSEO DE CADA TIPO DE INSTRUCCIÓN
-    if (op == "LOAD") {
-        I.op = OpCode::LOAD;
+    if (op == "LOAD" || op == "STORE") {
+        I.op = (op=="LOAD" ? OpCode::LOAD : OpCode::STORE);
         if (toks.size() < 3) return I;
+        // El nombre elige el banco: Fn carga/almacena el double, Rn el entero
         int rd;
+        if (is_fp_token(toks[1], rd)) { I.rd = rd; I.fp = true; }
+        else if (is_register_token(toks[1], rd)) I.rd = rd;
+        if (!parse_mem_operand(toks[2], I)) err = "operando de memoria invalido " + toks[2];
+    }
+    else if (op == "FETCH_ADD" || op == "LL") {
+        // FETCH_ADD Rd, [mem], Rb / LL Rd, [mem]: el banco de Rd elige entero o double
+        I.op = (op=="LL" ? OpCode::LL : OpCode::FETCH_ADD);
+        if (toks.size() < 3) return I;
+        int rd, rb;
+        if (is_fp_token(toks[1], rd)) { I.rd = rd; I.fp = true; }
+        else if (is_register_token(toks[1], rd)) I.rd = rd;
+        if (!parse_mem_operand(toks[2], I)) err = "operando de memoria invalido " + toks[2];
+        if (I.op == OpCode::FETCH_ADD && toks.size() >= 4 &&
+            (I.fp ? is_fp_token(toks[3], rb) : is_register_token(toks[3], rb))) I.rb = rb;
+    }
+    else if (op == "CAS" || op == "SC") {
+        // CAS Rd, [mem], Rb, Rc / SC Rd, [mem], Rb: Rd (entero) recibe 1 si
+        // escribio; el banco de Rb elige entero o double
+        I.op = (op=="CAS" ? OpCode::CAS : OpCode::SC);
+        if (toks.size() < 4) return I;
+        int rd, rb, rc;
         if (is_register_token(toks[1], rd)) I.rd = rd;
-        std::string operand = toks[2];
-        // Detecta si la dirección es directa o por registro
-        if (operand.size() >= 3 && operand.front()=='[' && operand.back()==']') {
-            std::string inner = operand.substr(1, operand.size()-2);
-            int r;
-            if (is_register_token(inner, r)) { I.addr_is_reg = true; I.ra = r; }
-        } else {
-            size_t addr;
-            if (parse_number(operand, addr)) { I.addr_is_reg = false; I.address = addr; }
+        if (!parse_mem_operand(toks[2], I)) err = "operando de memoria invalido " + toks[2];
+        if (is_fp_token(toks[3], rb)) { I.rb = rb; I.fp = true; }
+        else if (is_register_token(toks[3], rb)) I.rb = rb;
+        if (I.op == OpCode::CAS && toks.size() >= 5 &&
+            (I.fp ? is_fp_token(toks[4], rc) : is_register_token(toks[4], rc))) I.rc = rc;
+    }
+    else if (op == "VLOAD" || op == "VSTORE") {
+        I.op = (op=="VLOAD" ? OpCode::VLOAD : OpCode::VSTORE);
+        if (toks.size() < 3) return I;
+        int vd;
+        if (is_vector_token(toks[1], vd)) I.rd = vd;
+        if (!parse_mem_operand(toks[2], I)) err = "operando de memoria invalido " + toks[2];
+    }
+    else if (op == "VFMUL" || op == "VFADD" || op == "VFMA") {
+        I.op = (op=="VFMUL" ? OpCode::VFMUL : op=="VFADD" ? OpCode::VFADD : OpCode::VFMA);
+        if (toks.size() < 4) return I;
+        int vd, va, vb;
+        if (is_vector_token(toks[1], vd) &&
+            is_vector_token(toks[2], va) &&
+            is_vector_token(toks[3], vb)) {
+            I.rd = vd; I.ra = va; I.rb = vb;
         }
     }
-    else if (op == "STORE") {
-        I.op = OpCode::STORE;
+    else if (op == "VREDUCE") {
+        // VREDUCE Rd, Va: Rd = Va[0] + Va[1] + Va[2] + Va[3]
+        I.op = OpCode::VREDUCE;
         if (toks.size() < 3) return I;
-        int rd;
-        if (is_register_token(toks[1], rd)) I.rd = rd;
-        std::string operand = toks[2];
-        if (operand.size() >= 3 && operand.front()=='[' && operand.back()==']') {
-            std::string inner = operand.substr(1, operand.size()-2);
-            int r;
-            if (is_register_token(inner, r)) { I.addr_is_reg = true; I.ra = r; }
-        } else {
-            size_t addr;
-            if (parse_number(operand, addr)) { I.addr_is_reg = false; I.address = addr; }
+        int rd, va;
+        if (is_fp_slot_token(toks[1], rd) && is_vector_token(toks[2], va)) {
+            I.rd = rd; I.ra = va;
         }
     }
+    else if (op == "VZERO") {
+        I.op = OpCode::VZERO;
+        int vd;
+        if (toks.size() >= 2 && is_vector_token(toks[1], vd)) I.rd = vd;
+    }
     else if (op == "FMUL" || op == "FADD") {
         I.op = (op=="FMUL" ? OpCode::FMUL : OpCode::FADD);
         if (toks.size() < 4) return I;
         int rd, ra, rb;
-        if (is_register_token(toks[1], rd) &&
-            is_register_token(toks[2], ra) &&
-            is_register_token(toks[3], rb)) {
+        if (is_fp_slot_token(toks[1], rd) &&
+            is_fp_slot_token(toks[2], ra) &&
+            is_fp_slot_token(toks[3], rb)) {
             I.rd = rd; I.ra = ra; I.rb = rb;
         }
     }
@@ -108,23 +227,64 @@ static Instr make_instr_from_tokens(const std::vector<std::string> &toks) {
         if (toks.size() >= 2) {
             int r; if (is_register_token(toks[1], r)) I.rd = r;
         }
+        // "INC R0, 4": avanza varios elementos (p.ej. un vector completo)
+        size_t n;
+        if (I.op == OpCode::INC && toks.size() >= 3 && parse_number(toks[2], n)) I.count = int(n);
+    }
+    else if (op == "ADDI") {
+        // ADDI Rd, imm: Rd += imm (entero, con signo)
+        I.op = OpCode::ADDI;
+        int r;
+        if (toks.size() >= 2 && is_register_token(toks[1], r)) I.rd = r;
+        if (toks.size() >= 3) parse_imm(toks[2], I.imm);
     }
-    else if (op == "JNZ") {
-        I.op = OpCode::JNZ;
+    else if (op == "ADD") {
+        // ADD Rd, Ra, Rb (entero)
+        I.op = OpCode::ADD;
+        if (toks.size() < 4) return I;
+        int rd, ra, rb;
+        if (is_register_token(toks[1], rd) && is_register_token(toks[2], ra) &&
+            is_register_token(toks[3], rb)) {
+            I.rd = rd; I.ra = ra; I.rb = rb;
+        }
+    }
+    else if (op == "ANDI" || op == "SHRI" || op == "SHLI") {
+        // ANDI Rd, Ra, imm / SHRI Rd, Ra, imm / SHLI Rd, Ra, imm
+        I.op = (op=="ANDI" ? OpCode::ANDI : op=="SHRI" ? OpCode::SHRI : OpCode::SHLI);
+        if (toks.size() < 4) return I;
+        int rd, ra;
+        if (is_register_token(toks[1], rd) && is_register_token(toks[2], ra)) {
+            I.rd = rd; I.ra = ra;
+        }
+        parse_imm(toks[3], I.imm);
+    }
+    else if (op == "FZERO") {
+        I.op = OpCode::FZERO;
+        int fd;
+        if (toks.size() >= 2 && is_fp_slot_token(toks[1], fd)) I.rd = fd;
+    }
+    else if (op == "JNZ" || op == "JZ") {
+        I.op = (op=="JNZ" ? OpCode::JNZ : OpCode::JZ);
         if (toks.size() >= 2) {
-            // Dos formatos: "JNZ R3, LOOP" o "JNZ LOOP" (registro implícito R3)
+            // Dos formatos: "JNZ R3, LOOP" o "JNZ LOOP" (registro implícito R3); igual JZ
             int r;
             if (is_register_token(toks[1], r)) {
                 I.rd = r;
-                if (toks.size() >= 3) I.label = toks[2];
+                if (toks.size() >= 3) I.target = resolve_label(labels, toks[2]);
             } else {
                 I.rd = 3; // Registro por defecto para contador
-                I.label = toks[1];
+                I.target = resolve_label(labels, toks[1]);
             }
         }
     }
     else if (op == "HALT") {
         I.op = OpCode::HALT;
+    }
+    else if (op == "FENCE") {
+        I.op = OpCode::FENCE;
+    }
+    else if (op == "BARRIER") {
+        I.op = OpCode::BARRIER;
     } else {
         I.op = OpCode::NOP; // No operation
     }
@@ -132,7 +292,7 @@ static Instr make_instr_from_tokens(const std::vector<std::string> &toks) {
 }
 
 // FUNCIÓN PRINCIPAL DE PARSING
-void parse_asm(const std::string &asm_text,
+bool parse_asm(const std::string &asm_text,
                std::vector<Instr> &out_program,
                std::unordered_map<std::string,size_t> &out_label_map) {
     out_program.clear(); out_label_map.clear();
@@ -160,10 +320,25 @@ void parse_asm(const std::string &asm_text,
         cleaned.push_back(line);
     }
     
-    // SEGUNDA PASADA: Convertir líneas limpias a instrucciones
+    // SEGUNDA PASADA: Convertir líneas limpias a instrucciones (las
+    // etiquetas ya son conocidas y los saltos quedan resueltos a indices)
+    out_program.reserve(cleaned.size());
+    bool ok = true;
     for (const auto &ln : cleaned) {
         auto toks = tokenize_line(ln);
         if (toks.empty()) continue;
-        out_program.push_back(make_instr_from_tokens(toks));
+        std::string err;
+        out_program.push_back(make_instr_from_tokens(toks, out_label_map, err));
+        if (!err.empty()) {
+            std::cerr << "Error: " << err << " en \"" << ln << "\"\n";
+            ok = false;
+        }
     }
-}
\ No newline at end of file
+    return ok;
+}
+
+bool uses_vector_ops(const Instr *code, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+        if (is_vector_op(code[i].op)) return true;
+    return false;
+}
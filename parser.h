@@ -6,6 +6,10 @@
 #include <unordered_map>
 #include "instr.h"
 
-// PARSER DE ENSAMBLADOR
-void parse_asm(const std::string &asm_text, std::vector<Instr> &out_program, std::unordered_map<std::string,size_t> &out_label_map);
+// PARSER DE ENSAMBLADOR - false (con mensaje en cerr) si una linea tiene un
+// operando invalido
+bool parse_asm(const std::string &asm_text, std::vector<Instr> &out_program, std::unordered_map<std::string,size_t> &out_label_map);
+
+// True si el programa usa instrucciones vectoriales (cambia la convencion de registros)
+bool uses_vector_ops(const Instr *code, size_t n);
 #endif
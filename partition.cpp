@@ -0,0 +1,275 @@
+#include "partition.h"
+#include "barrier.h"
+#include "parser.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+
+// Doubles por linea de cache: unidad de alineacion del layout padded
+static constexpr size_t kLineWords = hw::kBlockBytes / 8;
+static size_t line_up(size_t w) { return (w + kLineWords - 1) / kLineWords * kLineWords; }
+
+bool parse_partition(const std::string& spec, PartitionConfig& out) {
+    const size_t colon = spec.find(':');
+    const std::string name = spec.substr(0, colon);
+    PartitionConfig cfg = out;
+    if (name == "block") cfg.kind = Partition::Block;
+    else if (name == "cyclic") cfg.kind = Partition::Cyclic;
+    else if (name == "line") cfg.kind = Partition::Line;
+    else if (name == "dynamic") cfg.kind = Partition::Dynamic;
+    else if (name == "guided") cfg.kind = Partition::Guided;
+    else return false;
+    if (colon != std::string::npos) {
+        int c = std::atoi(spec.c_str() + colon + 1);
+        if (c <= 0) return false;
+        cfg.chunk = c;
+    }
+    out = cfg;
+    return true;
+}
+
+const char* partition_name(Partition p) {
+    switch (p) {
+        case Partition::Block:   return "block";
+        case Partition::Cyclic:  return "cyclic";
+        case Partition::Line:    return "line";
+        case Partition::Dynamic: return "dynamic";
+        case Partition::Guided:  return "guided";
+    }
+    return "?";
+}
+
+const char* partition_kernel(Partition p) {
+    switch (p) {
+        case Partition::Cyclic:  return "dotprod_cyclic.asm";
+        case Partition::Dynamic:
+        case Partition::Guided:  return "dotprod_dynamic.asm";
+        default:                 return "dotprod.asm";
+    }
+}
+
+bool parse_layout(const std::string& spec, Layout& out) {
+    if (spec == "packed") out = Layout::Packed;
+    else if (spec == "padded") out = Layout::Padded;
+    else return false;
+    return true;
+}
+
+const char* layout_name(Layout l) {
+    return l == Layout::Packed ? "packed" : "padded";
+}
+
+std::vector<std::pair<int,int>> dot_chunks(int N, unsigned num_pes, const PartitionConfig& cfg) {
+    std::vector<std::pair<int,int>> chunks;
+    const int min_chunk = std::max(1, cfg.chunk);
+    for (int start = 0; start < N;) {
+        int len = min_chunk;
+        if (cfg.kind == Partition::Guided)
+            len = std::max(min_chunk, (N - start + int(num_pes) - 1) / int(num_pes));
+        len = std::min(len, N - start);
+        chunks.push_back({start, len});
+        start += len;
+    }
+    return chunks;
+}
+
+// Tramo contiguo [start, start+len) del PE p (block / line)
+static void contiguous_segment(int N, int P, const PartitionConfig& cfg, int p, int& start, int& len) {
+    if (cfg.kind == Partition::Line) {
+        // Reparto balanceado de lineas enteras: ningun PE comparte linea de A
+        const int kLineElems = int(kLineWords);
+        const int lines = (N + kLineElems - 1) / kLineElems;
+        const int base = lines / P, rest = lines % P;
+        const int l0 = p * base + std::min(p, rest);
+        const int l1 = l0 + base + (p < rest ? 1 : 0);
+        start = std::min(N, l0 * kLineElems);
+        len = std::min(N, l1 * kLineElems) - start;
+    } else {
+        const int base = N / P, rest = N % P;
+        start = p * base + std::min(p, rest);
+        len = base + (p < rest ? 1 : 0);
+    }
+}
+
+DotLayout dot_layout(int N, unsigned num_pes, const PartitionConfig& cfg) {
+    DotLayout L;
+    L.slots = reduction_slots(num_pes);
+    L.baseA = 0;
+    if (cfg.layout == Layout::Padded) {
+        // Cada zona empieza en linea; S[p] y Q (escritos) van solos en su linea
+        L.baseB = line_up(L.baseA + size_t(N));
+        L.baseS = line_up(L.baseB + size_t(N));
+        L.strideS = kLineWords;
+        L.baseQ = L.baseS + L.slots * L.strideS;
+        L.baseT = L.baseQ + kLineWords;
+    } else {
+        L.baseB = L.baseA + size_t(N);
+        L.baseS = L.baseB + size_t(N);
+        L.baseQ = L.baseS + L.slots;
+        L.baseT = L.baseQ + 1;
+    }
+    L.words = L.baseT;
+    if (cfg.kind == Partition::Dynamic || cfg.kind == Partition::Guided)
+        L.words += 2 * (dot_chunks(N, num_pes, cfg).size() + num_pes);
+    L.words = line_up(L.words);  // Bloques enteros: las caches leen la linea completa
+    return L;
+}
+
+void init_dot_memory(IMemory& mem, int N, unsigned num_pes, const PartitionConfig& cfg) {
+    const DotLayout L = dot_layout(N, num_pes, cfg);
+    for (int i = 0; i < N; ++i) {
+        mem.store64((L.baseA + i) * 8, double(i + 1));        // A[i] = i+1
+        mem.store64((L.baseB + i) * 8, double((i + 1) * 2));  // B[i] = (i+1)*2
+    }
+    // Sumas parciales y relleno de la reduccion en arbol
+    for (unsigned p = 0; p < L.slots; ++p) mem.store64(L.slot(p) * 8, 0.0);
+    // Q apunta al siguiente par de T (en bytes): FETCH_ADD lo avanza de a uno
+    mem.store64(L.baseQ * 8, double(L.baseT * 8));
+    if (cfg.kind != Partition::Dynamic && cfg.kind != Partition::Guided) return;
+    size_t t = L.baseT;
+    for (auto [start, len] : dot_chunks(N, num_pes, cfg)) {
+        mem.store64(t++ * 8, double((L.baseA + start) * 8));  // &A[inicio] en bytes
+        mem.store64(t++ * 8, double(len));
+    }
+    for (; t < L.words; ++t) mem.store64(t * 8, 0.0);   // Pares de largo 0: no quedan chunks
+}
+
+void add_dot_segments(SharedMemory& shm, int N, unsigned num_pes, const PartitionConfig& cfg) {
+    const DotLayout L = dot_layout(N, num_pes, cfg);
+    const int P = int(num_pes);
+    for (int p = 0; p < P; ++p) {
+        if (cfg.kind == Partition::Block || cfg.kind == Partition::Line) {
+            int start, len;
+            contiguous_segment(N, P, cfg, p, start, len);
+            if (len > 0) {
+                shm.add_segment(p, uint32_t(L.baseA + start), uint32_t(len));
+                shm.add_segment(p, uint32_t(L.baseB + start), uint32_t(len));
+            }
+        }
+        shm.add_segment(p, uint32_t(L.slot(p)), uint32_t(L.strideS));
+    }
+}
+
+std::vector<uint8_t> numa_homes(const SharedMemory& shm, unsigned num_pes, const NumaConfig& cfg) {
+    std::vector<uint8_t> homes(shm.size_blocks());
+    for (uint32_t b = 0; b < homes.size(); ++b) {
+        int owner = -1;
+        if (cfg.placement == NumaPlacement::Local)
+            for (uint32_t w = 0; w < kLineWords && owner < 0; ++w)
+                owner = shm.owner_segment(uint32_t((b * kLineWords + w) * 8));
+        if (cfg.placement == NumaPlacement::Node0) homes[b] = 0;
+        else if (owner >= 0) homes[b] = uint8_t(node_of_pe(owner, num_pes, cfg.nodes));
+        else homes[b] = uint8_t(b % cfg.nodes);
+    }
+    return homes;
+}
+
+void load_dot_program(const std::vector<std::unique_ptr<PE>>& pes, const ProgramPtr& prog,
+                      int N, const PartitionConfig& cfg) {
+    if (!prog) return;
+    const bool vec = uses_vector_ops(prog->code(), prog->size());
+    const int P = int(pes.size());
+    const DotLayout L = dot_layout(N, P, cfg);
+
+    for (int p = 0; p < P; ++p) {
+        PE& pe = *pes[p];
+        pe.load_program(prog);
+        switch (cfg.kind) {
+            case Partition::Cyclic: {
+                const int first = std::min(p, N);
+                pe.set_reg_int(0, int64_t((L.baseA + first) * 8)); // &A[p]
+                pe.set_reg_int(1, int64_t((L.baseB + first) * 8)); // &B[p]
+                pe.set_reg_int(3, p < N ? (N - p + P - 1) / P : 0); // elementos del PE
+                pe.set_reg_int(7, P * 8);                         // paso en bytes
+                break;
+            }
+            case Partition::Dynamic:
+            case Partition::Guided:
+                pe.set_reg_int(0, int64_t(L.baseQ * 8));          // &Q
+                pe.set_reg_int(1, int64_t((L.baseB - L.baseA) * 8)); // &B[i] - &A[i]
+                pe.set_reg_int(7, 16);                            // Bytes por par de T
+                break;
+            default: {
+                int start, len;
+                contiguous_segment(N, P, cfg, p, start, len);
+                pe.set_reg_int(0, int64_t((L.baseA + start) * 8)); // &A[start] bytes
+                pe.set_reg_int(1, int64_t((L.baseB + start) * 8)); // &B[start] bytes
+                if (vec) {
+                    pe.set_reg_int(3, len / kVecLanes);           // iteraciones vectoriales
+                    pe.set_reg_int(7, len % kVecLanes);           // elementos sobrantes
+                } else {
+                    pe.set_reg_int(3, len);                       // longitud tramo
+                }
+                break;
+            }
+        }
+        pe.set_reg_int(2, int64_t(L.slot(p) * 8));                // &S[p] bytes
+        pe.set_reg_int(4, int64_t(L.strideS * 8));                // &S[p+1] - &S[p] (arbol)
+        pe.set_reg_int(5, p | L.slots);                           // ID + centinela (arbol)
+        pe.set_reg_int(6, int64_t(L.baseS * 8));                  // &S[0] (acumulador comun)
+        pe.set_reg_double(4, 0.0);                                // acumulador
+    }
+}
+
+Imbalance load_imbalance(const std::vector<std::unique_ptr<PE>>& pes) {
+    Imbalance r;
+    if (pes.empty()) return r;
+    uint64_t total = 0;
+    r.min = UINT64_MAX;
+    for (size_t p = 0; p < pes.size(); ++p) {
+        const uint64_t n = pes[p]->stats.instrs;
+        total += n;
+        if (n > r.max || r.slowest < 0) { r.max = n; r.slowest = int(p); }
+        r.min = std::min(r.min, n);
+    }
+    r.mean = double(total) / double(pes.size());
+    return r;
+}
+
+void print_imbalance(std::ostream& os, const std::vector<std::unique_ptr<PE>>& pes) {
+    const Imbalance r = load_imbalance(pes);
+    // Formato aparte: no se filtra la precision al stream del llamador
+    std::ostringstream f;
+    f << std::fixed << std::setprecision(1) << r.mean << " max/media=" << std::setprecision(2) << r.ratio();
+    os << "Desbalance (instrucciones por PE): min=" << r.min << " max=" << r.max
+       << " (PE" << r.slowest << ") media=" << f.str() << "\n";
+}
+
+size_t false_shared_lines(const DotLayout& L, unsigned num_pes, const PartitionConfig& cfg) {
+    // Linea -> palabra escrita -> PEs que la escriben
+    std::map<size_t, std::map<size_t, std::set<unsigned>>> writes;
+    for (unsigned p = 0; p < num_pes; ++p) {
+        writes[L.slot(p) / kLineWords][L.slot(p)].insert(p);
+        if (cfg.kind == Partition::Dynamic || cfg.kind == Partition::Guided)
+            writes[L.baseQ / kLineWords][L.baseQ].insert(p);
+    }
+    size_t shared = 0;
+    for (const auto& [line, words] : writes) {
+        // False sharing: dos palabras distintas de la linea con escritores distintos
+        std::set<unsigned> writers;
+        for (const auto& [w, pes] : words) writers.insert(pes.begin(), pes.end());
+        if (words.size() > 1 && writers.size() > 1) ++shared;
+    }
+    return shared;
+}
+
+void print_layout(std::ostream& os, int N, unsigned num_pes, const PartitionConfig& cfg) {
+    const DotLayout L = dot_layout(N, num_pes, cfg);
+    os << "Layout " << layout_name(cfg.layout) << " (bytes): A@" << L.baseA * 8 << " B@" << L.baseB * 8
+       << " S@" << L.baseS * 8 << " (paso " << L.strideS * 8 << ") Q@" << L.baseQ * 8
+       << " T@" << L.baseT * 8 << ", " << L.words * 8 << " bytes; lineas con false sharing: "
+       << false_shared_lines(L, num_pes, cfg) << "\n";
+}
+
+const char* dot_region(const DotLayout& L, uint64_t byte_addr) {
+    const uint64_t w = byte_addr / 8;
+    if (w >= L.baseT && w < L.words) return "T";
+    if (w >= L.baseQ && w < L.baseT) return "Q";
+    if (w >= L.baseS && w < L.baseQ) return "S";
+    if (w >= L.baseB && w < L.baseS) return "B";
+    if (w >= L.baseA && w < L.baseB) return "A";
+    return "-";
+}
@@ -0,0 +1,93 @@
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+#include "cache.hpp"
+#include "numa.hpp"
+#include "pe.h"
+#include "program_image.h"
+#include "shared_memory.h"
+
+// REPARTO DEL PRODUCTO PUNTO ENTRE PEs - cada estrategia fija que registros
+// recibe cada PE y tiene su kernel en ensamblador:
+//   block   tramos contiguos balanceados con resto        dotprod.asm
+//   cyclic  elemento i al PE i % P (paso P*8 en R7)         dotprod_cyclic.asm
+//   line    tramos contiguos con bordes en linea de cache  dotprod.asm
+//   dynamic chunks de 'chunk' elementos tomados con FETCH_ADD de un contador
+//   guided  como dynamic, chunks de ceil(restante/P) (minimo 'chunk')
+// dynamic y guided usan dotprod_dynamic.asm: Q apunta al siguiente par
+// (&A[inicio], largo) de una tabla T que arma el frontend; despues del ultimo
+// chunk hay P pares de largo 0 para los PEs que piden de mas
+enum class Partition : uint8_t { Block, Cyclic, Line, Dynamic, Guided };
+
+// LAYOUT DE MEMORIA
+//   packed  todo contiguo: las S[p] de 4 PEs comparten una linea (false sharing)
+//   padded  A, B, S, Q y T empiezan en linea; cada S[p] y Q ocupan una linea
+enum class Layout : uint8_t { Packed, Padded };
+
+struct PartitionConfig {
+    Partition kind = Partition::Block;
+    int chunk = 4;  // dynamic: elementos por chunk; guided: chunk minimo
+    Layout layout = Layout::Padded;
+};
+
+// "block", "cyclic", "line", "dynamic[:chunk]", "guided[:chunk]"
+bool parse_partition(const std::string& spec, PartitionConfig& out);
+const char* partition_name(Partition p);
+const char* partition_kernel(Partition p);  // Programa por defecto de la estrategia
+bool parse_layout(const std::string& spec, Layout& out);  // "packed" o "padded"
+const char* layout_name(Layout l);
+
+// LAYOUT (en doubles): A[0..N-1], B[0..N-1], S[0..P'-1], Q, T[0..2*(chunks+P)-1]
+// Los kernels no asumen la distancia entre ranuras de S: la reciben en R4
+struct DotLayout {
+    size_t baseA = 0, baseB = 0, baseS = 0, baseQ = 0, baseT = 0;
+    size_t strideS = 1;  // Doubles entre S[p] y S[p+1]
+    unsigned slots = 1;  // P redondeado a potencia de 2 (reduccion en arbol)
+    size_t words = 0;    // Total ocupado
+    size_t slot(unsigned p) const { return baseS + p * strideS; }  // S[p]
+};
+DotLayout dot_layout(int N, unsigned num_pes, const PartitionConfig& cfg);
+
+// Lineas en las que PEs distintos escriben palabras distintas (S[p] y Q):
+// false sharing que el layout deja. Q compartido por todos es true sharing
+size_t false_shared_lines(const DotLayout& L, unsigned num_pes, const PartitionConfig& cfg);
+void print_layout(std::ostream& os, int N, unsigned num_pes, const PartitionConfig& cfg);
+// Zona del layout de una direccion: "A", "B", "S", "Q", "T" o "-"
+const char* dot_region(const DotLayout& L, uint64_t byte_addr);
+
+// Chunks (inicio, largo) en el orden en que se reparten (dynamic/guided)
+std::vector<std::pair<int,int>> dot_chunks(int N, unsigned num_pes, const PartitionConfig& cfg);
+
+// A[i] = i+1, B[i] = 2(i+1), S en cero, contador y tabla de chunks
+void init_dot_memory(IMemory& mem, int N, unsigned num_pes, const PartitionConfig& cfg);
+
+// Segmentos de SharedMemory por PE (owner_segment): su tramo de A y B en
+// block/line y su ranura de S. Q y T no tienen dueno
+void add_dot_segments(SharedMemory& shm, int N, unsigned num_pes, const PartitionConfig& cfg);
+
+// UBICACION NUMA - nodo hogar de cada bloque de shm segun cfg.placement. local
+// usa los segmentos de add_dot_segments (dueno de la primera palabra con
+// dueno del bloque, en su nodo); los bloques sin dueno se intercalan
+std::vector<uint8_t> numa_homes(const SharedMemory& shm, unsigned num_pes, const NumaConfig& cfg);
+
+// Carga el programa compartido y los registros de cada PE
+void load_dot_program(const std::vector<std::unique_ptr<PE>>& pes, const ProgramPtr& prog,
+                      int N, const PartitionConfig& cfg);
+
+// DESBALANCE DE CARGA - sobre las instrucciones ejecutadas por cada PE (el
+// kernel hace el mismo trabajo por elemento: mide cuanto reparto recibio)
+struct Imbalance {
+    uint64_t max = 0, min = 0;
+    double mean = 0.0;
+    int slowest = -1;  // PE con mas instrucciones
+    double ratio() const { return mean > 0 ? double(max) / mean : 1.0; } // 1.0 = perfecto
+};
+Imbalance load_imbalance(const std::vector<std::unique_ptr<PE>>& pes);
+void print_imbalance(std::ostream& os, const std::vector<std::unique_ptr<PE>>& pes);
+
+#endif
@@ -7,19 +7,66 @@
 #include <mutex>
 #include <memory>
 #include <iomanip>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+
+// SIMD del host: AVX2+FMA si el compilador lo habilita (ver SIMD_FLAGS en el
+// Makefile); si no, bucle escalar con el mismo redondeo (std::fma)
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define PE_USE_AVX2 1
+#endif
 
 extern std::mutex io_mtx;
 
+static_assert(kVecLanes * sizeof(double) == hw::kBlockBytes, "Un vector ocupa una linea de cache");
+
 PE::PE(int id, Cache* cache) : id_(id), cache_(cache), pc(0), halt_flag(false) {
-    for (int i = 0; i < 8; ++i) regs_raw[i] = 0.0;
+    std::fill(iregs, iregs + kIntRegs, 0);
+    std::fill(fregs, fregs + kFpRegs, 0.0);
+    for (auto& v : vregs) std::fill(v.lane, v.lane + kVecLanes, 0.0);
 }
 
-void PE::load_program(const std::vector<Instr>& prog,
-                      const std::unordered_map<std::string,size_t>& labels) {
-    program = prog;
-    label_map = labels;
+void PE::load_program(ProgramPtr prog) {
+    program_ = std::move(prog);
+    code_ = program_ ? program_->code() : nullptr;
+    code_size_ = program_ ? int(program_->size()) : 0;
     pc = 0;
     halt_flag = false;
+    barrier_wait_ = false;
+}
+
+void PE::save_state(State& s) const {
+    s.pc = pc;
+    s.halt = halt_flag;
+    s.barrier_wait = barrier_wait_;
+    s.barrier_gen = barrier_gen_;
+    std::memcpy(s.iregs, iregs, sizeof(iregs));
+    std::memcpy(s.fregs, fregs, sizeof(fregs));
+    std::memcpy(s.pending, pending_, sizeof(pending_));
+    s.pending_mask = pending_mask_;
+    std::memcpy(s.vregs, vregs, sizeof(vregs));
+    s.sb = sb_;
+    s.sb_head = sb_head_;
+    s.sb_count = sb_count_;
+    s.st = stats;
+}
+
+void PE::restore_state(const State& s) {
+    pc = s.pc;
+    halt_flag = s.halt;
+    barrier_wait_ = s.barrier_wait;
+    barrier_gen_ = s.barrier_gen;
+    std::memcpy(iregs, s.iregs, sizeof(iregs));
+    std::memcpy(fregs, s.fregs, sizeof(fregs));
+    std::memcpy(pending_, s.pending, sizeof(pending_));
+    pending_mask_ = s.pending_mask;
+    std::memcpy(vregs, s.vregs, sizeof(vregs));
+    sb_ = s.sb;
+    sb_head_ = s.sb_head;
+    sb_count_ = s.sb_count;
+    stats = s.st;
 }
 
 void PE::run() {
@@ -28,8 +75,9 @@ void PE::run() {
         std::cout << "[PE" << id_ << "] run() START\n";
     }
     int steps = 0;
-    while (!halt_flag && pc < (int)program.size()) {
+    while (!halt_flag) {  // El fin del codigo tambien pasa por step(): halt() deja la barrera
         step();
+        if (barrier_wait_) { std::this_thread::yield(); continue; } // Otros PEs van atras
         if (++steps % 100000 == 0) {
             std::lock_guard<std::mutex> lk(io_mtx);
             std::cout << "[PE" << id_ << "] still running, pc=" << pc << " steps=" << steps << "\n";
@@ -42,7 +90,17 @@ void PE::run() {
 }
 
 void PE::step() {
-    Instr I = program[pc];
+    if (pc >= code_size_) { if (!halt_flag) halt(); return; } // Sin programa o fin del codigo
+    if (barrier_wait_) {
+        // Detenido en BARRIER: el paso en que se abre solo avanza el PC
+        if (!barrier_->passed(barrier_gen_)) { stats.barrier_stalls++; return; }
+        barrier_wait_ = false;
+        pc++;
+        return;
+    }
+    const Instr& I = code_[pc];
+    stats.instrs++;
+    if (pending_mask_) wait_operands(I);
     switch (I.op) {
         case OpCode::LOAD:  exec_load(I); break;
         case OpCode::STORE: exec_store(I); break;
@@ -50,38 +108,206 @@ void PE::step() {
         case OpCode::FADD:  exec_fadd(I); break;
         case OpCode::INC:   exec_inc(I); break;
         case OpCode::DEC:   exec_dec(I); break;
+        case OpCode::ADDI:  exec_addi(I); break;
+        case OpCode::ADD:   iregs[I.rd] = iregs[I.ra] + iregs[I.rb]; break;
+        case OpCode::ANDI:  iregs[I.rd] = iregs[I.ra] & I.imm; break;
+        case OpCode::SHRI:  iregs[I.rd] = int64_t(uint64_t(iregs[I.ra]) >> I.imm); break;
+        case OpCode::SHLI:  iregs[I.rd] = int64_t(uint64_t(iregs[I.ra]) << I.imm); break;
+        case OpCode::FZERO: fregs[I.rd] = 0.0; break;
         case OpCode::JNZ:   exec_jnz(I); break;
-        case OpCode::HALT:  halt_flag = true; break;
+        case OpCode::JZ:    exec_jz(I); break;
+        case OpCode::HALT:  halt(); break;
+        case OpCode::FENCE: sb_drain(); break;
+        case OpCode::BARRIER: exec_barrier(); if (barrier_wait_) return; break;
+        case OpCode::FETCH_ADD:
+        case OpCode::CAS:
+        case OpCode::LL:
+        case OpCode::SC:      exec_atomic(I); break;
+        case OpCode::VLOAD:   exec_vload(I); break;
+        case OpCode::VSTORE:  exec_vstore(I); break;
+        case OpCode::VFMUL:
+        case OpCode::VFADD:
+        case OpCode::VFMA:    exec_varith(I); break;
+        case OpCode::VREDUCE: exec_vreduce(I); break;
+        case OpCode::VZERO:   std::fill(vregs[I.rd].lane, vregs[I.rd].lane + kVecLanes, 0.0); break;
         default: break;
     }
+    // El puerto de cache queda libre en instrucciones sin acceso a memoria:
+    // ahi se retira el store mas viejo
+    if (sb_count_ && I.op != OpCode::LOAD && I.op != OpCode::STORE &&
+        I.op != OpCode::VLOAD && I.op != OpCode::VSTORE && !is_atomic_op(I.op)) sb_retire();
     pc++;
 }
 
+uint64_t PE::mem_address(const Instr& I) const {
+    int64_t a = I.addr_is_reg ? iregs[I.ra] : int64_t(I.address);
+    a += I.imm;
+    if (I.ri >= 0) a += iregs[I.ri] * I.scale;
+    return static_cast<uint64_t>(a);
+}
+
 void PE::exec_load(const Instr& I) {
-    uint64_t addr = I.addr_is_reg ? static_cast<uint64_t>(get_reg_int(I.ra)) : static_cast<uint64_t>(I.address);
+    uint64_t addr = mem_address(I);
     if (addr % DOUBLE_BYTES != 0) {
         std::lock_guard<std::mutex> lk(io_mtx);
         std::cerr << "[WARN][PE" << id_ << "] access not 8B-aligned addr=" << addr 
                 << " (instr pc=" << pc << " rd=R" << I.rd << ")\n";
     }
-    double v = cache_->read_double(addr);
-    set_reg_double(I.rd, v);
     stats.loads++;
+    // Un store propio aun en el buffer es el valor mas reciente
+    double fwd;
+    if (sb_count_ && sb_forward(addr, fwd)) {
+        stats.sb_forwards++;
+        if (I.fp) fregs[I.rd] = fwd;
+        else iregs[I.rd] = static_cast<int64_t>(fwd);
+        return;
+    }
+    // Entero: la memoria guarda doubles, se convierte al llegar (bloqueante)
+    if (!I.fp) {
+        iregs[I.rd] = static_cast<int64_t>(cache_->read_double(addr, pc));
+        return;
+    }
+    // No bloqueante: en fallo el PE sigue y solo se detiene al usar rd
+    MshrRef ref = cache_->read_double_nb(addr, &fregs[I.rd], pc);
+    if (ref.pending()) {
+        pending_[I.rd] = ref;
+        pending_mask_ |= uint16_t(1u << I.rd);
+    }
+}
+
+void PE::wait_reg(int r) {
+    if (!(pending_mask_ & (1u << r))) return;
+    if (cache_->wait_fill(pending_[r])) stats.load_use_stalls++;
+    pending_mask_ &= uint16_t(~(1u << r));
+}
+
+void PE::wait_operands(const Instr& I) {
+    switch (I.op) {
+        // Solo el banco F tiene LOADs en vuelo: los registros de direccion
+        // y contadores (banco R) nunca esperan
+        case OpCode::LOAD:   // rd tambien: un llenado viejo no debe pisar el nuevo
+        case OpCode::STORE:
+            if (I.fp) wait_reg(I.rd);
+            break;
+        case OpCode::FMUL:
+        case OpCode::FADD:
+            wait_reg(I.rd); wait_reg(I.ra); wait_reg(I.rb);
+            break;
+        case OpCode::VREDUCE:
+        case OpCode::FZERO:
+            wait_reg(I.rd);
+            break;
+        case OpCode::FETCH_ADD:
+        case OpCode::CAS:
+        case OpCode::LL:
+        case OpCode::SC:
+            if (!I.fp) break;
+            if (I.op == OpCode::FETCH_ADD || I.op == OpCode::LL) wait_reg(I.rd);
+            if (I.op != OpCode::LL) wait_reg(I.rb);
+            if (I.op == OpCode::CAS) wait_reg(I.rc);
+            break;
+        default: break;
+    }
 }
 
 void PE::exec_store(const Instr& I) {
-    uint64_t addr = I.addr_is_reg ? static_cast<uint64_t>(get_reg_int(I.ra)) : static_cast<uint64_t>(I.address);
-    double val = get_reg_double(I.rd);
+    uint64_t addr = mem_address(I);
+    double val = I.fp ? fregs[I.rd] : static_cast<double>(iregs[I.rd]);
     if (addr % DOUBLE_BYTES != 0) {
         std::lock_guard<std::mutex> lk(io_mtx);
         std::cerr << "[WARN][PE" << id_ << "] access not 8B-aligned addr=" << addr 
                 << " (instr pc=" << pc << " rd=R" << I.rd << ")\n";
     }
 
-    cache_->write_double(addr, val);
+    sb_push(addr, &val, 1, pc);
     stats.stores++;
 }
 
+// HALT: completa los llenados en vuelo, tambien los prefetches que ningun
+// registro espera, para no dejar MSHRs ocupados al terminar
+void PE::halt() {
+    cache_->drain_mshrs();
+    pending_mask_ = 0;
+    sb_drain();
+    halt_flag = true;
+    if (barrier_) barrier_->drop();
+}
+
+// BARRIER: los stores propios quedan visibles antes de llegar. Si la ronda no
+// se cierra con esta llegada, el PC no avanza hasta que otro PE la cierre
+void PE::exec_barrier() {
+    sb_drain();
+    if (!barrier_) return;
+    barrier_gen_ = barrier_->arrive();
+    barrier_wait_ = !barrier_->passed(barrier_gen_);
+}
+
+// Atomicas: ordenan como FENCE (el store buffer se vacia antes) y son
+// bloqueantes; la cache hace la lectura-modificacion-escritura
+void PE::exec_atomic(const Instr& I) {
+    sb_drain();
+    const uint64_t addr = mem_address(I);
+    auto data = [&](int r) { return I.fp ? fregs[r] : static_cast<double>(iregs[r]); };
+    auto set_data = [&](int r, double v) {
+        if (I.fp) fregs[r] = v;
+        else iregs[r] = static_cast<int64_t>(v);
+    };
+    switch (I.op) {
+        case OpCode::FETCH_ADD: set_data(I.rd, cache_->fetch_add(addr, data(I.rb), pc)); break;
+        case OpCode::CAS: iregs[I.rd] = cache_->compare_swap(addr, data(I.rb), data(I.rc), pc); break;
+        case OpCode::LL:  set_data(I.rd, cache_->load_linked(addr, pc)); break;
+        case OpCode::SC:  iregs[I.rd] = cache_->store_conditional(addr, data(I.rb), pc); break;
+        default: break;
+    }
+}
+
+void PE::sb_push(uint64_t addr, const double* v, uint32_t n, int at_pc) {
+    if (sb_count_ == kSbEntries) {
+        stats.sb_full_stalls++;
+        sb_retire();
+    }
+    SbEntry& e = sb_[(sb_head_ + sb_count_) % kSbEntries];
+    e.addr = addr;
+    e.n = n;
+    e.pc = at_pc;
+    std::copy(v, v + n, e.val);
+    sb_count_++;
+}
+
+void PE::sb_retire() {
+    const SbEntry& e = sb_[sb_head_];
+    cache_->write_line(e.addr, e.val, e.n, e.pc);
+    sb_head_ = (sb_head_ + 1) % kSbEntries;
+    sb_count_--;
+}
+
+void PE::sb_drain() {
+    while (sb_count_) sb_retire();
+}
+
+bool PE::sb_forward(uint64_t addr, double& out) const {
+    for (int k = sb_count_ - 1; k >= 0; --k) {
+        const SbEntry& e = sb_[(sb_head_ + k) % kSbEntries];
+        if (addr >= e.addr && addr < e.addr + e.n * DOUBLE_BYTES) {
+            out = e.val[(addr - e.addr) / DOUBLE_BYTES];
+            return true;
+        }
+    }
+    return false;
+}
+
+void PE::sb_overlay(uint64_t addr, double* out, uint32_t n) const {
+    // De la mas vieja a la mas nueva: gana el ultimo store a cada double
+    uint64_t end = addr + n * DOUBLE_BYTES;
+    for (int k = 0; k < sb_count_; ++k) {
+        const SbEntry& e = sb_[(sb_head_ + k) % kSbEntries];
+        for (uint32_t j = 0; j < e.n; ++j) {
+            uint64_t a = e.addr + j * DOUBLE_BYTES;
+            if (a >= addr && a < end) out[(a - addr) / DOUBLE_BYTES] = e.val[j];
+        }
+    }
+}
+
 void PE::exec_fmul(const Instr& I) {
     set_reg_double(I.rd, get_reg_double(I.ra) * get_reg_double(I.rb));
 }
@@ -91,40 +317,112 @@ void PE::exec_fadd(const Instr& I) {
 }
 
 void PE::exec_inc(const Instr& I) {
-    set_reg_int(I.rd, get_reg_int(I.rd) + DOUBLE_BYTES);
+    iregs[I.rd] += int64_t(I.count) * DOUBLE_BYTES;
 }
 
 void PE::exec_dec(const Instr& I) { 
-    set_reg_int(I.rd, get_reg_int(I.rd) - 1); 
+    iregs[I.rd] -= 1;
+}
+
+void PE::exec_addi(const Instr& I) {
+    iregs[I.rd] += I.imm;
 }
 
 void PE::exec_jnz(const Instr& I) {
-    if (get_reg_int(I.rd) != 0) {
-        auto it = label_map.find(I.label);
-        if (it != label_map.end()) pc = int(it->second) - 1;
+    if (iregs[I.rd] != 0 && I.target >= 0) pc = I.target - 1;
+}
+
+void PE::exec_jz(const Instr& I) {
+    if (iregs[I.rd] == 0 && I.target >= 0) pc = I.target - 1;
+}
+
+// VLOAD/VSTORE: un acceso a cache por bloque tocado. Con el vector alineado
+// a 32 bytes es una sola linea; si no, se parte en el limite de bloque
+void PE::exec_vload(const Instr& I) {
+    uint64_t addr = mem_address(I);
+    for (uint32_t done = 0; done < uint32_t(kVecLanes); ) {
+        uint64_t a = addr + done * DOUBLE_BYTES;
+        uint32_t room = uint32_t((hw::kBlockBytes - a % hw::kBlockBytes) / DOUBLE_BYTES);
+        uint32_t n = std::min<uint32_t>(room, kVecLanes - done);
+        cache_->read_line(a, vregs[I.rd].lane + done, n, pc);
+        if (sb_count_) sb_overlay(a, vregs[I.rd].lane + done, n);
+        done += n;
+    }
+    stats.loads++;
+}
+
+void PE::exec_vstore(const Instr& I) {
+    uint64_t addr = mem_address(I);
+    for (uint32_t done = 0; done < uint32_t(kVecLanes); ) {
+        uint64_t a = addr + done * DOUBLE_BYTES;
+        uint32_t room = uint32_t((hw::kBlockBytes - a % hw::kBlockBytes) / DOUBLE_BYTES);
+        uint32_t n = std::min<uint32_t>(room, kVecLanes - done);
+        sb_push(a, vregs[I.rd].lane + done, n, pc);
+        done += n;
     }
+    stats.stores++;
+}
+
+void PE::exec_varith(const Instr& I) {
+    const double* a = vregs[I.ra].lane;
+    const double* b = vregs[I.rb].lane;
+    double* d = vregs[I.rd].lane;
+#ifdef PE_USE_AVX2
+    __m256d va = _mm256_load_pd(a);
+    __m256d vb = _mm256_load_pd(b);
+    __m256d r;
+    if (I.op == OpCode::VFMUL)      r = _mm256_mul_pd(va, vb);
+    else if (I.op == OpCode::VFADD) r = _mm256_add_pd(va, vb);
+    else                            r = _mm256_fmadd_pd(va, vb, _mm256_load_pd(d));
+    _mm256_store_pd(d, r);
+#else
+    for (int l = 0; l < kVecLanes; ++l) {
+        if (I.op == OpCode::VFMUL)      d[l] = a[l] * b[l];
+        else if (I.op == OpCode::VFADD) d[l] = a[l] + b[l];
+        else                            d[l] = std::fma(a[l], b[l], d[l]);
+    }
+#endif
+}
+
+void PE::exec_vreduce(const Instr& I) {
+    // Orden fijo por parejas: mismo resultado con y sin AVX2
+    const double* a = vregs[I.ra].lane;
+    set_reg_double(I.rd, (a[0] + a[1]) + (a[2] + a[3]));
 }
 
 void PE::dump_regs(std::ostream& os) const {
     std::lock_guard<std::mutex> lk(io_mtx);
-    os << "[PE" << id_ << "] PC=" << pc << " HALT=" << halt_flag << "\n";
-    for (int i = 0; i < 8; ++i) {
-        os << "  R" << i << " = " << get_reg_double(i) << "\n";
+    os << "[PE" << id_ << "] PC=" << pc << " HALT=" << halt_flag
+       << (barrier_wait_ ? " (BARRIER)" : "") << "\n";
+    for (int i = 0; i < kFpRegs; ++i) {
+        os << "  ";
+        if (i < kIntRegs) os << "R" << i << " = " << iregs[i] << "\t";
+        else os << "\t";
+        os << "F" << i << " = " << fregs[i] << "\n";
+    }
+    for (int v = 0; v < kVecRegs; ++v) {
+        os << "  V" << v << " = [";
+        for (int l = 0; l < kVecLanes; ++l) os << (l ? ", " : "") << vregs[v].lane[l];
+        os << "]\n";
+    }
+    for (int k = 0; k < sb_count_; ++k) {
+        const SbEntry& e = sb_[(sb_head_ + k) % kSbEntries];
+        os << "  SB[" << k << "] addr=" << e.addr << " n=" << e.n << " val0=" << e.val[0] << "\n";
     }
 }
 
 double PE::get_reg_double(int r) const { 
-    return regs_raw[r]; 
+    return fregs[r]; 
 }
 
 void PE::set_reg_double(int r, double v) { 
-    regs_raw[r] = v; 
+    fregs[r] = v; 
 }
 
-int PE::get_reg_int(int r) const { 
-    return static_cast<int>(regs_raw[r]); 
+int64_t PE::get_reg_int(int r) const { 
+    return iregs[r]; 
 }
 
-void PE::set_reg_int(int r, int v) { 
-    regs_raw[r] = static_cast<double>(v); 
+void PE::set_reg_int(int r, int64_t v) { 
+    iregs[r] = v; 
 }
\ No newline at end of file
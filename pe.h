@@ -2,7 +2,10 @@
 #define PE_H
 
 #include "cache.hpp"
+#include "barrier.h"
 #include "instr.h"
+#include "program_image.h"
+#include <array>
 #include <vector>
 #include <unordered_map>
 #include <iostream>
@@ -13,8 +16,7 @@ public:
     PE(int id, Cache* cache);
     
     // Gestion de programa
-    void load_program(const std::vector<Instr>& prog,
-                      const std::unordered_map<std::string,size_t>& labels);
+    void load_program(ProgramPtr prog); // Compartido: no se copia
     
     // Ejecucion
     void run();     // Ejecutar hasta HALT
@@ -22,27 +24,41 @@ public:
     
     // Estado
     int get_pc() const { return pc; }
+    int program_size() const { return code_size_; }
     bool is_halted() const { return halt_flag; }
+    bool at_barrier() const { return barrier_wait_; } // Esperando en BARRIER
     void dump_regs(std::ostream& os = std::cout) const;
     
-    // Registros
+    // Registros: banco F (doubles) y banco R (enteros de 64 bits)
     double get_reg_double(int r) const;
     void set_reg_double(int r, double v);
-    int get_reg_int(int r) const;
-    void set_reg_int(int r, int v);
+    int64_t get_reg_int(int r) const;
+    void set_reg_int(int r, int64_t v);
+    const double* get_vreg(int v) const { return vregs[v].lane; } // kVecLanes doubles
+    int store_buffer_size() const { return sb_count_; }       // Stores aun no retirados
     
     // Identificacion
     int pe_id() const { return id_; }
+
+    // Barrera del sistema (compartida); sin ella BARRIER solo vacia el store buffer
+    void set_barrier(Barrier* b) { barrier_ = b; }
     
     // Control de ejecucion
     void set_pc(int new_pc) { pc = new_pc; halt_flag = false; }
 
     // Estadisticas simples del PE
     struct {
-        uint64_t loads = 0;   // Conteo de instrucciones LOAD
-        uint64_t stores = 0;  // Conteo de instrucciones STORE
+        uint64_t instrs = 0;  // Instrucciones ejecutadas (conteo dinamico)
+        uint64_t loads = 0;   // Conteo de instrucciones LOAD/VLOAD
+        uint64_t stores = 0;  // Conteo de instrucciones STORE/VSTORE
+        uint64_t load_use_stalls = 0; // Usos de un registro cuyo LOAD seguia en vuelo
+        uint64_t sb_full_stalls = 0;  // STOREs que esperaron por store buffer lleno
+        uint64_t sb_forwards = 0;     // LOADs servidos desde el store buffer
+        uint64_t barrier_stalls = 0;  // Pasos detenido en BARRIER
     } stats;
 
+    static constexpr int kSbEntries = 8; // Capacidad del store buffer
+
 private:
     // Ejecucion de instrucciones
     void exec_load(const Instr& I);
@@ -51,18 +67,75 @@ private:
     void exec_fadd(const Instr& I);
     void exec_inc(const Instr& I);
     void exec_dec(const Instr& I);
+    void exec_addi(const Instr& I);
     void exec_jnz(const Instr& I);
+    void exec_jz(const Instr& I);
+    void exec_barrier();
+    void exec_atomic(const Instr& I);     // FETCH_ADD, CAS, LL, SC
+    void halt();                          // HALT o fin del codigo: deja la barrera
+    void exec_vload(const Instr& I);
+    void exec_vstore(const Instr& I);
+    void exec_varith(const Instr& I);  // VFMUL, VFADD, VFMA
+    void exec_vreduce(const Instr& I);
+    uint64_t mem_address(const Instr& I) const;
+    void wait_reg(int r);                 // Espera el LOAD en vuelo de Fr (si hay)
+    void wait_operands(const Instr& I);   // Registros que I lee o escribe
+
+    // STORE BUFFER (FIFO, TSO): los stores se retiran a la cache en orden,
+    // uno por paso cuando la instruccion no usa el puerto de cache
+    void sb_push(uint64_t addr, const double* v, uint32_t n, int at_pc);
+    void sb_retire();                     // Escribe en cache la entrada mas vieja
+    void sb_drain();                      // HALT/FENCE: vacia el buffer
+    bool sb_forward(uint64_t addr, double& out) const;         // Mas nueva primero
+    void sb_overlay(uint64_t addr, double* out, uint32_t n) const; // Para VLOAD
 
     // Datos miembros
     int id_;           // ID unico del PE
     Cache* cache_;     // Cache L1 privada
     int pc;            // Contador de programa
     bool halt_flag;    // Bandera de detencion
-    double regs_raw[8]; // 8 registros de proposito general (como doubles)
-    std::vector<Instr> program; // Programa cargado
-    std::unordered_map<std::string,size_t> label_map; // Mapa de etiquetas
+    Barrier* barrier_ = nullptr;
+    bool barrier_wait_ = false;  // Llego a BARRIER y la ronda sigue abierta
+    uint32_t barrier_gen_ = 0;
+    int64_t iregs[kIntRegs]; // R0-R7: contadores y direcciones
+    double fregs[kFpRegs];   // F0-F15: datos de punto flotante
+    MshrRef pending_[kFpRegs]; // LOAD en vuelo por registro F (scoreboard)
+    uint16_t pending_mask_ = 0;
+    struct alignas(32) VecReg { double lane[kVecLanes]; };
+    VecReg vregs[kVecRegs]; // Registros vectoriales (una linea de cache cada uno)
+    struct SbEntry {
+        uint64_t addr;           // Primer double (n doubles dentro de un bloque)
+        uint32_t n;
+        int pc;                  // Instruccion de origen (para el prefetcher)
+        double val[kVecLanes];
+    };
+    std::array<SbEntry, kSbEntries> sb_;
+    int sb_head_ = 0;            // Entrada mas vieja
+    int sb_count_ = 0;
+    ProgramPtr program_;        // Programa compartido con los demas PEs
+    const Instr* code_ = nullptr; // program_->code(), sin indireccion por paso
+    int code_size_ = 0;
     
     static constexpr int DOUBLE_BYTES = 8; // Tamano de double en bytes
+
+public:
+    // ESTADO COMPLETO - lo copian el historial de deshacer y sus checkpoints
+    // (undo.hpp) con el PE detenido. Trivialmente copiable: se compara por palabras
+    struct State {
+        int pc;
+        bool halt, barrier_wait;
+        uint32_t barrier_gen;
+        int64_t iregs[kIntRegs];
+        double fregs[kFpRegs];
+        MshrRef pending[kFpRegs];
+        uint16_t pending_mask;
+        VecReg vregs[kVecRegs];
+        std::array<SbEntry, kSbEntries> sb;
+        int sb_head, sb_count;
+        decltype(stats) st;
+    };
+    void save_state(State& s) const;
+    void restore_state(const State& s);
 };
 
 #endif
\ No newline at end of file
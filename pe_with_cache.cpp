@@ -8,10 +8,17 @@
 #include <mutex>
 #include <memory>
 #include <iomanip>
+#include <optional>
 
 #include "pe.h"
 #include "cache.hpp"
+#include "l2_cache.hpp"
+#include "numa.hpp"
 #include "parser.h"   
+#include "program_image.h"
+#include "optimizer.h"
+#include "partition.h"
+#include "report.h"
 #include "instr.h"    
 #include "shared_memory.h"
 #include "shared_memory_adapter.h"
@@ -186,66 +193,109 @@ int main(int argc, char** argv) {
     // -------- parametros --------
     int N = 8;                  // por defecto
     constexpr int P = 4;        // SIEMPRE 4 PEs
+    // -O<n> (en cualquier lugar): optimizar el programa desenrollando x n
+    int unroll = 0;
+    // -part=<estrategia>[:chunk] (en cualquier lugar): reparto de N entre PEs
+    // -layout=packed|padded: S[p] contiguas o una por linea (por defecto padded)
+    PartitionConfig part;
+    // -l2=inclusive|noninclusive[:lineas[:vias[:bancos]]]: L2 compartida bajo las L1
+    std::optional<L2Config> l2cfg;
+    // -numa=local|interleave|node0[:nodos[:...]]: memoria NUMA (sin -l2)
+    std::optional<NumaConfig> numacfg;
+    std::vector<char*> args{argv[0]};
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a.rfind("-O", 0) == 0) unroll = argv[i][2] ? std::atoi(argv[i] + 2) : 4;
+        else if (a.rfind("-part=", 0) == 0) {
+            if (!parse_partition(a.substr(6), part)) {
+                std::cerr << "Reparto desconocido: " << a.substr(6) << "\n";
+                return 1;
+            }
+        }
+        else if (a.rfind("-layout=", 0) == 0) {
+            if (!parse_layout(a.substr(8), part.layout)) {
+                std::cerr << "Layout desconocido: " << a.substr(8) << "\n";
+                return 1;
+            }
+        }
+        else if (a.rfind("-l2=", 0) == 0) {
+            L2Config c;
+            if (!parse_l2(a.substr(4), c)) {
+                std::cerr << "L2 invalida: " << a.substr(4) << "\n";
+                return 1;
+            }
+            l2cfg = c;
+        }
+        else if (a.rfind("-numa=", 0) == 0) {
+            NumaConfig c;
+            if (!parse_numa(a.substr(6), c)) {
+                std::cerr << "NUMA invalida: " << a.substr(6) << "\n";
+                return 1;
+            }
+            numacfg = c;
+        }
+        else args.push_back(argv[i]);
+    }
+    if (l2cfg && numacfg) {
+        std::cerr << "-l2 y -numa no se combinan\n";
+        return 1;
+    }
+    argc = int(args.size());
+    argv = args.data();
     if (argc >= 2) N = std::max(1, std::atoi(argv[1]));
-
-    // Layout: A[0..N-1], B[0..N-1], S[0..P-1]
-    const size_t baseA_words = 0;
-    const size_t baseB_words = baseA_words + static_cast<size_t>(N);
-    const size_t baseS_words = baseB_words + static_cast<size_t>(N);
-    const size_t needed_words = baseS_words + P;
+    const char* prog_path = argc >= 3 ? argv[2] : partition_kernel(part.kind);
+    // Prefetcher opcional: none | next | stride [grado] [distancia]
+    const std::string pf_kind = argc >= 4 ? argv[3] : "none";
+    PrefetchConfig pf_cfg;
+    if (argc >= 5) pf_cfg.degree = std::max(1, std::atoi(argv[4]));
+    if (argc >= 6) pf_cfg.distance = std::max(1, std::atoi(argv[5]));
+
+    // Layout: A[0..N-1], B[0..N-1], S[0..P'-1], Q, tabla de chunks (partition.h);
+    // con -layout=padded cada zona empieza en linea y S[p] va en linea propia
+    const DotLayout L = dot_layout(N, P, part);
+    const size_t baseA_words = L.baseA;
+    const size_t baseB_words = L.baseB;
+    const size_t baseS_words = L.baseS;
+    const size_t needed_words = L.words;
 
     // -------- memoria compartida + adaptador --------
     SharedMemory shm(static_cast<uint32_t>(std::max<size_t>(needed_words, hw::kMemDoubles)));
-    // Opcional: segmentar 4 regiones (no obligatorio para que funcione)
-    shm.add_segment(0, 0,                 static_cast<uint32_t>(needed_words/4 + 1));
-    shm.add_segment(1, static_cast<uint32_t>(needed_words/4 + 1), static_cast<uint32_t>(needed_words/4 + 1));
-    shm.add_segment(2, static_cast<uint32_t>(2*(needed_words/4 + 1)), static_cast<uint32_t>(needed_words/4 + 1));
-    shm.add_segment(3, static_cast<uint32_t>(3*(needed_words/4 + 1)), static_cast<uint32_t>(needed_words/4 + 1));
+    // Segmentos por PE (tramos de A/B y ranura de S): dueno en el reporte de sharing
+    add_dot_segments(shm, N, P, part);
     shm.start();
 
     SharedMemoryAdapter mem(&shm);   // <- este es el "Memory" real para la cache
     Interconnect bus;
+    std::unique_ptr<L2Cache> l2;
+    if (l2cfg) l2 = std::make_unique<L2Cache>(&mem, &bus, *l2cfg);
+    std::unique_ptr<NumaMemory> numa;  // Un puerto por PE
+    if (numacfg) numa = std::make_unique<NumaMemory>(&mem, *numacfg, numa_homes(shm, P, *numacfg), P);
+    IMemory* below = l2 ? static_cast<IMemory*>(l2.get()) : &mem;  // Memoria de las L1
 
-    // Inicializa A y B via adaptador (byte addresses)
-    for (int i = 0; i < N; ++i) {
-        mem.store64((baseA_words + i) * 8ull, double(i + 1));        // A[i]
-        mem.store64((baseB_words + i) * 8ull, double((i + 1) * 2));  // B[i]
-    }
-    // Inicializa S
-    for (int p = 0; p < P; ++p) mem.store64((baseS_words + p) * 8ull, 0.0);
+    // Inicializa A, B, S y el contador/tabla de chunks via adaptador
+    init_dot_memory(mem, N, P, part);
 
     // -------- caches y PEs --------
     std::vector<std::unique_ptr<Cache>> caches;
     std::vector<std::unique_ptr<PE>> pes;
+    Barrier barrier(P);   // BARRIER: cada PE corre en su propio hilo
     caches.reserve(P); pes.reserve(P);
     for (int i = 0; i < P; ++i) {
-        caches.emplace_back(std::make_unique<Cache>(i, &mem, &bus));
+        caches.emplace_back(std::make_unique<Cache>(i, numa ? numa->port(i) : below, &bus));
+        caches.back()->set_prefetcher(make_prefetcher(pf_kind, pf_cfg));
         pes.emplace_back(std::make_unique<PE>(i, caches.back().get()));
+        pes.back()->set_barrier(&barrier);
     }
 
     // -------- programa --------
-    std::ifstream fin("dotprod.asm");
-    if (!fin) { std::cerr << "Error: no se pudo abrir dotprod.asm\n"; return 1; }
-    std::stringstream buffer; buffer << fin.rdbuf();
-    std::vector<Instr> prog; std::unordered_map<std::string,size_t> labels;
-    parse_asm(buffer.str(), prog, labels);
-
-    // -------- reparto balanceado con resto --------
-    const int base_len = N / P;
-    const int rest = N % P;
-    auto start_index_of = [&](int pe) { return pe * base_len + std::min(pe, rest); };
-    auto len_of         = [&](int pe) { return base_len + (pe < rest ? 1 : 0); };
-
-    for (int p = 0; p < P; ++p) {
-        const int start = start_index_of(p);
-        const int len   = len_of(p);
-        pes[p]->load_program(prog, labels);
-        pes[p]->set_reg_int(0, int((baseA_words + start) * 8)); // &A[start] bytes
-        pes[p]->set_reg_int(1, int((baseB_words + start) * 8)); // &B[start] bytes
-        pes[p]->set_reg_int(2, int((baseS_words + p) * 8));     // &S[p] bytes
-        pes[p]->set_reg_int(3, len);                            // longitud tramo
-        pes[p]->set_reg_double(4, 0.0);                         // acumulador
+    ProgramPtr prog = load_shared_program(prog_path); // ASM o imagen .pimg
+    if (!prog) { shm.stop(); return 1; }
+    if (unroll > 1) {
+        OptReport rep;
+        prog = optimize_program(*prog, OptConfig{unroll}, &rep);
+        rep.print(std::cout);
     }
+    load_dot_program(pes, prog, N, part);   // Reparto y registros segun la estrategia
 
     // -------- ejecutar --------
     std::vector<std::thread> threads;
@@ -259,13 +309,13 @@ int main(int argc, char** argv) {
 
     // -------- resultados --------
     for (int p = 0; p < P; ++p) {
-        uint64_t addrS = (baseS_words + p) * 8ull;
-        std::cout << "PE" << p << " sum stored at M[" << (baseS_words + p)
+        uint64_t addrS = L.slot(p) * 8ull;
+        std::cout << "PE" << p << " sum stored at M[" << L.slot(p)
                   << "] = " << mem.load64(addrS) << "\n";
     }
 
-    double total = 0.0;
-    for (int p = 0; p < P; ++p) total += mem.load64((baseS_words + p) * 8ull);
+    // La reduccion en arbol del programa deja el total en S[0]
+    const double total = mem.load64(baseS_words * 8ull);
 
     double expected = 0.0;
     for (int i = 0; i < N; ++i)
@@ -281,9 +331,40 @@ int main(int argc, char** argv) {
                   << " writes=" << s.write_ops
                   << " misses=" << s.misses
                   << " invalidations=" << s.invalidations
-                  << " bus_msgs=" << s.bus_msgs << "\n";
+                  << " bus_msgs=" << s.bus_msgs
+                  << " mshr_merges=" << s.mshr_merges
+                  << " fill_waits=" << s.fill_waits
+                  << " instrs=" << pes[p]->stats.instrs
+                  << " load_use_stalls=" << pes[p]->stats.load_use_stalls
+                  << " sb_full_stalls=" << pes[p]->stats.sb_full_stalls
+                  << " sb_forwards=" << pes[p]->stats.sb_forwards
+                  << " barrier_stalls=" << pes[p]->stats.barrier_stalls << "\n";
+        if (caches[p]->prefetcher())
+            std::cout << "     prefetch(" << caches[p]->prefetcher()->name() << "): issued=" << s.prefetches
+                      << " useful=" << s.prefetch_useful
+                      << " late=" << s.prefetch_late
+                      << " useless=" << s.prefetch_useless
+                      << " dropped=" << s.prefetch_dropped << "\n";
+        if (s.atomic_ops)
+            std::cout << "     atomics: ops=" << s.atomic_ops
+                      << " bus=" << s.atomic_misses
+                      << " cas_fail=" << s.cas_failures
+                      << " sc_fail=" << s.sc_failures
+                      << " link_breaks=" << s.link_breaks << "\n";
     }
 
+    uint64_t total_instrs = 0;
+    for (auto& pe : pes) total_instrs += pe->stats.instrs;
+    std::cout << "Instrucciones dinamicas (todos los PEs): " << total_instrs << "\n";
+    std::cout << "Reparto " << partition_name(part.kind) << ": ";
+    print_imbalance(std::cout, pes);
+    print_layout(std::cout, N, P, part);
+    print_traffic(std::cout, coherence_traffic(caches));
+    if (l2) l2->report(std::cout);
+    if (numa) numa->report(std::cout);
+    print_misses(std::cout, caches, L);
+    bus.sharing().report(std::cout, 5, [&shm](uint32_t a) { return shm.owner_segment(a); });
+
     shm.stop(); // detener el hilo de la memoria compartida
     return 0;
 }
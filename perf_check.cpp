@@ -0,0 +1,218 @@
+// perf_check.cpp - Control de rendimiento: make perf-check / make perf-golden
+//   ./perf_check [-update] [-tol=<x>] [-reps=<n>] [filtro]
+// Corre una matriz fija de cargas con ./stepper_app -json y compara contra
+// perf/<carga>.golden:
+//   contadores simulados (deterministas en el stepper RR): deben ser iguales.
+//     Cualquier cambio falla; las subidas de trafico se marcan SUBE
+//   tiempo de host de "run" (mejor de -reps corridas), solo con -tol=<x> > 0:
+//     falla si supera el golden x tol; si baja de golden / tol solo avisa.
+//     Por defecto no se compara: el golden se midio en otro host
+// -update reescribe los golden con lo medido (revisar el diff antes de commitear)
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+const char* const kSim = "./stepper_app";
+const char* const kDir = "perf";
+
+// MATRIZ DE CARGAS: <PEs> <N> [programa] [banderas] y comandos previos a run.
+// N grande para que el tiempo de host no sea solo ruido
+struct Workload {
+    const char* name;
+    const char* args;
+    const char* setup;  // Comandos -e antes de run ("" = ninguno)
+};
+const Workload kMatrix[] = {
+    {"dotprod_p1_n16384",        "1 16384 dotprod.asm",                 ""},
+    {"dotprod_p2_n16384",        "2 16384 dotprod.asm",                 ""},
+    {"dotprod_p4_n16384",        "4 16384 dotprod.asm",                 ""},
+    {"dotprod_p8_n16384",        "8 16384 dotprod.asm",                 ""},
+    {"dotprod_p4_n1001",         "4 1001 dotprod.asm",                  ""},
+    {"dotprod_p4_n16384_packed", "4 16384 dotprod.asm -layout=packed",  ""},
+    {"dotprod_p4_n16384_o4",     "4 16384 dotprod.asm -O4",             ""},
+    {"dotprod_p4_n16384_stride", "4 16384 dotprod.asm",                 "prefetch stride 2 4"},
+    {"simd_p4_n16384",           "4 16384 dotprod_simd.asm",            ""},
+    {"atomic_p4_n4096",          "4 4096 dotprod_atomic.asm",           ""},
+    {"llsc_p4_n16384",           "4 16384 dotprod_llsc.asm",            ""},
+    {"cyclic_p4_n16384",         "4 16384 -part=cyclic",                ""},
+    {"dynamic_p4_n16384",        "4 16384 -part=dynamic:16",            ""},
+};
+
+// Contadores de Stats comparados, por PE y en total
+const char* const kCounters[] = {"instrs", "misses", "invalidations", "bus_msgs", "writebacks", "upgrades"};
+
+// Medicion de una carga: "pe<p> <contador>" y "total <contador>" -> valor
+struct Measure {
+    std::map<std::string, uint64_t> counters;
+    double seconds = 0;
+    bool correct = false;
+};
+
+// Valor numerico de "key": en s[from, to) (la salida del stepper es plana por objeto)
+bool number(const std::string& s, size_t from, size_t to, const std::string& key, double& v) {
+    const std::string pat = "\"" + key + "\":";
+    const size_t at = s.find(pat, from);
+    if (at == std::string::npos || at >= to) return false;
+    v = std::strtod(s.c_str() + at + pat.size(), nullptr);
+    return true;
+}
+
+bool run_once(const Workload& w, Measure& m, std::string& err) {
+    std::string cmd = std::string(kSim) + " " + w.args + " -json";
+    if (*w.setup) cmd += " -e '" + std::string(w.setup) + "'";
+    cmd += " -e 'history off' -e run";
+    FILE* p = popen(cmd.c_str(), "r");
+    if (!p) { err = "no se pudo ejecutar " + cmd; return false; }
+    std::string out;
+    char buf[4096];
+    for (size_t n; (n = std::fread(buf, 1, sizeof buf, p)) > 0; ) out.append(buf, n);
+    if (pclose(p) != 0) { err = "fallo: " + cmd; return false; }
+
+    std::istringstream lines(out);
+    bool have_run = false, have_results = false;
+    for (std::string l; std::getline(lines, l); ) {
+        if (l.find("\"cmd\":\"run\"") != std::string::npos)
+            have_run = number(l, 0, l.size(), "seconds", m.seconds);
+        else if (l.find("\"cmd\":\"results\"") != std::string::npos) {
+            have_results = true;
+            m.correct = l.find("\"correct\":true") != std::string::npos;
+            size_t at = l.find("\"caches\":[");
+            const size_t end = at == std::string::npos ? at : l.find(']', at);
+            std::map<std::string, uint64_t> total;
+            for (int pe = 0; at != std::string::npos && (at = l.find('{', at)) < end; ++pe) {
+                const size_t close = l.find('}', at);
+                for (const char* c : kCounters) {
+                    double v = 0;
+                    if (!number(l, at, close, c, v)) { err = std::string("falta ") + c; return false; }
+                    m.counters["pe" + std::to_string(pe) + " " + c] = uint64_t(v);
+                    total[c] += uint64_t(v);
+                }
+                at = close;
+            }
+            for (const auto& [c, v] : total) m.counters["total " + c] = v;
+        }
+    }
+    if (!have_run || !have_results || m.counters.empty()) { err = "salida incompleta de " + cmd; return false; }
+    return true;
+}
+
+std::string golden_path(const Workload& w) { return std::string(kDir) + "/" + w.name + ".golden"; }
+
+bool load_golden(const Workload& w, Measure& g) {
+    std::ifstream f(golden_path(w));
+    if (!f) return false;
+    for (std::string l; std::getline(f, l); ) {
+        if (l.empty() || l[0] == '#') continue;
+        std::istringstream ss(l);
+        std::string scope, counter;
+        ss >> scope;
+        if (scope == "seconds") { ss >> g.seconds; continue; }
+        uint64_t v = 0;
+        if (ss >> counter >> v) g.counters[scope + " " + counter] = v;
+    }
+    return true;
+}
+
+bool save_golden(const Workload& w, const Measure& m) {
+    std::ofstream f(golden_path(w));
+    if (!f) return false;
+    f << "# " << w.name << ": " << w.args << (*w.setup ? " / " : "") << w.setup << "\n";
+    f << "seconds " << std::setprecision(6) << m.seconds << "\n";
+    // Primero los totales, luego por PE (orden estable para el diff)
+    for (const char* c : kCounters) f << "total " << c << " " << m.counters.at(std::string("total ") + c) << "\n";
+    for (const auto& [k, v] : m.counters)
+        if (k.rfind("total ", 0) != 0) f << k << " " << v << "\n";
+    return bool(f);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bool update = false;
+    double tol = 0;
+    int reps = 3;
+    std::string filter;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "-update") update = true;
+        else if (a.rfind("-tol=", 0) == 0) tol = std::atof(a.c_str() + 5);
+        else if (a.rfind("-reps=", 0) == 0) reps = std::max(1, std::atoi(a.c_str() + 6));
+        else if (a[0] == '-') {
+            std::cerr << "Uso: " << argv[0] << " [-update] [-tol=<x>] [-reps=<n>] [filtro]\n";
+            return 1;
+        }
+        else filter = a;
+    }
+
+    int runs = 0, failures = 0;
+    for (const Workload& w : kMatrix) {
+        if (!filter.empty() && std::string(w.name).find(filter) == std::string::npos) continue;
+        ++runs;
+        std::vector<std::string> problems, notes;
+
+        // Mejor tiempo de reps corridas; los contadores deben repetirse
+        Measure m;
+        std::string err;
+        for (int r = 0; r < reps && err.empty(); ++r) {
+            Measure cur;
+            if (!run_once(w, cur, err)) break;
+            if (r == 0) m = cur;
+            else if (cur.counters != m.counters) err = "contadores no deterministas entre corridas";
+            else m.seconds = std::min(m.seconds, cur.seconds);
+        }
+        if (!err.empty()) problems.push_back(err);
+        else if (!m.correct) problems.push_back("resultado incorrecto");
+
+        Measure g;
+        if (problems.empty() && update) {
+            if (!save_golden(w, m)) problems.push_back("no se pudo escribir " + golden_path(w));
+        }
+        else if (problems.empty() && !load_golden(w, g))
+            problems.push_back("falta " + golden_path(w) + " (make perf-golden)");
+        else if (problems.empty()) {
+            std::map<std::string, uint64_t> keys = g.counters;
+            keys.insert(m.counters.begin(), m.counters.end());
+            for (const auto& [k, unused] : keys) {
+                (void)unused;
+                auto gi = g.counters.find(k), mi = m.counters.find(k);
+                const uint64_t gv = gi == g.counters.end() ? 0 : gi->second;
+                const uint64_t mv = mi == m.counters.end() ? 0 : mi->second;
+                if (gi != g.counters.end() && mi != m.counters.end() && gv == mv) continue;
+                std::ostringstream d;
+                d << (mv > gv ? "SUBE " : "baja ") << k << ": " << gv << " -> " << mv;
+                if (gv) d << std::showpos << std::fixed << std::setprecision(1)
+                          << " (" << 100.0 * (double(mv) - double(gv)) / double(gv) << "%)";
+                problems.push_back(d.str());
+            }
+            if (tol > 0 && g.seconds > 0) {
+                std::ostringstream d;
+                d << std::setprecision(3) << "tiempo " << m.seconds << " s vs golden " << g.seconds
+                  << " s (banda x" << tol << ")";
+                if (m.seconds > g.seconds * tol) problems.push_back("LENTO " + d.str());
+                else if (m.seconds < g.seconds / tol) notes.push_back("mas rapido: " + d.str() + "; regenerar con make perf-golden");
+            }
+        }
+
+        std::cout << (problems.empty() ? (update ? "GOLDEN " : "ok     ") : "FALLA  ") << w.name
+                  << std::setprecision(3) << " (" << m.seconds << " s)\n";
+        for (const std::string& p : problems) std::cout << "    " << p << "\n";
+        for (const std::string& n : notes) std::cout << "    nota: " << n << "\n";
+        if (!problems.empty()) ++failures;
+    }
+
+    if (runs == 0) {
+        std::cerr << "Ninguna carga coincide con '" << filter << "'\n";
+        return 1;
+    }
+    std::cout << "perf-check: " << runs << " cargas, " << failures << " con fallas\n";
+    return failures ? 1 : 0;
+}
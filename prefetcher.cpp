@@ -0,0 +1,53 @@
+// prefetcher.cpp
+#include "prefetcher.hpp"
+#include "cache.hpp"
+
+void NextLinePrefetcher::on_access(int, uint64_t addr, bool miss, bool prefetch_hit,
+                                   std::vector<uint64_t>& out) {
+    if (!miss && !prefetch_hit) return;
+    uint64_t block = Address::block_base(addr);
+    for (int k = 0; k < cfg_.degree; ++k)
+        out.push_back(block + uint64_t(cfg_.distance + k) * hw::kBlockBytes);
+}
+
+void StridePrefetcher::on_access(int pc, uint64_t addr, bool, bool,
+                                 std::vector<uint64_t>& out) {
+    auto& e = table_[size_t(pc < 0 ? 0 : pc) % kEntries];
+    if (e.pc != pc) {
+        e = Entry{pc, addr, 0, 0};
+        return;
+    }
+    int64_t delta = int64_t(addr) - int64_t(e.last_addr);
+    bool new_block = Address::block_base(addr) != Address::block_base(e.last_addr);
+    if (delta != 0 && delta == e.stride) {
+        if (e.conf < 3) e.conf++;
+    } else {
+        e.stride = delta;
+        e.conf = 0;
+    }
+    e.last_addr = addr;
+    if (e.conf < 2 || !new_block) return;
+
+    // Pasos menores que un bloque avanzan de bloque en bloque
+    int64_t bytes = int64_t(hw::kBlockBytes);
+    int64_t step = (e.stride > -bytes && e.stride < bytes) ? (e.stride > 0 ? bytes : -bytes) : e.stride;
+    for (int k = 0; k < cfg_.degree; ++k) {
+        int64_t target = int64_t(addr) + step * (cfg_.distance + k);
+        if (target < 0) break;
+        out.push_back(Address::block_base(uint64_t(target)));
+    }
+}
+
+bool StridePrefetcher::same_state(const Prefetcher& o) const {
+    const auto& t = static_cast<const StridePrefetcher&>(o).table_;
+    for (size_t i = 0; i < kEntries; ++i)
+        if (t[i].pc != table_[i].pc || t[i].last_addr != table_[i].last_addr ||
+            t[i].stride != table_[i].stride || t[i].conf != table_[i].conf) return false;
+    return true;
+}
+
+std::unique_ptr<Prefetcher> make_prefetcher(const std::string& kind, PrefetchConfig cfg) {
+    if (kind == "next")   return std::make_unique<NextLinePrefetcher>(cfg);
+    if (kind == "stride") return std::make_unique<StridePrefetcher>(cfg);
+    return nullptr;
+}
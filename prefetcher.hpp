@@ -0,0 +1,77 @@
+// prefetcher.hpp
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// CONFIGURACION DEL PREFETCHER
+struct PrefetchConfig {
+    int degree   = 2; // Bloques a pedir por disparo
+    int distance = 1; // Bloques de adelanto respecto al acceso actual
+};
+
+// PREFETCHER DE L1 - Observa los accesos de demanda y propone bloques.
+// La cache decide si emitirlos (MSHR libre, bloque ausente) y los trae por
+// el camino normal de coherencia (BusRd)
+class Prefetcher {
+public:
+    explicit Prefetcher(PrefetchConfig cfg) : cfg_(cfg) {}
+    virtual ~Prefetcher() = default;
+    virtual const char* name() const = 0;
+
+    // pc: instruccion que accede (-1 si no se conoce). miss: fallo de demanda.
+    // prefetch_hit: primer uso de una linea traida por prefetch.
+    // Agrega a out las direcciones base de bloque a traer
+    virtual void on_access(int pc, uint64_t addr, bool miss, bool prefetch_hit,
+                           std::vector<uint64_t>& out) = 0;
+
+    const PrefetchConfig& config() const { return cfg_; }
+
+    // Historial de deshacer (undo.hpp): copia con el mismo entrenamiento y
+    // comparacion contra una copia de este mismo prefetcher
+    virtual std::unique_ptr<Prefetcher> clone() const = 0;
+    virtual bool same_state(const Prefetcher& o) const = 0;
+
+protected:
+    PrefetchConfig cfg_;
+};
+
+// NEXT-LINE - En cada fallo (o primer uso de un bloque prefetcheado) pide
+// los bloques siguientes, a 'distance' bloques de distancia
+class NextLinePrefetcher : public Prefetcher {
+public:
+    using Prefetcher::Prefetcher;
+    const char* name() const override { return "next"; }
+    void on_access(int pc, uint64_t addr, bool miss, bool prefetch_hit,
+                   std::vector<uint64_t>& out) override;
+    std::unique_ptr<Prefetcher> clone() const override { return std::make_unique<NextLinePrefetcher>(*this); }
+    bool same_state(const Prefetcher&) const override { return true; }  // Sin estado
+};
+
+// STRIDE POR PC - Tabla indexada por PC con la ultima direccion y el paso.
+// Con el paso confirmado dos veces, al entrar a un bloque nuevo pide los
+// bloques que ese PC tocara 'distance' bloques mas adelante
+class StridePrefetcher : public Prefetcher {
+public:
+    using Prefetcher::Prefetcher;
+    const char* name() const override { return "stride"; }
+    void on_access(int pc, uint64_t addr, bool miss, bool prefetch_hit,
+                   std::vector<uint64_t>& out) override;
+    std::unique_ptr<Prefetcher> clone() const override { return std::make_unique<StridePrefetcher>(*this); }
+    bool same_state(const Prefetcher& o) const override;
+
+private:
+    struct Entry {
+        int pc = -1;
+        uint64_t last_addr = 0;
+        int64_t stride = 0;
+        int conf = 0;      // Confianza saturada en 0..3
+    };
+    static constexpr size_t kEntries = 64;
+    std::array<Entry, kEntries> table_{};
+};
+
+// Crea un prefetcher por nombre ("next", "stride"); nullptr para "none"
+std::unique_ptr<Prefetcher> make_prefetcher(const std::string& kind, PrefetchConfig cfg = {});
@@ -0,0 +1,159 @@
+#include "program_image.h"
+#include "parser.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+bool write_program_image(const std::string &path, const std::vector<Instr> &program,
+                         const std::unordered_map<std::string,size_t> &labels) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+
+    ImageHeader h{};
+    std::memcpy(h.magic, kImageMagic, sizeof(h.magic));
+    h.version = kImageVersion;
+    h.instr_size = sizeof(Instr);
+    h.n_instrs = uint32_t(program.size());
+    h.n_labels = uint32_t(labels.size());
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.write(reinterpret_cast<const char*>(program.data()), std::streamsize(program.size() * sizeof(Instr)));
+
+    // Las etiquetas solo hacen falta para el frontend (p.ej. FINAL_SUM)
+    for (const auto &[name, idx] : labels) {
+        uint32_t len = uint32_t(name.size()), at = uint32_t(idx);
+        out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+        out.write(name.data(), len);
+        out.write(reinterpret_cast<const char*>(&at), sizeof(at));
+    }
+    return bool(out);
+}
+
+// Una instruccion de la imagen no debe indexar fuera de los bancos de
+// registros del PE ni saltar fuera del programa
+static bool valid_instr(const Instr &I, size_t n_instrs) {
+    auto in = [](int r, int n) { return r >= 0 && r < n; };
+    if (int(I.op) < int(OpCode::NOP) || int(I.op) > int(OpCode::VZERO)) return false;
+    if (I.ri != -1 && !in(I.ri, kIntRegs)) return false;
+    if (I.scale != 1 && I.scale != 2 && I.scale != 4 && I.scale != 8) return false;
+    const bool addr = !I.addr_is_reg || in(I.ra, kIntRegs);  // Base de los accesos a memoria
+    const int data = I.fp ? kFpRegs : kIntRegs;               // Dato de LOAD/STORE/atomicas
+    switch (I.op) {
+        case OpCode::NOP:
+        case OpCode::HALT:
+        case OpCode::FENCE:
+        case OpCode::BARRIER:   return true;
+        case OpCode::LOAD:
+        case OpCode::STORE:
+        case OpCode::LL:        return addr && in(I.rd, data);
+        case OpCode::FETCH_ADD: return addr && in(I.rd, data) && in(I.rb, data);
+        case OpCode::CAS:       return addr && in(I.rd, kIntRegs) && in(I.rb, data) && in(I.rc, data);
+        case OpCode::SC:        return addr && in(I.rd, kIntRegs) && in(I.rb, data);
+        case OpCode::FMUL:
+        case OpCode::FADD:      return in(I.rd, kFpRegs) && in(I.ra, kFpRegs) && in(I.rb, kFpRegs);
+        case OpCode::FZERO:     return in(I.rd, kFpRegs);
+        case OpCode::INC:
+        case OpCode::DEC:
+        case OpCode::ADDI:      return in(I.rd, kIntRegs);
+        case OpCode::ADD:       return in(I.rd, kIntRegs) && in(I.ra, kIntRegs) && in(I.rb, kIntRegs);
+        case OpCode::ANDI:      return in(I.rd, kIntRegs) && in(I.ra, kIntRegs);
+        case OpCode::SHRI:
+        case OpCode::SHLI:      return in(I.rd, kIntRegs) && in(I.ra, kIntRegs) && I.imm >= 0 && I.imm < 64;
+        case OpCode::JNZ:
+        case OpCode::JZ:        return in(I.rd, kIntRegs) && I.target >= -1 && int64_t(I.target) <= int64_t(n_instrs);
+        case OpCode::VLOAD:
+        case OpCode::VSTORE:    return addr && in(I.rd, kVecRegs);
+        case OpCode::VFMUL:
+        case OpCode::VFADD:
+        case OpCode::VFMA:      return in(I.rd, kVecRegs) && in(I.ra, kVecRegs) && in(I.rb, kVecRegs);
+        case OpCode::VREDUCE:   return in(I.rd, kFpRegs) && in(I.ra, kVecRegs);
+        case OpCode::VZERO:     return in(I.rd, kVecRegs);
+    }
+    return false;
+}
+
+bool read_program_image(const std::string &path, std::vector<Instr> &program,
+                        std::unordered_map<std::string,size_t> &labels) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) {
+        std::cerr << "Error: no se pudo abrir " << path << "\n";
+        return false;
+    }
+    const uint64_t file_size = uint64_t(in.tellg());
+    in.seekg(0);
+    ImageHeader h{};
+    if (!in.read(reinterpret_cast<char*>(&h), sizeof(h)) ||
+        std::memcmp(h.magic, kImageMagic, sizeof(h.magic)) != 0) {
+        std::cerr << "Error: " << path << " no es una imagen de programa\n";
+        return false;
+    }
+    if (h.version != kImageVersion || h.instr_size != sizeof(Instr)) {
+        std::cerr << "Error: " << path << " es de otra version (v" << h.version
+                  << ", Instr de " << h.instr_size << " bytes); vuelva a ensamblar\n";
+        return false;
+    }
+    auto fail = [&](const char* why) {
+        std::cerr << "Error: imagen " << path << " " << why << "\n";
+        program.clear();
+        labels.clear();
+        return false;
+    };
+
+    // Los tamanos del encabezado se acotan con el archivo antes de reservar:
+    // cada etiqueta ocupa al menos sus dos uint32
+    uint64_t left = file_size - sizeof(h);
+    const uint64_t code_bytes = uint64_t(h.n_instrs) * sizeof(Instr);
+    if (code_bytes > left || uint64_t(h.n_labels) * 2 * sizeof(uint32_t) > left - code_bytes)
+        return fail("truncada");
+    left -= code_bytes;
+
+    // Las instrucciones se copian tal cual al almacen del programa
+    program.resize(h.n_instrs);
+    if (!in.read(reinterpret_cast<char*>(program.data()), std::streamsize(code_bytes))) return fail("truncada");
+    for (const Instr &I : program)
+        if (!valid_instr(I, program.size())) return fail("con una instruccion invalida");
+
+    labels.clear();
+    std::string name;
+    for (uint32_t i = 0; i < h.n_labels; ++i) {
+        uint32_t len = 0, at = 0;
+        if (!in.read(reinterpret_cast<char*>(&len), sizeof(len))) return fail("truncada");
+        left -= sizeof(len);
+        if (left < sizeof(at) || len > left - sizeof(at)) return fail("truncada");
+        name.resize(len);
+        if (!in.read(&name[0], len) || !in.read(reinterpret_cast<char*>(&at), sizeof(at))) return fail("truncada");
+        left -= len + sizeof(at);
+        if (at > h.n_instrs) return fail("con una etiqueta fuera del programa");
+        labels[name] = at;
+    }
+    return true;
+}
+
+bool load_program_file(const std::string &path, std::vector<Instr> &program,
+                       std::unordered_map<std::string,size_t> &labels) {
+    std::ifstream fin(path, std::ios::binary);
+    if (!fin) {
+        std::cerr << "Error: no se pudo abrir " << path << "\n";
+        return false;
+    }
+    char magic[sizeof(kImageMagic)] = {};
+    fin.read(magic, sizeof(magic));
+    if (fin && std::memcmp(magic, kImageMagic, sizeof(magic)) == 0) {
+        fin.close();
+        return read_program_image(path, program, labels);
+    }
+
+    // Texto ASM
+    fin.clear();
+    fin.seekg(0);
+    std::stringstream buffer;
+    buffer << fin.rdbuf();
+    return parse_asm(buffer.str(), program, labels);
+}
+
+ProgramPtr load_shared_program(const std::string &path) {
+    std::vector<Instr> code;
+    std::unordered_map<std::string,size_t> labels;
+    if (!load_program_file(path, code, labels)) return nullptr;
+    return std::make_shared<const Program>(code, std::move(labels));
+}
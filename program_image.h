@@ -0,0 +1,82 @@
+#ifndef PROGRAM_IMAGE_H
+#define PROGRAM_IMAGE_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "instr.h"
+
+// ALOCADOR ALINEADO - el codigo del programa empieza en una linea de cache
+// del host y no comparte linea con otros datos
+template <class T, std::size_t Align>
+struct AlignedAllocator {
+    using value_type = T;
+    template <class U> struct rebind { using other = AlignedAllocator<U, Align>; };
+    AlignedAllocator() = default;
+    template <class U> AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+    }
+    void deallocate(T* p, std::size_t) { ::operator delete(p, std::align_val_t(Align)); }
+    template <class U> bool operator==(const AlignedAllocator<U, Align>&) const { return true; }
+    template <class U> bool operator!=(const AlignedAllocator<U, Align>&) const { return false; }
+};
+
+constexpr std::size_t kHostLineBytes = 64;
+
+// PROGRAMA COMPARTIDO - inmutable y con conteo de referencias: todos los PEs
+// apuntan a la misma copia; cada PE solo guarda registros y PC
+class Program {
+public:
+    using Code = std::vector<Instr, AlignedAllocator<Instr, kHostLineBytes>>;
+    using Labels = std::unordered_map<std::string,size_t>;
+
+    Program(const std::vector<Instr> &code, Labels labels)
+        : code_(code.begin(), code.end()), labels_(std::move(labels)) {}
+
+    const Instr* code() const { return code_.data(); }
+    size_t size() const { return code_.size(); }
+    const Instr& operator[](size_t i) const { return code_[i]; }
+    const Labels& labels() const { return labels_; }
+
+private:
+    const Code code_;
+    const Labels labels_;
+};
+
+using ProgramPtr = std::shared_ptr<const Program>;
+
+// IMAGEN BINARIA DE PROGRAMA - programa ya ensamblado (saltos resueltos)
+// para cargar sin parsear. Formato (orden de bytes del host):
+//   ImageHeader | Instr[n_instrs] | n_labels x (uint32 len, nombre, uint32 indice)
+// Una imagen de otra version o con otro sizeof(Instr) se rechaza
+constexpr char     kImageMagic[8] = {'P','E','I','M','G','\0','\0','\0'};
+constexpr uint32_t kImageVersion  = 4;
+
+struct ImageHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t instr_size;  // sizeof(Instr) al ensamblar
+    uint32_t n_instrs;
+    uint32_t n_labels;
+};
+
+// Escribe la imagen; false si no se pudo crear el archivo
+bool write_program_image(const std::string &path, const std::vector<Instr> &program,
+                         const std::unordered_map<std::string,size_t> &labels);
+
+// Lee una imagen; false (con mensaje en cerr) si no existe o no es valida
+bool read_program_image(const std::string &path, std::vector<Instr> &program,
+                        std::unordered_map<std::string,size_t> &labels);
+
+// Carga un programa desde imagen binaria o, si el archivo no la tiene, desde ASM
+bool load_program_file(const std::string &path, std::vector<Instr> &program,
+                       std::unordered_map<std::string,size_t> &labels);
+
+// Igual, pero devuelve el programa compartido listo para los PEs (nullptr si falla)
+ProgramPtr load_shared_program(const std::string &path);
+
+#endif
@@ -0,0 +1,84 @@
+#include "report.h"
+#include <algorithm>
+#include <iostream>
+
+CoherenceTraffic coherence_traffic(const std::vector<std::unique_ptr<Cache>>& caches) {
+    CoherenceTraffic t;
+    for (const auto& c : caches) {
+        const Stats& s = c->stats();
+        t.bus_msgs += s.bus_msgs;
+        t.invalidations += s.invalidations;
+        t.upgrades += s.upgrades;
+        t.misses += s.misses;
+        t.writebacks += s.writebacks;
+    }
+    return t;
+}
+
+void print_traffic(std::ostream& os, const CoherenceTraffic& t) {
+    os << "Coherencia: bus=" << t.bus_msgs << " inval=" << t.invalidations << " upgrades=" << t.upgrades
+       << " misses=" << t.misses << " wb=" << t.writebacks << "\n";
+}
+
+void print_traffic_delta(std::ostream& os, const CoherenceTraffic& packed, const CoherenceTraffic& padded) {
+    auto field = [&](const char* name, uint64_t a, uint64_t b) {
+        os << " " << name << " " << a << " -> " << b << " (" << (b <= a ? "-" : "+")
+           << (b <= a ? a - b : b - a) << ")";
+    };
+    os << "packed -> padded:";
+    field("bus", packed.bus_msgs, padded.bus_msgs);
+    field("inval", packed.invalidations, padded.invalidations);
+    field("upgrades", packed.upgrades, padded.upgrades);
+    field("misses", packed.misses, padded.misses);
+    field("wb", packed.writebacks, padded.writebacks);
+    os << "\n";
+}
+
+MissCounts miss_counts(const Cache& c) {
+    const Stats& s = c.stats();
+    return {s.miss_compulsory, s.miss_capacity, s.miss_conflict, s.miss_coherence};
+}
+
+std::vector<std::pair<std::string, MissCounts>> misses_by_region(
+        const std::vector<std::unique_ptr<Cache>>& caches, const DotLayout& L) {
+    std::vector<std::pair<std::string, MissCounts>> out;
+    for (const char* r : {"A", "B", "S", "Q", "T", "-"}) out.push_back({r, MissCounts{}});
+    for (const auto& c : caches)
+        for (const auto& [block, counts] : c->miss_blocks()) {
+            const std::string r = dot_region(L, block);
+            for (auto& [name, acc] : out)
+                if (name == r)
+                    for (size_t k = 0; k < kMissKinds; ++k) acc[k] += counts[k];
+        }
+    // Solo las zonas con fallos
+    out.erase(std::remove_if(out.begin(), out.end(), [](const auto& e) {
+        return e.second[0] + e.second[1] + e.second[2] + e.second[3] == 0;
+    }), out.end());
+    return out;
+}
+
+static void print_miss_row(std::ostream& os, const MissCounts& m) {
+    for (size_t k = 0; k < kMissKinds; ++k)
+        os << " " << miss_kind_str(MissKind(k)) << "=" << m[k];
+    os << "\n";
+}
+
+void print_misses(std::ostream& os, const std::vector<std::unique_ptr<Cache>>& caches, const DotLayout& L,
+                  bool detail) {
+    os << "Fallos por tipo (3C + coherencia):\n";
+    MissCounts total{};
+    for (const auto& c : caches) {
+        const MissCounts m = miss_counts(*c);
+        for (size_t k = 0; k < kMissKinds; ++k) total[k] += m[k];
+        if (!detail) continue;
+        os << "  PE" << c->pe_id() << ":";
+        print_miss_row(os, m);
+    }
+    os << "  total:";
+    print_miss_row(os, total);
+    if (!detail) return;
+    for (const auto& [region, m] : misses_by_region(caches, L)) {
+        os << "  zona " << region << ":";
+        print_miss_row(os, m);
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "cache.hpp"
+#include "partition.h"
+
+// REPORTES DE LAS L1 - trafico de coherencia y fallos por tipo, sumados sobre
+// todas las caches (con los PEs detenidos). Las zonas salen del layout
+
+// TRAFICO DE COHERENCIA - sumado sobre todas las L1
+struct CoherenceTraffic {
+    uint64_t bus_msgs = 0, invalidations = 0, upgrades = 0, misses = 0, writebacks = 0;
+};
+CoherenceTraffic coherence_traffic(const std::vector<std::unique_ptr<Cache>>& caches);
+void print_traffic(std::ostream& os, const CoherenceTraffic& t);
+// "packed -> padded: bus 120 -> 64 (-56) ..." (lo que elimino el relleno)
+void print_traffic_delta(std::ostream& os, const CoherenceTraffic& packed, const CoherenceTraffic& padded);
+
+// FALLOS POR TIPO (3C + coherencia) - por PE y por zona del layout
+MissCounts miss_counts(const Cache& c);  // Desde Stats
+// Zona -> fallos por tipo, sumando todas las caches (con los PEs detenidos)
+std::vector<std::pair<std::string, MissCounts>> misses_by_region(
+    const std::vector<std::unique_ptr<Cache>>& caches, const DotLayout& L);
+// detail: ademas del total, una linea por PE y por zona
+void print_misses(std::ostream& os, const std::vector<std::unique_ptr<Cache>>& caches, const DotLayout& L,
+                  bool detail = true);
+
+#endif
@@ -1,16 +1,21 @@
 #include "shared_memory.h"
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 SharedMemory::SharedMemory(uint32_t words)
     : size_words_(words), mem_(words, 0),
       running_(false),
       total_word_reads(0), total_word_writes(0),
-      total_block_reads(0), total_block_writes(0) {}
+      total_block_reads(0), total_block_writes(0),
+      block_traffic_((words + 3) / 4) {}
 
 void SharedMemory::add_segment(int pe_id, uint32_t base_word, uint32_t len_words) {
     Segment s{pe_id, base_word, len_words};
-    segments_.push_back(s);
+    // Ordenados por base: owner_segment busca en O(log n)
+    auto at = std::upper_bound(segments_.begin(), segments_.end(), base_word,
+                               [](uint32_t w, const Segment& x) { return w < x.base_word; });
+    segments_.insert(at, s);
 }
 
 void SharedMemory::start() {
@@ -77,17 +82,27 @@ void SharedMemory::dump_stats() {
               << " block_writes=" << total_block_writes.load() << "\n";
 }
 
-int SharedMemory::owner_segment(uint32_t byte_addr) {
-    uint32_t word = byte_addr / 8;
-    for (auto &s : segments_) {
-        if (word >= s.base_word && word < s.base_word + s.len_words) return s.pe_id;
-    }
-    return -1;
+int SharedMemory::owner_segment(uint32_t byte_addr) const {
+    const uint32_t word = byte_addr / 8;
+    // Ultimo segmento que empieza en o antes de la palabra
+    auto it = std::upper_bound(segments_.begin(), segments_.end(), word,
+                               [](uint32_t w, const Segment& x) { return w < x.base_word; });
+    if (it == segments_.begin()) return -1;
+    --it;
+    return word - it->base_word < it->len_words ? it->pe_id : -1;
+}
+
+uint32_t SharedMemory::take_peak_depth() {
+    std::lock_guard<std::mutex> lk(q_mutex_);
+    const uint32_t peak = peak_depth_;
+    peak_depth_ = uint32_t(q_.size());
+    return peak;
 }
 
 void SharedMemory::push_request(Request&& r) {
     std::unique_lock<std::mutex> lk(q_mutex_);
     q_.push_back(std::move(r));
+    peak_depth_ = std::max(peak_depth_, uint32_t(q_.size()));
     q_cv_.notify_one();
 }
 
@@ -116,6 +131,13 @@ void SharedMemory::process_request(const Request& r) {
         if (r.byte_addr % 8 != 0) throw std::runtime_error("Unaligned word access");
         uint32_t word_idx = r.byte_addr / 8;
         if (word_idx >= size_words_) throw std::runtime_error("Word address out of range");
+        block_traffic_[word_idx / 4].fetch_add(1, std::memory_order_relaxed);
+        if (watch_) {  // Antes de responder: el PE que espera ya ve el disparo
+            double v;
+            if (r.type == Request::READ_WORD) memcpy(&v, &mem_[word_idx], 8);
+            else memcpy(&v, r.data.data(), 8);
+            watch_->on_access(r.type == Request::WRITE_WORD, -1, r.byte_addr, 8, &v);
+        }
 
         if (r.type == Request::READ_WORD) {
             uint64_t val = mem_[word_idx];
@@ -125,6 +147,7 @@ void SharedMemory::process_request(const Request& r) {
             if (r.data.size() != 8) throw std::runtime_error("WRITE_WORD needs 8 bytes");
             uint64_t val;
             memcpy(&val, r.data.data(), 8);
+            if (journal_ && mem_[word_idx] != val) journal_->emplace_back(word_idx, mem_[word_idx]);
             mem_[word_idx] = val;
             total_word_writes.fetch_add(1);
             if (r.prom_void) r.prom_void->set_value();
@@ -134,6 +157,8 @@ void SharedMemory::process_request(const Request& r) {
         uint32_t block_idx = (r.byte_addr / 8) / 4;
         uint32_t first_word = block_idx * 4;
         if (first_word + 4 > size_words_) throw std::runtime_error("Block address out of range");
+        block_traffic_[block_idx].fetch_add(1, std::memory_order_relaxed);
+        if (watch_) watch_->on_access(r.type == Request::WRITE_BLOCK, -1, r.byte_addr, 32);
 
         if (r.type == Request::READ_BLOCK) {
             std::vector<Byte> out(32);
@@ -148,6 +173,7 @@ void SharedMemory::process_request(const Request& r) {
             for (int i = 0; i < 4; ++i) {
                 uint64_t w;
                 memcpy(&w, r.data.data() + i*8, 8);
+                if (journal_ && mem_[first_word + i] != w) journal_->emplace_back(first_word + i, mem_[first_word + i]);
                 mem_[first_word + i] = w;
             }
             total_block_writes.fetch_add(1);
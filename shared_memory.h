@@ -11,6 +11,8 @@
 #include <atomic>
 #include <stdexcept>
 
+#include "watch.hpp"
+
 using Byte = uint8_t;
 
 // SEGMENTO DE MEMORIA - Para particionamiento lógico
@@ -35,7 +37,7 @@ class SharedMemory {
 public:
     explicit SharedMemory(uint32_t words); // Constructor con tamano en palabras
 
-    // Gestión de segmentos
+    // Gestión de segmentos (disjuntos)
     void add_segment(int pe_id, uint32_t base_word, uint32_t len_words);
     
     // Control del sistema
@@ -50,12 +52,33 @@ public:
 
     // Utilidades
     void dump_stats(); // Mostrar estadísticas
-    int owner_segment(uint32_t byte_addr); // Encontrar dueno de dirección
+    int owner_segment(uint32_t byte_addr) const; // Dueno de la dirección (-1 si no tiene), O(log n)
+    uint32_t size_words() const { return size_words_; }
+    // Lectura directa, sin pasar por el worker ni contar estadisticas. Solo
+    // sin escrituras en cola (las caches esperan las suyas: basta con que
+    // ningun PE este ejecutando)
+    uint64_t peek_word(uint32_t word) const { return word < size_words_ ? mem_[word] : 0; }
+    // Trafico por bloque de 4 palabras (lecturas + escrituras atendidas por el worker)
+    uint32_t size_blocks() const { return uint32_t(block_traffic_.size()); }
+    uint32_t block_traffic(uint32_t block) const {
+        return block < block_traffic_.size() ? block_traffic_[block].load(std::memory_order_relaxed) : 0;
+    }
+    // Pico de pedidos en cola desde la llamada anterior (linea de tiempo de la GUI)
+    uint32_t take_peak_depth();
+    // Watchpoints (watch.hpp) sobre los accesos que atiende el worker; nullptr
+    // si no hay ninguno. Cambiar sin pedidos en vuelo
+    void set_watch(Watchpoints* w) { watch_ = w; }
+    // Historial de deshacer (undo.hpp): el worker anota cada palabra que
+    // escribe con su valor anterior. nullptr si no se graba; cambiar sin pedidos en vuelo
+    using Journal = std::vector<std::pair<uint32_t, uint64_t>>;
+    void set_journal(Journal* j) { journal_ = j; }
+    // Escritura directa, como peek_word: sin pedidos en vuelo
+    void poke_word(uint32_t word, uint64_t v) { if (word < size_words_) mem_[word] = v; }
 
 private:
     uint32_t size_words_;           // Tamano total en palabras
     std::vector<uint64_t> mem_;     // Almacenamiento principal
-    std::vector<Segment> segments_; // Segmentos definidos
+    std::vector<Segment> segments_; // Segmentos definidos, ordenados por base
 
     // COLA DE SOLICITUDES para procesamiento asíncrono
     std::deque<Request> q_;
@@ -63,12 +86,16 @@ private:
     std::condition_variable q_cv_;
     std::thread worker_;
     std::atomic<bool> running_;
+    uint32_t peak_depth_ = 0;       // Protegido por q_mutex_
+    Watchpoints* watch_ = nullptr;  // Lo lee el worker; se fija con la cola vacia
+    Journal* journal_ = nullptr;    // Idem
 
     // ESTADÍSTICAS de uso
     std::atomic<uint64_t> total_word_reads;
     std::atomic<uint64_t> total_word_writes;
     std::atomic<uint64_t> total_block_reads;
     std::atomic<uint64_t> total_block_writes;
+    std::vector<std::atomic<uint32_t>> block_traffic_;  // Por bloque (mapa de calor de la GUI)
 
     // MÉTODOS INTERNOS
     void push_request(Request&& r);     // Agregar solicitud a la cola
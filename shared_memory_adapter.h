@@ -33,6 +33,13 @@ public:
         std::memcpy(out.data(), v.data(), hw::kBlockBytes);
     }
 
+    uint64_t size_bytes() const override { return uint64_t(shm_->size_words()) * 8; }
+
+    // LECTURA DE BLOQUE SIN ESPERA - el future se resuelve en el hilo worker
+    std::future<std::vector<uint8_t>> readBlockAsync(uint64_t block_addr) override {
+        return shm_->readBlockAsync(static_cast<uint32_t>(block_addr));
+    }
+
     // LECTURA DE DOUBLE - 8 bytes
     double load64(uint64_t addr) override {
         auto fut = shm_->readWordAsync(static_cast<uint32_t>(addr));
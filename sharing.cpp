@@ -0,0 +1,104 @@
+// sharing.cpp
+#include "sharing.hpp"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+uint8_t SharingTracker::word_mask(uint64_t addr, uint32_t n) {
+    const uint32_t w = uint32_t(addr / 8) % kBlockWords;
+    return uint8_t(((1u << n) - 1) << w);
+}
+
+void SharingTracker::invalidated(uint64_t block, int victim, int writer) {
+    if (victim < 0 || victim >= kMaxPes) return;
+    std::lock_guard<std::mutex> lk(m_);
+    Block& b = blocks_[block];
+    b.st.block = block;
+    b.st.invalidations++;
+    b.st.pes |= 1u << victim;
+    if (writer >= 0 && writer < kMaxPes) b.st.pes |= 1u << writer;
+    if (!b.stale) stale_blocks_++;
+    b.stale |= 1u << victim;
+    b.dirty[victim] = 0;  // La escritura que invalido se anota en wrote()
+}
+
+void SharingTracker::wrote(uint64_t addr, uint32_t n, int pe) {
+    if (!stale_blocks_.load(std::memory_order_relaxed)) return;
+    std::lock_guard<std::mutex> lk(m_);
+    auto it = blocks_.find(addr - addr % (8 * kBlockWords));
+    if (it == blocks_.end() || !it->second.stale) return;
+    Block& b = it->second;
+    const uint8_t mask = word_mask(addr, n);
+    for (int q = 0; q < kMaxPes; ++q)
+        if (q != pe && (b.stale >> q & 1u)) b.dirty[q] |= mask;
+}
+
+void SharingTracker::missed(uint64_t addr, uint32_t n, int pe) {
+    if (pe < 0 || pe >= kMaxPes || !stale_blocks_.load(std::memory_order_relaxed)) return;
+    std::lock_guard<std::mutex> lk(m_);
+    auto it = blocks_.find(addr - addr % (8 * kBlockWords));
+    if (it == blocks_.end() || !(it->second.stale >> pe & 1u)) return;
+    Block& b = it->second;
+    if (b.dirty[pe] & word_mask(addr, n)) { b.st.true_misses++; true_++; }
+    else { b.st.false_misses++; false_++; }
+    b.stale &= ~(1u << pe);
+    b.dirty[pe] = 0;
+    if (!b.stale) stale_blocks_--;
+}
+
+void SharingTracker::refetched(uint64_t block, int pe) {
+    if (pe < 0 || pe >= kMaxPes || !stale_blocks_.load(std::memory_order_relaxed)) return;
+    std::lock_guard<std::mutex> lk(m_);
+    auto it = blocks_.find(block);
+    if (it == blocks_.end() || !(it->second.stale >> pe & 1u)) return;
+    it->second.stale &= ~(1u << pe);
+    if (!it->second.stale) stale_blocks_--;
+}
+
+uint64_t SharingTracker::true_sharing() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return true_;
+}
+
+uint64_t SharingTracker::false_sharing() const {
+    std::lock_guard<std::mutex> lk(m_);
+    return false_;
+}
+
+std::vector<SharingTracker::BlockStats> SharingTracker::top(size_t k) const {
+    std::vector<BlockStats> v;
+    {
+        std::lock_guard<std::mutex> lk(m_);
+        for (const auto& [addr, b] : blocks_)
+            if (b.st.true_misses || b.st.false_misses) v.push_back(b.st);
+    }
+    std::sort(v.begin(), v.end(), [](const BlockStats& a, const BlockStats& b) {
+        if (a.false_misses != b.false_misses) return a.false_misses > b.false_misses;
+        if (a.true_misses != b.true_misses) return a.true_misses > b.true_misses;
+        return a.block < b.block;
+    });
+    if (v.size() > k) v.resize(k);
+    return v;
+}
+
+void SharingTracker::report(std::ostream& os, size_t k, const std::function<int(uint32_t)>& owner) const {
+    os << "Fallos de coherencia: true sharing=" << true_sharing()
+       << " false sharing=" << false_sharing() << "\n";
+    for (const BlockStats& s : top(k)) {
+        std::ostringstream pes;
+        for (int p = 0; p < kMaxPes; ++p)
+            if (s.pes >> p & 1u) pes << (pes.tellp() > 0 ? "," : "") << p;
+        const int seg = owner ? owner(uint32_t(s.block)) : -1;
+        os << "  bloque 0x" << std::hex << s.block << std::dec
+           << " (M[" << s.block / 8 << "], segmento " << (seg < 0 ? std::string("-") : "PE" + std::to_string(seg))
+           << "): false=" << s.false_misses << " true=" << s.true_misses
+           << " inval=" << s.invalidations << " PEs {" << pes.str() << "}\n";
+    }
+}
+
+void SharingTracker::reset() {
+    std::lock_guard<std::mutex> lk(m_);
+    blocks_.clear();
+    stale_blocks_ = 0;
+    true_ = false_ = 0;
+}
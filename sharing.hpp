@@ -0,0 +1,58 @@
+// sharing.hpp
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// DETECTOR DE SHARING - clasifica los fallos de coherencia por palabra.
+// Cuando un BusRdX/BusUpgr invalida la copia de un PE se anotan las palabras
+// que escriben los demas PEs desde ese momento. El siguiente fallo de demanda
+// de ese PE al bloque es:
+//   true sharing   si toca alguna de esas palabras (necesitaba el dato nuevo)
+//   false sharing  si solo toca otras palabras (la invalidacion sobraba)
+// Los fallos frios y de capacidad no cuentan. Interconnect::broadcast informa
+// las invalidaciones; la cache, sus escrituras y fallos de demanda
+class SharingTracker {
+public:
+    static constexpr uint32_t kBlockWords = 4;  // doubles por bloque (hw::kBlockBytes / 8)
+    static constexpr int kMaxPes = 32;          // PEs en la mascara de involucrados
+
+    struct BlockStats {
+        uint64_t block = 0;          // Direccion base del bloque
+        uint64_t invalidations = 0;  // Copias invalidadas por escrituras remotas
+        uint64_t true_misses = 0;
+        uint64_t false_misses = 0;
+        uint32_t pes = 0;            // Bit p: el PE p fue invalidado o escribio
+    };
+
+    void invalidated(uint64_t block, int victim, int writer);
+    void wrote(uint64_t addr, uint32_t n, int pe);   // n doubles desde addr
+    void missed(uint64_t addr, uint32_t n, int pe);  // Fallo de demanda
+    void refetched(uint64_t block, int pe);          // Prefetch: llega sin clasificar
+
+    uint64_t true_sharing() const;
+    uint64_t false_sharing() const;
+    // Bloques con fallos de coherencia, primero los de mas false sharing
+    std::vector<BlockStats> top(size_t k) const;
+    // owner: segmento dueno de una direccion en bytes (-1 si ninguno)
+    void report(std::ostream& os, size_t k, const std::function<int(uint32_t)>& owner = {}) const;
+    void reset();
+
+private:
+    struct Block {
+        BlockStats st;
+        uint32_t stale = 0;  // PEs con la copia invalidada que aun no volvieron a fallar
+        std::array<uint8_t, kMaxPes> dirty{};  // Por PE: palabras escritas por otros desde entonces
+    };
+    static uint8_t word_mask(uint64_t addr, uint32_t n);
+
+    mutable std::mutex m_;
+    std::unordered_map<uint64_t, Block> blocks_;
+    std::atomic<uint32_t> stale_blocks_{0};  // Camino rapido: sin copias invalidadas no hay nada que anotar
+    uint64_t true_ = 0, false_ = 0;
+};
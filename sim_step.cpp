@@ -4,18 +4,29 @@
 #include <string>
 #include <iomanip>
 #include <optional>
-#include <unordered_set>
+#include <chrono>
 #include <cctype>
 #include <memory>
 #include <fstream>
 #include <sstream>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
 
 #include "cache.hpp"
+#include "l2_cache.hpp"
+#include "numa.hpp"
 #include "shared_memory_adapter.h"
 #include "shared_memory.h"
 #include "parser.h"
+#include "program_image.h"
+#include "optimizer.h"
 #include "instr.h"
 #include "pe.h"
+#include "partition.h"
+#include "report.h"
+#include "watch.hpp"
+#include "undo.hpp"
 
 // ---------- Utilidad pequena de parsing ----------
 static inline std::vector<std::string> split_ws(const std::string& s) {
@@ -45,93 +56,58 @@ struct System {
     std::shared_ptr<SharedMemory> shm;
     std::unique_ptr<SharedMemoryAdapter> mem;
     Interconnect bus;
+    std::unique_ptr<L2Cache> l2;  // nullptr: las L1 van directo a memoria
+    std::unique_ptr<NumaMemory> numa;  // nullptr: memoria uniforme (excluye a la L2)
     std::vector<std::unique_ptr<Cache>> l1;
     std::vector<std::unique_ptr<PE>> pes;
+    Barrier barrier;     // BARRIER de los programas
+    
+    ProgramPtr program;  // Compartido por todos los PEs (nullptr si no cargo)
+    PartitionConfig part; // Reparto de N entre los PEs
     
     // Constructor que inicializa todo correctamente
-    System(unsigned num_pes, int N = 8) {  // Agregar N como parametro
-        // Crear memoria compartida
-        shm = std::make_shared<SharedMemory>(512);
+    System(unsigned num_pes, int N, ProgramPtr prog, PartitionConfig cfg = {},
+           const std::optional<L2Config>& l2cfg = std::nullopt,
+           const std::optional<NumaConfig>& numacfg = std::nullopt)
+        : program(std::move(prog)), part(cfg) {
+        // Crear memoria compartida (la tabla de chunks puede pasar de 512)
+        const size_t words = dot_layout(N, num_pes, part).words;
+        shm = std::make_shared<SharedMemory>(uint32_t(std::max<size_t>(words, hw::kMemDoubles)));
         shm->start();
         
+        add_dot_segments(*shm, N, num_pes, part);  // Dueno de cada zona (reporte de sharing)
+        
         // Crear adaptador de memoria
         mem = std::make_unique<SharedMemoryAdapter>(shm.get());
+        if (l2cfg) l2 = std::make_unique<L2Cache>(mem.get(), &bus, *l2cfg);
+        if (numacfg) numa = std::make_unique<NumaMemory>(mem.get(), *numacfg, numa_homes(*shm, num_pes, *numacfg), num_pes);
         
         // Crear caches
         l1.reserve(num_pes);
         for (unsigned i = 0; i < num_pes; ++i) {
-            l1.emplace_back(std::make_unique<Cache>(int(i), mem.get(), &bus));
+            IMemory* below = numa ? numa->port(int(i)) : l2 ? static_cast<IMemory*>(l2.get()) : mem.get();
+            l1.emplace_back(std::make_unique<Cache>(int(i), below, &bus));
         }
         
         // Crear PEs
         pes.reserve(num_pes);
         for (unsigned i = 0; i < num_pes; ++i) {
             pes.emplace_back(std::make_unique<PE>(int(i), l1[i].get()));
+            pes.back()->set_barrier(&barrier);
         }
+        barrier.reset(num_pes);
         
-        // Inicializar memoria y cargar programa
-        initialize_memory(N);
-        load_program_to_all_pes(N);
+        // Inicializar memoria y cargar programa (layout y registros en partition.cpp)
+        init_dot_memory(*mem, N, num_pes, part);
+        load_dot_program(pes, program, N, part);
     }
     
-    void initialize_memory(int N) {
-        // Layout: A[0..N-1], B[0..N-1], S[0..P-1]
-        const size_t baseA_words = 0;
-        const size_t baseB_words = baseA_words + static_cast<size_t>(N);
-        const size_t baseS_words = baseB_words + static_cast<size_t>(N);
-        
-        // Inicializar vectores A y B
-        for (int i = 0; i < N; ++i) {
-            mem->store64((baseA_words + i) * 8, double(i + 1));           // A[i] = i+1
-            mem->store64((baseB_words + i) * 8, double((i + 1) * 2));     // B[i] = (i+1)*2
-        }
-        
-        // Inicializar sumas parciales
-        for (unsigned p = 0; p < pes.size(); ++p) {
-            mem->store64((baseS_words + p) * 8, 0.0);
-        }
-    }
-    
-    void load_program_to_all_pes(int N) {
-        // Cargar programa desde archivo
-        std::ifstream fin("dotprod.asm");
-        if (!fin) {
-            std::cerr << "Error: no se pudo abrir dotprod.asm\n";
-            return;
-        }
-        
-        std::stringstream buffer;
-        buffer << fin.rdbuf();
-        std::vector<Instr> prog;
-        std::unordered_map<std::string,size_t> labels;
-        parse_asm(buffer.str(), prog, labels);
-        
-        // Layout de memoria
-        const size_t baseA_words = 0;
-        const size_t baseB_words = baseA_words + static_cast<size_t>(N);
-        const size_t baseS_words = baseB_words + static_cast<size_t>(N);
-        const unsigned num_pes = pes.size();
-        
-        // Reparto balanceado con resto
-        const int base_len = N / num_pes;
-        const int rest = N % num_pes;
-        auto start_index_of = [&](int pe) { return pe * base_len + std::min(pe, rest); };
-        auto len_of         = [&](int pe) { return base_len + (pe < rest ? 1 : 0); };
-        
-        // Configurar cada PE
-        for (unsigned p = 0; p < num_pes; ++p) {
-            const int start = start_index_of(p);
-            const int len   = len_of(p);
-            
-            pes[p]->load_program(prog, labels);
-            pes[p]->set_reg_int(0, int((baseA_words + start) * 8));  // &A[start] bytes
-            pes[p]->set_reg_int(1, int((baseB_words + start) * 8));  // &B[start] bytes
-            pes[p]->set_reg_int(2, int((baseS_words + p) * 8));      // &S[p] bytes
-            pes[p]->set_reg_int(3, len);                             // longitud tramo
-            pes[p]->set_reg_double(4, 0.0);                          // acumulador
-        }
+    // Ganchos de watchpoints en todas las L1 y la memoria (nullptr: sin costo)
+    void set_watch(Watchpoints* w) {
+        shm->set_watch(w);
+        for (auto& c : l1) c->set_watch(w);
     }
-    
+
     ~System() {
         if (shm) {
             shm->stop();
@@ -139,34 +115,267 @@ struct System {
     }
 };
 
+// ---------- Salida JSON (modo por lotes) ----------
+// JSON Lines: un objeto por comando, en una linea, para comparar corridas con
+// diff o jq. Los doubles salen con 17 digitos (ida y vuelta exacta); NaN/inf como null
+class Json {
+public:
+    explicit Json(std::ostream& os) : os_(os) { os_.precision(17); }
+    Json& obj(const char* key = nullptr) { open(key, '{'); return *this; }
+    Json& arr(const char* key = nullptr) { open(key, '['); return *this; }
+    Json& end() {
+        os_ << (open_.back() == '{' ? '}' : ']');
+        open_.pop_back();
+        first_ = false;
+        return *this;
+    }
+    template <class T> Json& val(const char* key, const T& v) { sep(key); write(v); return *this; }
+    template <class T> Json& item(const T& v) { return val(nullptr, v); }
+    bool nested() const { return !open_.empty(); }
+
+private:
+    void open(const char* key, char c) {
+        sep(key);
+        os_ << c;
+        open_.push_back(c);
+        first_ = true;
+    }
+    void sep(const char* key) {
+        if (!first_) os_ << ',';
+        first_ = false;
+        if (key) { write(key); os_ << ':'; }
+    }
+    void write(bool v) { os_ << (v ? "true" : "false"); }
+    void write(double v) {
+        if (std::isfinite(v)) os_ << v;
+        else os_ << "null";
+    }
+    void write(const char* s) {
+        os_ << '"';
+        for (; *s; ++s) {
+            const unsigned char c = *s;
+            if (c == '"' || c == '\\') os_ << '\\' << c;
+            else if (c == '\n') os_ << "\\n";
+            else if (c == '\t') os_ << "\\t";
+            else if (c < 0x20) os_ << "\\u00" << "0123456789abcdef"[c >> 4] << "0123456789abcdef"[c & 15];
+            else os_ << c;
+        }
+        os_ << '"';
+    }
+    void write(const std::string& s) { write(s.c_str()); }
+    template <class T> void write(const T& v) {
+        static_assert(std::is_integral<T>::value, "Solo enteros, double, bool y cadenas");
+        if (std::is_signed<T>::value) os_ << int64_t(v);
+        else os_ << uint64_t(v);
+    }
+
+    std::ostream& os_;
+    std::string open_;  // '{' o '[' por nivel abierto
+    bool first_ = true;
+};
+
+// SALIDA DE UN COMANDO - con JSON, lo que el comando imprime en std::cout se
+// captura. Los comandos con salida estructurada (regs, mem, cache, stats,
+// run...) llenan json(); el resto sale como {"cmd", "args", "text"}. El
+// objeto se cierra al destruir (tambien con 'continue' en el REPL)
+class CommandOutput {
+public:
+    CommandOutput(bool json, std::ostream& out, const std::vector<std::string>& args, int& errors)
+        : json_(json), out_(out), j_(out), args_(args), errors_(errors) {
+        if (json_) old_ = std::cout.rdbuf(text_.rdbuf());
+    }
+    ~CommandOutput() {
+        if (!json_) return;
+        std::cout.rdbuf(old_);
+        json();
+        if (!error_.empty()) j_.val("error", error_);
+        const std::string text = text_.str();
+        if (!text.empty()) j_.val("text", text);
+        j_.end();
+        out_ << '\n' << std::flush;
+    }
+    CommandOutput(const CommandOutput&) = delete;
+    CommandOutput& operator=(const CommandOutput&) = delete;
+
+    bool json_mode() const { return json_; }
+    // Objeto del comando, abierto con "cmd" y "args"; el llamador agrega campos
+    Json& json() {
+        if (!j_.nested()) {
+            j_.obj().val("cmd", args_.empty() ? std::string() : args_[0]);
+            j_.arr("args");
+            for (size_t i = 1; i < args_.size(); ++i) j_.item(args_[i]);
+            j_.end();
+        }
+        return j_;
+    }
+    // Argumentos invalidos o comando desconocido: cuenta para el codigo de salida
+    void error(const std::string& msg) {
+        errors_++;
+        if (json_) error_ = msg;
+        else std::cout << msg << "\n";
+    }
+
+private:
+    bool json_;
+    std::ostream& out_;
+    Json j_;
+    std::vector<std::string> args_;
+    int& errors_;
+    std::ostringstream text_;
+    std::streambuf* old_ = nullptr;
+    std::string error_;
+};
+
 // ---------- REPL ----------
-struct Breakpoint {
-    int pe_id;
-    int pc;
-    bool operator==(const Breakpoint& o) const { return pe_id==o.pe_id && pc==o.pc; }
+// BREAKPOINTS - un bitmap por PE indexado por PC. Solo se mira el bit del PE
+// que acaba de avanzar, y nada si ese PE no tiene breakpoints
+class BreakMap {
+public:
+    explicit BreakMap(size_t num_pes) : bits_(num_pes), armed_(num_pes, 0) {}
+    void set(int pe, int pc) {
+        auto& b = bits_[pe];
+        if (size_t(pc) >= b.size()) b.resize(size_t(pc) + 1, false);
+        if (!b[pc]) { b[pc] = true; armed_[pe]++; }
+    }
+    bool clear(int pe, int pc) {
+        if (!test(pe, pc)) return false;
+        bits_[pe][pc] = false;
+        armed_[pe]--;
+        return true;
+    }
+    bool test(int pe, int pc) const {
+        return armed_[pe] && size_t(pc) < bits_[pe].size() && bits_[pe][pc];
+    }
+    bool empty() const {
+        for (uint32_t n : armed_) if (n) return false;
+        return true;
+    }
+    void list(std::ostream& os) const {
+        for (size_t pe = 0; pe < bits_.size(); ++pe)
+            for (size_t pc = 0; pc < bits_[pe].size(); ++pc)
+                if (bits_[pe][pc]) os << "  PE" << pe << " PC=" << pc << "\n";
+    }
+private:
+    std::vector<std::vector<bool>> bits_;
+    std::vector<uint32_t> armed_;  // Breakpoints activos por PE
 };
 
-struct BkHash { 
-    size_t operator()(const Breakpoint& b) const { 
-        return (size_t(b.pe_id)<<20) ^ size_t(b.pc); 
-    } 
+// Un paso de 'p', grabado en el historial si esta activo (rstep)
+static void exec_step(PE& p, UndoLog* hist) {
+    if (hist) hist->step(p.pe_id());
+    else p.step();
+}
+
+// Un paso de 'p': true si llego (cambio de PC) a un breakpoint. Un PE detenido
+// en BARRIER no cambia de PC y no vuelve a disparar el suyo
+static bool step_pe(PE& p, const BreakMap& bks, UndoLog* hist) {
+    const int pc0 = p.get_pc();
+    exec_step(p, hist);
+    return p.get_pc() != pc0 && bks.test(p.pe_id(), p.get_pc());
+}
+
+// WATCHPOINTS - los ganchos solo se conectan mientras corren step/stepi/cont y
+// si hay alguno: mem, resultados finales y 'run' no disparan ni pagan nada
+class WatchScope {
+public:
+    WatchScope(System& sys, Watchpoints& w) : sys_(sys), on_(!w.empty()) {
+        if (on_) sys_.set_watch(&w);
+    }
+    ~WatchScope() { if (on_) sys_.set_watch(nullptr); }
+private:
+    System& sys_;
+    bool on_;
 };
 
+// Muestra y descarta los disparos; true si hubo alguno
+static bool report_watch_hits(std::ostream& os, Watchpoints& w) {
+    if (!w.triggered()) return false;
+    uint64_t dropped = 0;
+    for (const WatchHit& h : w.take_hits(&dropped)) print_watch_hit(os, h);
+    if (dropped) os << "(" << dropped << " disparos mas)\n";
+    return true;
+}
+
+// CORRIDA SIN TOPE - round-robin hasta HALT, breakpoint (termina la ronda, como
+// antes 'cont'), watchpoint (justo despues de la instruccion que disparo) o
+// 'budget' instrucciones ejecutadas (0 = sin limite)
+struct RunResult {
+    uint64_t rounds = 0, instrs = 0;
+    double seconds = 0.0;
+    bool breakpoint = false, watchpoint = false, budget = false;
+    double mips() const { return seconds > 0 ? double(instrs) / seconds / 1e6 : 0.0; }
+};
+
+static RunResult run_fast(std::vector<std::unique_ptr<PE>>& pes, const BreakMap& bks, uint64_t budget = 0,
+                          const Watchpoints* watch = nullptr, UndoLog* hist = nullptr) {
+    RunResult r;
+    const auto t0 = std::chrono::steady_clock::now();
+    const bool check = !bks.empty();
+    if (watch && watch->empty()) watch = nullptr;
+    uint64_t start = 0;
+    for (auto& p : pes) start += p->stats.instrs;
+    for (bool advanced = true; advanced; ) {
+        advanced = false;
+        for (auto& p : pes) {
+            if (p->is_halted()) continue;
+            advanced = true;
+            if (check) r.breakpoint |= step_pe(*p, bks, hist);
+            else exec_step(*p, hist);
+            if (watch && watch->triggered()) { r.watchpoint = true; break; }
+        }
+        if (!advanced) break;
+        r.rounds++;
+        if (r.breakpoint || r.watchpoint) break;
+        if (budget) {
+            uint64_t done = 0;
+            for (auto& p : pes) done += p->stats.instrs;
+            if (done - start >= budget) { r.budget = true; break; }
+        }
+    }
+    for (auto& p : pes) r.instrs += p->stats.instrs;
+    r.instrs -= start;
+    r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    return r;
+}
+
+static void print_run(std::ostream& os, const RunResult& r) {
+    std::ostringstream line;
+    line << std::fixed << std::setprecision(3) << r.instrs << " instrucciones en " << r.rounds
+         << " rondas, " << r.seconds << " s (" << std::setprecision(2) << r.mips() << " MIPS simulados)";
+    os << line.str() << "\n";
+    if (r.breakpoint) os << "Detenido en breakpoint\n";
+    if (r.watchpoint) os << "Detenido en watchpoint\n";
+    if (r.budget) os << "Presupuesto de instrucciones agotado\n";
+}
+
 static void print_help() {
     std::cout <<
 R"(Comandos:
   help                       - ayuda
   step [N]                   - avanza N instrucciones globales (RR) (default 1)
   stepi <pe> [N]             - avanza N instrucciones solo en PE <pe> (default 1)
-  cont                       - ejecuta hasta que todos halteen o haya breakpoint
+  cont [I]                   - ejecuta hasta que todos halteen, haya breakpoint o se ejecuten I instrucciones
+  run [I]                    - como cont, sin breakpoints ni watchpoints
   regs [pe]                  - muestra registros (todos si omites pe)
   pc [pe]                    - muestra PC(s)
   mem <addr> [count]         - lee memoria como dobles desde <addr> (hex o dec). count por defecto 8
-  cache [pe]                 - dump del estado de cache de <pe>
+  cache [pe]                 - dump del estado de cache de <pe> (todas si omites pe)
   stats                      - estadisticas de todas las caches
+  layout                     - layout de memoria y trafico de coherencia packed vs padded
+  misses                     - fallos por tipo (3C + coherencia) por PE y por zona de memoria
+  sharing [K]                - fallos de coherencia true/false sharing y los K peores bloques (default 5)
+  l2                         - estadisticas de la L2 compartida, total y por banco (con -l2=...)
+  numa                       - accesos locales/remotos por PE (con -numa=...) y ubicaciones comparadas
+  prefetch <none|next|stride> [grado] [dist] - configura el prefetcher de todas las L1
   break <pe> <pc>            - pone breakpoint en PC de ese PE
   breaks                     - lista breakpoints
   clear <pe> <pc>            - quita un breakpoint
+  rstep [N]                  - deshace las ultimas N instrucciones (de cualquier PE) de step/stepi/cont (default 1)
+  history [on|off]           - estado del historial de rstep; off deja de grabar
+  watch <r|w|rw> <addr> [bytes] - detiene step/stepi/cont al leer/escribir [addr, addr+bytes) (default 8)
+  watch mesi <addr> [bytes]  - detiene al cambiar de estado MESI ese bloque (o bloques) en cualquier L1
+  watches                    - lista watchpoints
+  unwatch <id>               - quita un watchpoint
   quit                       - salir
 )" << std::endl;
 }
@@ -176,89 +385,372 @@ static bool any_running(const std::vector<std::unique_ptr<PE>>& pes) {
     return false;
 }
 
-static bool hit_breakpoint(const std::vector<std::unique_ptr<PE>>& pes,
-                           const std::unordered_set<Breakpoint,BkHash>& bks) {
-    for (auto& p : pes) {
-        Breakpoint b{p->pe_id(), p->get_pc()};
-        if (bks.count(b)) return true;
-    }
-    return false;
-}
+// RESULTADOS - hace flush de todas las caches y lee la memoria
+struct FinalResults {
+    double total = 0.0, expected = 0.0;
+    std::vector<double> partials;  // S[p] tras la reduccion: suma del subarbol de cada PE
+    bool correct() const { return std::abs(total - expected) < 1e-10; }
+};
 
-void show_final_results(System& sys, int N) {
+static FinalResults final_results(System& sys, int N) {
     // Flush todas las caches antes de leer memoria
     for (auto& cache : sys.l1) {
         cache->flush_all();
     }
     sys.bus.flush_all();
     
-    const size_t baseA_words = 0;
-    const size_t baseB_words = baseA_words + static_cast<size_t>(N);
-    const size_t baseS_words = baseB_words + static_cast<size_t>(N);
+    const DotLayout L = dot_layout(N, sys.pes.size(), sys.part);
+    const size_t baseA_words = L.baseA;
+    const size_t baseB_words = L.baseB;
+    const size_t baseS_words = L.baseS;
     
-    // Calcular suma total
-    double total = 0.0;
-    for (unsigned p = 0; p < sys.pes.size(); ++p) {
-        total += sys.mem->load64((baseS_words + p) * 8);
-    }
+    FinalResults r;
+    // La reduccion en arbol del programa deja el total en S[0]
+    r.total = sys.mem->load64(baseS_words * 8);
     
     // Calcular resultado esperado
-    double expected = 0.0;
     for (int i = 0; i < N; ++i) {
         double a = sys.mem->load64((baseA_words + i) * 8);
         double b = sys.mem->load64((baseB_words + i) * 8);
-        expected += a * b;
+        r.expected += a * b;
     }
+    for (unsigned p = 0; p < sys.pes.size(); ++p) r.partials.push_back(sys.mem->load64(L.slot(p) * 8));
+    return r;
+}
+
+void show_final_results(System& sys, int N) {
+    const FinalResults r = final_results(sys, N);
+    const DotLayout L = dot_layout(N, sys.pes.size(), sys.part);
     
     // Mostrar solo resultados finales
     std::cout << "\n=== RESULTADOS ===" << std::endl;
-    std::cout << "Producto punto calculado: " << total << std::endl;
-    std::cout << "Producto punto esperado:  " << expected << std::endl;
-    std::cout << "¿Correcto? " << (std::abs(total - expected) < 1e-10 ? "SI " : "NO ") << std::endl;
+    std::cout << "Producto punto calculado: " << r.total << std::endl;
+    std::cout << "Producto punto esperado:  " << r.expected << std::endl;
+    std::cout << "¿Correcto? " << (r.correct() ? "SI " : "NO ") << std::endl;
     
-    // Opcional: mostrar sumas parciales brevemente
-    std::cout << "\nSumas parciales: ";
-    for (unsigned p = 0; p < sys.pes.size(); ++p) {
-        double partial = sys.mem->load64((baseS_words + p) * 8);
-        std::cout << "S[" << p << "]=" << partial;
-        if (p < sys.pes.size() - 1) std::cout << ", ";
+    std::cout << "\nSumas parciales (tras la reduccion): ";
+    for (unsigned p = 0; p < r.partials.size(); ++p) {
+        std::cout << "S[" << p << "]=" << r.partials[p];
+        if (p < r.partials.size() - 1) std::cout << ", ";
     }
     std::cout << std::endl;
+    std::cout << "Reparto " << partition_name(sys.part.kind) << ": ";
+    print_imbalance(std::cout, sys.pes);
+    std::cout << "Layout " << layout_name(sys.part.layout) << ": ";
+    print_traffic(std::cout, coherence_traffic(sys.l1));
+    if (sys.l2) sys.l2->report(std::cout);
+    if (sys.numa) sys.numa->report(std::cout);
+    print_misses(std::cout, sys.l1, L, false);
+    sys.bus.sharing().report(std::cout, 3, [&sys](uint32_t a) { return sys.shm->owner_segment(a); });
+}
+
+// ---------- Objetos JSON de regs, mem, cache, stats y resultados ----------
+static void json_pe(Json& j, const PE& p) {
+    PE::State s;
+    p.save_state(s);
+    j.obj().val("pe", p.pe_id()).val("pc", s.pc).val("halted", s.halt).val("barrier", s.barrier_wait);
+    j.arr("r");
+    for (int64_t r : s.iregs) j.item(r);
+    j.end().arr("f");
+    for (double f : s.fregs) j.item(f);
+    j.end().arr("v");
+    for (const auto& v : s.vregs) {
+        j.arr();
+        for (double x : v.lane) j.item(x);
+        j.end();
+    }
+    j.end().arr("sb");  // Stores aun no retirados, del mas viejo al mas nuevo
+    for (int k = 0; k < s.sb_count; ++k) {
+        const auto& e = s.sb[(s.sb_head + k) % PE::kSbEntries];
+        j.obj().val("addr", e.addr).arr("val");
+        for (uint32_t i = 0; i < e.n; ++i) j.item(e.val[i]);
+        j.end().end();
+    }
+    j.end().end();
+}
+
+// PC y estado de los PEs (pe < 0: todos)
+static void json_pcs(Json& j, const std::vector<std::unique_ptr<PE>>& pes, int pe = -1) {
+    j.arr("pes");
+    for (auto& p : pes) {
+        if (pe >= 0 && p->pe_id() != pe) continue;
+        j.obj().val("pe", p->pe_id()).val("pc", p->get_pc()).val("halted", p->is_halted())
+         .val("barrier", p->at_barrier()).end();
+    }
+    j.end();
+}
+
+static void json_cache(Json& j, const Cache& c) {
+    std::vector<LineView> lines;
+    c.copy_lines(lines);
+    j.obj().val("pe", c.pe_id()).arr("lines");
+    for (size_t i = 0; i < lines.size(); ++i) {
+        const LineView& l = lines[i];
+        const uint32_t set = uint32_t(i / hw::kWays);
+        j.obj().val("set", set).val("way", uint32_t(i % hw::kWays)).val("state", mesi_str(l.state))
+         .val("addr", Address::join(l.tag, set)).val("recent", l.recent).val("pending", l.pending).arr("data");
+        for (size_t w = 0; w < hw::kBlockBytes / 8; ++w) {
+            double d;
+            std::memcpy(&d, l.data.data() + 8 * w, 8);
+            j.item(d);
+        }
+        j.end().end();
+    }
+    j.end().end();
+}
+
+static void json_stats(Json& j, System& sys) {
+    j.arr("caches");
+    for (size_t i = 0; i < sys.l1.size(); ++i) {
+        const Stats& s = sys.l1[i]->stats();
+        const auto& ps = sys.pes[i]->stats;
+        j.obj().val("pe", uint32_t(i));
+        for (size_t k = 0; k < Stats::kCounters; ++k) j.val(Stats::kNames[k], uint64_t(s.*Stats::kFields[k]));
+        j.val("instrs", ps.instrs).val("loads", ps.loads).val("stores", ps.stores)
+         .val("load_use_stalls", ps.load_use_stalls).val("sb_full_stalls", ps.sb_full_stalls)
+         .val("sb_forwards", ps.sb_forwards).val("barrier_stalls", ps.barrier_stalls)
+         .val("prefetcher", sys.l1[i]->prefetcher() ? sys.l1[i]->prefetcher()->name() : "none");
+        j.end();
+    }
+    j.end();
+    const Imbalance imb = load_imbalance(sys.pes);
+    j.obj("imbalance").val("max", imb.max).val("min", imb.min).val("mean", imb.mean)
+     .val("slowest", imb.slowest).val("ratio", imb.ratio()).end();
+    const CoherenceTraffic t = coherence_traffic(sys.l1);
+    j.obj("traffic").val("bus_msgs", t.bus_msgs).val("invalidations", t.invalidations).val("upgrades", t.upgrades)
+     .val("misses", t.misses).val("writebacks", t.writebacks).end();
+    if (sys.l2) {
+        const L2Stats& l = sys.l2->stats();
+        j.obj("l2").val("config", l2_name(sys.l2->config())).val("reads", uint64_t(l.reads)).val("read_hits", uint64_t(l.read_hits))
+         .val("writes", uint64_t(l.writes)).val("write_hits", uint64_t(l.write_hits)).val("fills", uint64_t(l.fills)).val("evictions", uint64_t(l.evictions))
+         .val("back_invalidations", uint64_t(l.back_invalidations)).val("back_writebacks", uint64_t(l.back_writebacks)).arr("banks");
+        for (uint32_t b = 0; b < sys.l2->config().banks; ++b) {
+            const L2Stats& bs = sys.l2->bank_stats(b);
+            j.obj().val("reads", uint64_t(bs.reads)).val("read_hits", uint64_t(bs.read_hits)).val("writes", uint64_t(bs.writes))
+             .val("evictions", uint64_t(bs.evictions)).end();
+        }
+        j.end().end();
+    }
+    if (sys.numa) {
+        const NumaStats t = sys.numa->total();
+        j.obj("numa").val("config", numa_name(sys.numa->config())).val("remote", t.remote())
+         .val("blocks", t.total()).val("cycles", t.cycles).val("queued", t.queued).arr("pes");
+        for (size_t i = 0; i < sys.pes.size(); ++i) {
+            const NumaStats ps = sys.numa->stats(int(i));
+            j.obj().val("node", sys.numa->node_of(int(i))).val("local_reads", ps.local_reads)
+             .val("remote_reads", ps.remote_reads).val("local_writes", ps.local_writes)
+             .val("remote_writes", ps.remote_writes).val("cycles", ps.cycles).val("queued", ps.queued).end();
+        }
+        j.end().end();
+    }
+    j.obj("sharing").val("true", sys.bus.sharing().true_sharing()).val("false", sys.bus.sharing().false_sharing()).end();
+}
+
+// seconds y mips dependen del host: las comparaciones deben ignorarlos
+static void json_run(Json& j, const RunResult& r, const std::vector<std::unique_ptr<PE>>& pes) {
+    j.val("instrs", r.instrs).val("rounds", r.rounds).val("seconds", r.seconds).val("mips", r.mips())
+     .val("breakpoint", r.breakpoint).val("watchpoint", r.watchpoint).val("budget", r.budget)
+     .val("halted", !any_running(pes));
+}
+
+static void json_results(Json& j, System& sys, int N) {
+    const FinalResults r = final_results(sys, N);
+    j.val("halted", !any_running(sys.pes)).val("total", r.total).val("expected", r.expected)
+     .val("correct", r.correct()).arr("partials");
+    for (double p : r.partials) j.item(p);
+    j.end();
+    json_stats(j, sys);
+}
+
+// Corrida aparte, round-robin hasta que todos los PEs hagan HALT
+static void run_to_halt(System& s) {
+    run_fast(s.pes, BreakMap(s.pes.size()));
+}
+
+// Instrucciones ejecutadas por todos los PEs hasta HALT
+static uint64_t dynamic_instrs(unsigned num_pes, int N, const ProgramPtr& prog,
+                               const PartitionConfig& part) {
+    System s(num_pes, N, prog, part);
+    run_to_halt(s);
+    uint64_t total = 0;
+    for (auto& p : s.pes) total += p->stats.instrs;
+    return total;
+}
+
+// Trafico de coherencia del programa completo con el layout 'l' (sin prefetcher ni L2)
+static CoherenceTraffic traffic_with(unsigned num_pes, int N, const ProgramPtr& prog,
+                                     PartitionConfig part, Layout l) {
+    part.layout = l;
+    System s(num_pes, N, prog, part);
+    run_to_halt(s);
+    return coherence_traffic(s.l1);
+}
+
+// Programa completo con la ubicacion NUMA 'p' (sin prefetcher)
+static NumaStats numa_with(unsigned num_pes, int N, const ProgramPtr& prog,
+                           const PartitionConfig& part, NumaConfig cfg, NumaPlacement p) {
+    cfg.placement = p;
+    System s(num_pes, N, prog, part, std::nullopt, cfg);
+    run_to_halt(s);
+    return s.numa->total();
 }
 
 int main(int argc, char** argv) {
     unsigned num_pes = 4;
     int N = 8;  // Tamano de vectores por defecto
+    int unroll = 0; // -O<n>: optimizar el programa desenrollando x n
+    PartitionConfig part; // -part=<estrategia>[:chunk]
+    std::optional<L2Config> l2cfg; // -l2=inclusive|noninclusive[:lineas[:vias[:bancos]]]
+    std::optional<NumaConfig> numacfg; // -numa=local|interleave|node0[:nodos[:...]]
+    // MODO POR LOTES - comandos de -script=<archivo> (- = stdin) y de -e <cmd>,
+    // en el orden de la linea de comandos, sin prompt ni ayuda. -json emite un
+    // objeto por comando. Codigo de salida 1 si algun comando fallo
+    bool batch_mode = false, json = false;
+    std::vector<std::string> batch;
+
+    // Argumentos posicionales: <PEs> <N> <programa>; las banderas -O<n>,
+    // -part=..., -layout=..., -l2=..., -numa=..., -script=..., -e y -json pueden ir en cualquier lugar
+    std::vector<std::string> pos;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "-json") json = true;
+        else if (a == "-e") {
+            if (i + 1 == argc) { std::cerr << "Falta el comando de -e\n"; return 1; }
+            batch.push_back(argv[++i]);
+            batch_mode = true;
+        }
+        else if (a.rfind("-script=", 0) == 0) {
+            const std::string path = a.substr(8);
+            std::ifstream f;
+            if (path != "-") {
+                f.open(path);
+                if (!f) { std::cerr << "No se pudo abrir el script " << path << "\n"; return 1; }
+            }
+            std::istream& in = path == "-" ? std::cin : f;
+            for (std::string l; std::getline(in, l); ) batch.push_back(l);
+            batch_mode = true;
+        }
+        else if (a.rfind("-O", 0) == 0) unroll = a.size() > 2 ? std::atoi(a.c_str() + 2) : 4;
+        else if (a.rfind("-part=", 0) == 0) {
+            if (!parse_partition(a.substr(6), part)) {
+                std::cerr << "Reparto desconocido: " << a.substr(6)
+                          << " (block|cyclic|line|dynamic[:chunk]|guided[:chunk])\n";
+                return 1;
+            }
+        }
+        else if (a.rfind("-layout=", 0) == 0) {
+            if (!parse_layout(a.substr(8), part.layout)) {
+                std::cerr << "Layout desconocido: " << a.substr(8) << " (packed|padded)\n";
+                return 1;
+            }
+        }
+        else if (a.rfind("-l2=", 0) == 0) {
+            L2Config c;
+            if (!parse_l2(a.substr(4), c)) {
+                std::cerr << "L2 invalida: " << a.substr(4)
+                          << " (inclusive|noninclusive[:lineas[:vias[:bancos]]], lineas multiplo de vias*bancos)\n";
+                return 1;
+            }
+            l2cfg = c;
+        }
+        else if (a.rfind("-numa=", 0) == 0) {
+            NumaConfig c;
+            if (!parse_numa(a.substr(6), c)) {
+                std::cerr << "NUMA invalida: " << a.substr(6)
+                          << " (local|interleave|node0[:nodos[:local:remota[:ocup_memoria:ocup_enlace]]], 1-255 nodos)\n";
+                return 1;
+            }
+            numacfg = c;
+        }
+        else pos.push_back(a);
+    }
+    if (l2cfg && numacfg) {
+        std::cerr << "-l2 y -numa no se combinan: la L2 compartida no tiene nodo hogar\n";
+        return 1;
+    }
     
-    if (argc > 1) {
+    if (pos.size() > 0) {
         int np = 0; 
-        if (to_int(argv[1], np) && np > 0) num_pes = unsigned(np);
+        if (to_int(pos[0], np) && np > 0) num_pes = unsigned(np);
     }
     
-    if (argc > 2) {
-        N = std::atoi(argv[2]);
+    if (pos.size() > 1) {
+        N = std::atoi(pos[1].c_str());
         if (N <= 0) N = 8;
     }
 
-    std::cout << "Inicializando sistema con " << num_pes << " PEs y N=" << N << "..." << std::endl;
-    System sys(num_pes, N);  // Pasar N al constructor
-    std::cout << "Stepper listo. PEs=" << num_pes << "\n";
-    print_help();
+    std::string prog_path = partition_kernel(part.kind); // Kernel de la estrategia
+    if (pos.size() > 2) prog_path = pos[2];
 
-    std::unordered_set<Breakpoint,BkHash> breaks;
+    // Con -json todo lo que no es un objeto de comando va al texto de "init"
+    int errors = 0;
+    std::ostream json_out(std::cout.rdbuf());
+    std::optional<CommandOutput> init;
+    if (json) init.emplace(true, json_out, std::vector<std::string>{"init"}, errors);
+    std::cout << "Inicializando sistema con " << num_pes << " PEs, N=" << N
+              << ", reparto " << partition_name(part.kind) << ", layout "
+              << layout_name(part.layout) << (l2cfg ? ", L2 " + l2_name(*l2cfg) : std::string())
+              << (numacfg ? ", NUMA " + numa_name(*numacfg) : std::string())
+              << " y programa " << prog_path << "..." << std::endl;
+    ProgramPtr prog = load_shared_program(prog_path);
+    if (prog && unroll > 1) {
+        OptReport rep;
+        ProgramPtr opt = optimize_program(*prog, OptConfig{unroll}, &rep);
+        rep.print(std::cout);
+        uint64_t before = dynamic_instrs(num_pes, N, prog, part);
+        uint64_t after = dynamic_instrs(num_pes, N, opt, part);
+        std::cout << "Instrucciones dinamicas: " << before << " -> " << after;
+        if (before) {
+            std::ostringstream pct;
+            pct << std::fixed << std::setprecision(1)
+                << 100.0 * (double(before) - double(after)) / double(before);
+            std::cout << " (" << pct.str() << "% menos)";
+        }
+        std::cout << "\n";
+        prog = opt;
+    }
+    System sys(num_pes, N, prog, part, l2cfg, numacfg);
+    if (!prog) {
+        if (init) init->error("Sin programa cargado");
+        else errors++;
+    }
+    if (init) {
+        init->json().val("pes", num_pes).val("N", N).val("partition", partition_name(part.kind))
+                    .val("chunk", part.chunk).val("layout", layout_name(part.layout))
+                    .val("program", prog_path).val("unroll", unroll)
+                    .val("l2", l2cfg ? l2_name(*l2cfg) : "none")
+                    .val("numa", numacfg ? numa_name(*numacfg) : "none");
+        init.reset();
+    }
+    if (!batch_mode) {
+        std::cout << "Stepper listo. PEs=" << num_pes << "\n";
+        print_help();
+    }
+
+    BreakMap breaks(num_pes);
+    Watchpoints watches;
+    // Historial de rstep: graban step/stepi/cont; run, prefetch y off lo vacian
+    auto hist = std::make_unique<UndoLog>(sys.pes, sys.l1, *sys.shm, sys.barrier, sys.l2.get(), sys.numa.get());
 
     // Cargar programa en todos los PEs (necesitaras implementar esto)
     // Por ahora, dejamos los PEs sin programa para pruebas basicas
     
     std::string line;
+    size_t next = 0;
     while (true) {
-        std::cout << "stepper> " << std::flush;
-        if (!std::getline(std::cin, line)) break;
+        if (batch_mode) {
+            if (next == batch.size()) break;
+            line = batch[next++];
+        } else {
+            std::cout << "stepper> " << std::flush;
+            if (!std::getline(std::cin, line)) break;
+        }
         auto t = split_ws(line);
-        if (t.empty()) continue;
+        if (t.empty() || t[0][0] == '#') continue;  // '#': comentario en scripts
 
-        auto cmd = t[0];
-        for (auto& c: cmd) c = std::tolower(c);
+        for (auto& c: t[0]) c = std::tolower(c);
+        const std::string cmd = t[0];
+        CommandOutput rec(json, json_out, t, errors);
 
         if (cmd=="help" || cmd=="h" || cmd=="?") {
             print_help();
@@ -267,28 +759,43 @@ int main(int argc, char** argv) {
             break;
         }
         else if (cmd=="regs") {
+            size_t lo = 0, hi = sys.pes.size();  // Sin pe: todos
             if (t.size()==2) {
                 int pe=-1; 
                 if (!to_int(t[1], pe) || pe<0 || pe>=int(sys.pes.size())) { 
-                    std::cout<<"pe invalido\n"; continue; 
+                    rec.error("pe invalido"); continue; 
                 }
-                sys.pes[pe]->dump_regs();
-            } else {
-                for (auto& p : sys.pes) p->dump_regs();
+                lo = size_t(pe);
+                hi = lo + 1;
             }
+            if (rec.json_mode()) {
+                Json& j = rec.json().arr("pes");
+                for (size_t i = lo; i < hi; ++i) json_pe(j, *sys.pes[i]);
+                j.end();
+            }
+            else for (size_t i = lo; i < hi; ++i) sys.pes[i]->dump_regs();
         }
         else if (cmd=="pc") {
-            if (t.size()==2) {
+            if (rec.json_mode()) {
+                int pe=-1;
+                if (t.size()==2 && (!to_int(t[1], pe) || pe<0 || pe>=int(sys.pes.size()))) {
+                    rec.error("pe invalido"); continue;
+                }
+                json_pcs(rec.json(), sys.pes, pe);
+            }
+            else if (t.size()==2) {
                 int pe=-1; 
                 if (!to_int(t[1], pe) || pe<0 || pe>=int(sys.pes.size())) { 
-                    std::cout<<"pe invalido\n"; continue; 
+                    rec.error("pe invalido"); continue; 
                 }
                 std::cout << "[PE" << pe << "] PC=" << sys.pes[pe]->get_pc()
-                          << " HALT=" << sys.pes[pe]->is_halted() << "\n";
+                          << " HALT=" << sys.pes[pe]->is_halted()
+                          << (sys.pes[pe]->at_barrier() ? " (BARRIER)" : "") << "\n";
             } else {
                 for (auto& p : sys.pes) {
                     std::cout << "[PE" << p->pe_id() << "] PC=" << p->get_pc()
-                              << " HALT=" << p->is_halted() << "\n";
+                              << " HALT=" << p->is_halted()
+                              << (p->at_barrier() ? " (BARRIER)" : "") << "\n";
                 }
             }
         }
@@ -298,79 +805,76 @@ int main(int argc, char** argv) {
                 uint64_t tmp; 
                 if (to_uint64(t[1], tmp)) n=tmp; 
             }
+            WatchScope ws(sys, watches);
             for (uint64_t k=0; k<n; k++) {
                 // round-robin: avanza 1 instruccion por PE no-halted
                 bool advanced = false;
+                bool hit = false;
                 for (auto& p : sys.pes) {
                     if (!p->is_halted()) {
-                        p->step();
                         advanced = true;
-                        if (hit_breakpoint(sys.pes, breaks)) break;
+                        if ((hit = step_pe(*p, breaks, hist.get()) || watches.triggered())) break;
                     }
                 }
-                if (!advanced || hit_breakpoint(sys.pes, breaks)) break;
+                if (!advanced || hit) break;
             }
+            report_watch_hits(std::cout, watches);
+            if (rec.json_mode()) json_pcs(rec.json(), sys.pes);
         }
         else if (cmd=="stepi") {
             if (t.size()<2) { 
-                std::cout<<"Uso: stepi <pe> [N]\n"; continue; 
+                rec.error("Uso: stepi <pe> [N]"); continue; 
             }
             int pe=-1; 
             if (!to_int(t[1], pe) || pe<0 || pe>=int(sys.pes.size())) { 
-                std::cout<<"pe invalido\n"; continue; 
+                rec.error("pe invalido"); continue; 
             }
             uint64_t n=1; 
             if (t.size()>=3) { 
                 uint64_t tmp; 
                 if (to_uint64(t[2], tmp)) n=tmp; 
             }
+            WatchScope ws(sys, watches);
             for (uint64_t k=0; k<n; k++) {
-                if (!sys.pes[pe]->is_halted()) {
-                    sys.pes[pe]->step();
-                    if (hit_breakpoint(sys.pes, breaks)) break;
-                } else break;
+                if (sys.pes[pe]->is_halted() || step_pe(*sys.pes[pe], breaks, hist.get()) || watches.triggered()) break;
             }
+            report_watch_hits(std::cout, watches);
+            if (rec.json_mode()) json_pcs(rec.json(), sys.pes);
         }
         else if (cmd=="cont" || cmd=="c" || cmd=="continue") {
-            int max_steps = 10000; // limite de seguridad
-            int steps = 0;
-            while (any_running(sys.pes) && steps < max_steps) {
-                bool advanced = false;
-                for (auto& p : sys.pes) {
-                    if (!p->is_halted()) { 
-                        p->step(); 
-                        advanced = true;
-                        steps++;
-                    }
-                }
-                if (!advanced || hit_breakpoint(sys.pes, breaks)) break;
-                
-                // Mostrar progreso cada 1000 pasos
-                if (steps % 1000 == 0) {
-                    std::cout << "Continuando... pasos: " << steps << std::endl;
-                }
+            uint64_t budget = 0; // Instrucciones (0 = sin limite)
+            if (t.size()>=2 && !to_uint64(t[1], budget)) { rec.error("Uso: cont [instrucciones]"); continue; }
+            RunResult r;
+            {
+                WatchScope ws(sys, watches);
+                r = run_fast(sys.pes, breaks, budget, &watches, hist.get());
             }
-            
-            if (steps >= max_steps) {
-                std::cout << "ALERTA: Se alcanzo el limite de " << max_steps << " pasos" << std::endl;
-            }
-            
-            // Mostrar resultados finales
-            show_final_results(sys, N);
+            report_watch_hits(std::cout, watches);
+            if (rec.json_mode()) { json_run(rec.json(), r, sys.pes); continue; }  // Resultados al final
+            print_run(std::cout, r);
+
+            // Mostrar resultados finales (solo si terminaron todos)
+            if (!any_running(sys.pes)) show_final_results(sys, N);
         }
         else if (cmd=="mem") {
             if (t.size()<2) { 
-                std::cout<<"Uso: mem <addr> [count]\n"; continue; 
+                rec.error("Uso: mem <addr> [count]"); continue; 
             }
             uint64_t addr=0; 
             if (!to_uint64(t[1], addr)) { 
-                std::cout<<"addr invalida\n"; continue; 
+                rec.error("addr invalida"); continue; 
             }
             uint64_t cnt=8; 
             if (t.size()>=3) { 
                 uint64_t tmp; 
                 if (to_uint64(t[2], tmp)) cnt=tmp; 
             }
+            if (rec.json_mode()) {
+                Json& j = rec.json().val("addr", addr).arr("values");
+                for (uint64_t i=0; i<cnt; i++) j.item(sys.mem->load64(addr + i*8));
+                j.end();
+                continue;
+            }
             for (uint64_t i=0; i<cnt; i++) {
                 double v = sys.mem->load64(addr + i*8);
                 std::cout << "M[" << (addr/8 + i) << "] @0x" << std::hex << (addr+i*8) << std::dec
@@ -378,14 +882,24 @@ int main(int argc, char** argv) {
             }
         }
         else if (cmd=="cache") {
-            if (t.size()<2) { 
-                std::cout<<"Uso: cache <pe>\n"; continue; 
+            size_t lo = 0, hi = sys.l1.size();  // Sin pe: todas
+            if (t.size()>=2) {
+                int pe=-1; 
+                if (!to_int(t[1], pe) || pe<0 || pe>=int(sys.pes.size())) { 
+                    rec.error("pe invalido"); continue; 
+                }
+                lo = size_t(pe);
+                hi = lo + 1;
             }
-            int pe=-1; 
-            if (!to_int(t[1], pe) || pe<0 || pe>=int(sys.pes.size())) { 
-                std::cout<<"pe invalido\n"; continue; 
+            if (rec.json_mode()) {
+                Json& j = rec.json().arr("caches");
+                for (size_t i = lo; i < hi; ++i) json_cache(j, *sys.l1[i]);
+                j.end();
             }
-            sys.l1[pe]->dump_state(std::cout);
+            else for (size_t i = lo; i < hi; ++i) sys.l1[i]->dump_state(std::cout);
+        }
+        else if (cmd=="stats" && rec.json_mode()) {
+            json_stats(rec.json(), sys);
         }
         else if (cmd=="stats") {
             for (size_t i=0; i<sys.l1.size(); ++i) {
@@ -394,78 +908,204 @@ int main(int argc, char** argv) {
                           << " writes=" << s.write_ops
                           << " misses=" << s.misses
                           << " invalidations=" << s.invalidations
-                          << " bus_msgs=" << s.bus_msgs << "\n";
+                          << " bus_msgs=" << s.bus_msgs
+                          << " mshr_merges=" << s.mshr_merges
+                          << " fill_waits=" << s.fill_waits
+                          << " instrs=" << sys.pes[i]->stats.instrs
+                          << " load_use_stalls=" << sys.pes[i]->stats.load_use_stalls
+                          << " sb_full_stalls=" << sys.pes[i]->stats.sb_full_stalls
+                          << " sb_forwards=" << sys.pes[i]->stats.sb_forwards
+                          << " barrier_stalls=" << sys.pes[i]->stats.barrier_stalls << "\n";
+                if (sys.l1[i]->prefetcher())
+                    std::cout << "     prefetch(" << sys.l1[i]->prefetcher()->name() << "): issued=" << s.prefetches
+                              << " useful=" << s.prefetch_useful
+                              << " late=" << s.prefetch_late
+                              << " useless=" << s.prefetch_useless
+                              << " dropped=" << s.prefetch_dropped << "\n";
+                if (s.atomic_ops)
+                    std::cout << "     atomics: ops=" << s.atomic_ops
+                              << " bus=" << s.atomic_misses
+                              << " cas_fail=" << s.cas_failures
+                              << " sc_fail=" << s.sc_failures
+                              << " link_breaks=" << s.link_breaks << "\n";
+            }
+            print_imbalance(std::cout, sys.pes);
+            print_traffic(std::cout, coherence_traffic(sys.l1));
+            if (sys.l2) sys.l2->report(std::cout);
+            if (sys.numa) sys.numa->report(std::cout);
+            std::cout << "Sharing: true=" << sys.bus.sharing().true_sharing()
+                      << " false=" << sys.bus.sharing().false_sharing() << "\n";
+        }
+        else if (cmd=="l2") {
+            if (!sys.l2) { rec.error("Sin L2 (arrancar con -l2=inclusive|noninclusive[:lineas[:vias[:bancos]]])"); continue; }
+            sys.l2->report(std::cout);
+        }
+        else if (cmd=="numa") {
+            if (sys.numa) sys.numa->report(std::cout);
+            if (!prog) { rec.error("Sin programa cargado"); continue; }
+            // Mismo programa con cada ubicacion, en sistemas aparte
+            const NumaConfig base = sys.numa ? sys.numa->config() : NumaConfig{};
+            std::cout << "Ubicaciones (" << base.nodes << " nodos, latencia " << base.local << "/"
+                      << base.remote << ", ocupacion " << base.local_occ << "/" << base.remote_occ << "):\n";
+            for (NumaPlacement pl : {NumaPlacement::Local, NumaPlacement::Interleave, NumaPlacement::Node0}) {
+                const NumaStats t = numa_with(num_pes, N, prog, part, base, pl);
+                std::cout << "  " << std::left << std::setw(10) << placement_name(pl) << std::right
+                          << " tiempo de memoria=" << t.cycles << " ciclos, remotos " << t.remote()
+                          << "/" << t.total() << ", en cola=" << t.queued << "\n";
+            }
+        }
+        else if (cmd=="misses") {
+            print_misses(std::cout, sys.l1, dot_layout(N, num_pes, part));
+        }
+        else if (cmd=="sharing") {
+            int k = 5;
+            if (t.size()>1 && (!to_int(t[1], k) || k<0)) { rec.error("Uso: sharing [K]"); continue; }
+            sys.bus.sharing().report(std::cout, size_t(k), [&sys](uint32_t a) { return sys.shm->owner_segment(a); });
+        }
+        else if (cmd=="layout") {
+            // Mismo programa y reparto con ambos layouts, en sistemas aparte
+            for (Layout l : {Layout::Packed, Layout::Padded}) {
+                PartitionConfig c = part;
+                c.layout = l;
+                print_layout(std::cout, N, num_pes, c);
+            }
+            if (!prog) { rec.error("Sin programa cargado"); continue; }
+            print_traffic_delta(std::cout, traffic_with(num_pes, N, prog, part, Layout::Packed),
+                                traffic_with(num_pes, N, prog, part, Layout::Padded));
+        }
+        else if (cmd=="prefetch") {
+            if (t.size()<2) {
+                rec.error("Uso: prefetch <none|next|stride> [grado] [dist]"); continue;
+            }
+            PrefetchConfig cfg;
+            if ((t.size()>2 && (!to_int(t[2], cfg.degree) || cfg.degree<1)) ||
+                (t.size()>3 && (!to_int(t[3], cfg.distance) || cfg.distance<1))) {
+                rec.error("grado/dist invalidos"); continue;
+            }
+            if (t[1]!="none" && !make_prefetcher(t[1], cfg)) {
+                rec.error("prefetcher desconocido"); continue;
             }
+            for (auto& c : sys.l1) c->set_prefetcher(make_prefetcher(t[1], cfg));
+            if (hist) hist->clear();  // Los deltas no deshacen el cambio de prefetcher
+            std::cout << "Prefetcher " << t[1] << " (grado=" << cfg.degree
+                      << ", dist=" << cfg.distance << ")\n";
         }
         else if (cmd=="break" || cmd=="b") {
             if (t.size()<3) { 
-                std::cout<<"Uso: break <pe> <pc>\n"; continue; 
+                rec.error("Uso: break <pe> <pc>"); continue; 
             }
             int pe=-1, pc=-1;
             if (!to_int(t[1], pe) || pe<0 || pe>=int(sys.pes.size())) { 
-                std::cout<<"pe invalido\n"; continue; 
+                rec.error("pe invalido"); continue; 
             }
             if (!to_int(t[2], pc) || pc<0) { 
-                std::cout<<"pc invalido\n"; continue; 
+                rec.error("pc invalido"); continue; 
             }
-            breaks.insert(Breakpoint{pe, pc});
+            breaks.set(pe, pc);
             std::cout << "breakpoint anadido en PE" << pe << " PC=" << pc << "\n";
         }
         else if (cmd=="breaks") {
             if (breaks.empty()) {
                 std::cout << "No hay breakpoints activos\n";
             } else {
-                for (auto const& b : breaks) 
-                    std::cout << "  PE" << b.pe_id << " PC=" << b.pc << "\n";
+                breaks.list(std::cout);
             }
         }
         else if (cmd=="clear") {
             if (t.size()<3) { 
-                std::cout<<"Uso: clear <pe> <pc>\n"; continue; 
+                rec.error("Uso: clear <pe> <pc>"); continue; 
             }
             int pe=-1, pc=-1;
-            if (!to_int(t[1], pe) || !to_int(t[2], pc)) { 
-                std::cout<<"args invalidos\n"; continue; 
+            if (!to_int(t[1], pe) || !to_int(t[2], pc) || pe<0 || pe>=int(sys.pes.size())) { 
+                rec.error("args invalidos"); continue; 
             }
-            breaks.erase(Breakpoint{pe, pc});
-            std::cout << "breakpoint eliminado\n";
+            std::cout << (breaks.clear(pe, pc) ? "breakpoint eliminado\n" : "no habia breakpoint ahi\n");
+        }
+        else if (cmd=="watch" || cmd=="w") {
+            WatchKind k;
+            uint64_t addr=0, bytes=0;
+            if (t.size()<3 || !parse_watch_kind(t[1], k) || !to_uint64(t[2], addr) ||
+                (t.size()>3 && (!to_uint64(t[3], bytes) || bytes==0))) {
+                rec.error("Uso: watch <r|w|rw|mesi> <addr> [bytes]"); continue;
+            }
+            if (!bytes) bytes = k==WatchKind::Mesi ? hw::kBlockBytes : 8;
+            watches.add(k, addr, addr + bytes);
+            std::cout << "watchpoint anadido:\n";
+            print_watchpoint(std::cout, watches.list().back());
+        }
+        else if (cmd=="watches") {
+            if (watches.empty()) std::cout << "No hay watchpoints activos\n";
+            for (const Watchpoint& w : watches.list()) print_watchpoint(std::cout, w);
+        }
+        else if (cmd=="unwatch") {
+            int id=0;
+            if (t.size()<2 || !to_int(t[1], id)) { rec.error("Uso: unwatch <id>"); continue; }
+            std::cout << (watches.remove(id) ? "watchpoint eliminado\n" : "no existe ese watchpoint\n");
+        }
+        else if (cmd=="rstep" || cmd=="rs") {
+            uint64_t n = 1;
+            if (t.size()>=2 && !to_uint64(t[1], n)) { rec.error("Uso: rstep [N]"); continue; }
+            if (!hist) { rec.error("Historial apagado (history on)"); continue; }
+            const uint64_t done = hist->back(n);
+            if (rec.json_mode()) {
+                rec.json().val("undone", done).val("step", hist->steps()).val("oldest", hist->oldest());
+                json_pcs(rec.json(), sys.pes);
+                continue;
+            }
+            std::cout << done << " instrucciones atras; paso " << hist->steps()
+                      << " (se puede volver hasta el " << hist->oldest() << ")\n";
+            for (auto& p : sys.pes)
+                std::cout << "[PE" << p->pe_id() << "] PC=" << p->get_pc() << " HALT=" << p->is_halted()
+                          << (p->at_barrier() ? " (BARRIER)" : "") << "\n";
+        }
+        else if (cmd=="history") {
+            if (t.size()>=2 && t[1]=="off") hist.reset();
+            else if (t.size()>=2 && t[1]=="on") {
+                if (!hist) hist = std::make_unique<UndoLog>(sys.pes, sys.l1, *sys.shm, sys.barrier, sys.l2.get(), sys.numa.get());
+            }
+            else if (t.size()>=2) { rec.error("Uso: history [on|off]"); continue; }
+            if (!hist) { std::cout << "Historial apagado\n"; continue; }
+            std::cout << "Historial: paso " << hist->steps() << ", se puede volver hasta el " << hist->oldest()
+                      << "; " << hist->deltas() << " deltas (" << hist->delta_bytes() / 1024 << " KB), "
+                      << hist->checkpoints() << " checkpoints\n";
         }
         else if (cmd=="status" || cmd=="st") {
             std::cout << "Estado de todos los PEs:\n";
             for (auto& p : sys.pes) {
                 std::cout << "[PE" << p->pe_id() << "] PC=" << p->get_pc() 
                         << " HALT=" << p->is_halted() 
-                        << " Program Size=" << /* necesitamos exponer el tamano del programa */ "?\n";
+                        << " Program Size=" << p->program_size() << "\n";
                 p->dump_regs();
             }
         }
         else if (cmd=="run" || cmd=="r") {
-            std::cout << "Ejecutando programa..." << std::endl;
-            
-            int max_steps = 10000;
-            int steps = 0;
-            while (any_running(sys.pes) && steps < max_steps) {
-                for (auto& p : sys.pes) {
-                    if (!p->is_halted()) p->step();
-                }
-                steps++;
-            }
-            
-            if (steps >= max_steps) {
-                std::cout << "ALERTA: Limite de pasos alcanzado" << std::endl;
-            } else {
-                std::cout << "Ejecucion completada en " << steps << " pasos" << std::endl;
-            }
-            
-            show_final_results(sys, N);
+            uint64_t budget = 0; // Instrucciones (0 = sin limite)
+            if (t.size()>=2 && !to_uint64(t[1], budget)) { rec.error("Uso: run [instrucciones]"); continue; }
+            if (!rec.json_mode()) std::cout << "Ejecutando programa..." << std::endl;
+
+            // Sin tope de pasos ni breakpoints: solo HALT o el presupuesto
+            const RunResult r = run_fast(sys.pes, BreakMap(sys.pes.size()), budget);
+            if (hist) hist->clear();  // Sin grabar: rstep no cruza un run
+            if (rec.json_mode()) { json_run(rec.json(), r, sys.pes); continue; }
+            if (!any_running(sys.pes)) std::cout << "Ejecucion completada en " << r.rounds << " pasos" << std::endl;
+            print_run(std::cout, r);
+
+            if (!any_running(sys.pes)) show_final_results(sys, N);
         }
         else {
-            std::cout << "Comando desconocido. Escriba 'help'.\n";
+            rec.error("Comando desconocido. Escriba 'help'.");
         }
     }
 
+    // Con -json, el ultimo objeto: resultados y estadisticas (hace flush)
+    if (json) {
+        CommandOutput rec(true, json_out, {"results"}, errors);
+        json_results(rec.json(), sys, N);
+        return batch_mode && errors ? 1 : 0;
+    }
+
     // Flush de todas las caches antes de salir
     for (auto& c : sys.l1) c->flush_all();
-    std::cout << "Saliendo del stepper...\n";
-    return 0;
+    if (!batch_mode) std::cout << "Saliendo del stepper...\n";
+    return batch_mode && errors ? 1 : 0;
 }
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "timeline.h"
+#include <algorithm>
+
+const char* series_name(Series s) {
+    switch (s) {
+        case Series::HitRate:            return "Hit rate (%)";
+        case Series::Mpki:               return "Fallos / 1k instr.";
+        case Series::BusPerRound:        return "Bus / ronda";
+        case Series::WritebacksPerRound: return "Write-backs / ronda";
+        case Series::QueueDepth:         return "Cola de memoria";
+    }
+    return "?";
+}
+
+void Timeline::reset(size_t num_pes) {
+    global_ = Track{};
+    pes_.assign(num_pes, Track{});
+    last_rounds_ = 0;
+}
+
+Timeline::Totals Timeline::totals(const PE& pe, const Cache& c) {
+    const Stats& st = c.stats();
+    return {pe.stats.instrs, st.read_ops + st.write_ops + st.atomic_ops, st.misses, st.bus_msgs, st.writebacks};
+}
+
+void Timeline::push(Track& t, const Totals& now, uint64_t rounds) {
+    const Totals& b = t.last;
+    const uint64_t acc = now.accesses - b.accesses, miss = now.misses - b.misses, ins = now.instrs - b.instrs;
+    Ring& hit = t.s[size_t(Series::HitRate)];
+    // Sin accesos en el intervalo se repite el valor anterior (PE en barrera o en HALT)
+    hit.push(acc ? std::clamp(100.0f * (1.0f - float(miss) / float(acc)), 0.0f, 100.0f)
+                 : hit.size() ? hit.back() : 100.0f);
+    t.s[size_t(Series::Mpki)].push(ins ? 1000.0f * float(miss) / float(ins) : 0.0f);
+    t.s[size_t(Series::BusPerRound)].push(float(now.bus - b.bus) / float(rounds));
+    t.s[size_t(Series::WritebacksPerRound)].push(float(now.writebacks - b.writebacks) / float(rounds));
+    t.last = now;
+}
+
+void Timeline::sample(const std::vector<std::unique_ptr<PE>>& pes,
+                      const std::vector<std::unique_ptr<Cache>>& caches, SharedMemory& shm, uint64_t rounds) {
+    if (rounds <= last_rounds_) return;
+    const uint64_t dr = rounds - last_rounds_;
+    last_rounds_ = rounds;
+    Totals sum;
+    for (size_t p = 0; p < pes_.size() && p < pes.size(); ++p) {
+        const Totals t = totals(*pes[p], *caches[p]);
+        push(pes_[p], t, dr);
+        sum.instrs += t.instrs;
+        sum.accesses += t.accesses;
+        sum.misses += t.misses;
+        sum.bus += t.bus;
+        sum.writebacks += t.writebacks;
+    }
+    push(global_, sum, dr);
+    global_.s[size_t(Series::QueueDepth)].push(float(shm.take_peak_depth()));
+}
+
+void Timeline::rebase(const std::vector<std::unique_ptr<PE>>& pes,
+                      const std::vector<std::unique_ptr<Cache>>& caches, uint64_t rounds) {
+    last_rounds_ = rounds;
+    Totals sum;
+    for (size_t p = 0; p < pes_.size() && p < pes.size(); ++p) {
+        pes_[p].last = totals(*pes[p], *caches[p]);
+        sum.instrs += pes_[p].last.instrs;
+        sum.accesses += pes_[p].last.accesses;
+        sum.misses += pes_[p].last.misses;
+        sum.bus += pes_[p].last.bus;
+        sum.writebacks += pes_[p].last.writebacks;
+    }
+    global_.last = sum;
+}
+
+const Timeline::Ring& Timeline::series(int pe, Series s) const {
+    const Track& t = pe < 0 ? global_ : pes_.at(pe);
+    return t.s[size_t(s)];
+}
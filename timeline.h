@@ -0,0 +1,79 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "cache.hpp"
+#include "pe.h"
+#include "shared_memory.h"
+
+// ANILLO DE MUESTRAS - capacidad fija; lleno, cada muestra nueva pisa la mas vieja
+template <size_t Cap>
+class SampleRing {
+public:
+    void push(float v) {
+        buf_[head_] = v;
+        head_ = (head_ + 1) % Cap;
+        if (size_ < Cap) ++size_;
+    }
+    size_t size() const { return size_; }
+    float back() const { return buf_[(head_ + Cap - 1) % Cap]; }  // Requiere size() > 0
+    // De la mas vieja a la mas nueva (el orden que espera ImGui::PlotLines)
+    void copy_to(std::vector<float>& out) const {
+        out.resize(size_);
+        const size_t first = (head_ + Cap - size_) % Cap;
+        for (size_t i = 0; i < size_; ++i) out[i] = buf_[(first + i) % Cap];
+    }
+
+private:
+    std::array<float, Cap> buf_{};
+    size_t head_ = 0, size_ = 0;
+};
+
+// SERIES DE LA LINEA DE TIEMPO - por muestra (deltas desde la anterior)
+//   hit rate     % de accesos de demanda que acertaron
+//   MPKI         fallos por cada 1000 instrucciones
+//   bus          mensajes de bus por ronda
+//   write-backs  write-backs por ronda
+//   cola memoria pico de pedidos en cola de SharedMemory (solo global)
+enum class Series : uint8_t { HitRate, Mpki, BusPerRound, WritebacksPerRound, QueueDepth };
+constexpr size_t kSeries = 5;
+const char* series_name(Series s);
+
+// LINEA DE TIEMPO - la muestrea el hilo de simulacion cada tantas rondas, con
+// los PEs detenidos. Una pista global y una por PE
+class Timeline {
+public:
+    static constexpr size_t kSamples = 512;
+    using Ring = SampleRing<kSamples>;
+
+    void reset(size_t num_pes);
+    // Sin rondas nuevas desde la muestra anterior no agrega nada
+    void sample(const std::vector<std::unique_ptr<PE>>& pes,
+                const std::vector<std::unique_ptr<Cache>>& caches, SharedMemory& shm, uint64_t rounds);
+    // Tras un paso atras: las muestras quedan y la siguiente se mide desde aca
+    void rebase(const std::vector<std::unique_ptr<PE>>& pes,
+                const std::vector<std::unique_ptr<Cache>>& caches, uint64_t rounds);
+    const Ring& series(int pe, Series s) const;  // pe = -1: global
+    size_t num_pes() const { return pes_.size(); }
+
+private:
+    struct Totals {
+        uint64_t instrs = 0, accesses = 0, misses = 0, bus = 0, writebacks = 0;
+    };
+    struct Track {
+        std::array<Ring, kSeries> s;
+        Totals last;  // Contadores acumulados en la muestra anterior
+    };
+    static Totals totals(const PE& pe, const Cache& c);
+    static void push(Track& t, const Totals& now, uint64_t rounds);
+
+    Track global_;
+    std::vector<Track> pes_;
+    uint64_t last_rounds_ = 0;
+};
+
+#endif
@@ -0,0 +1,298 @@
+// undo.cpp
+#include "undo.hpp"
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+
+constexpr uint32_t kLines = hw::kSets * hw::kWays;
+constexpr size_t kPrefetcherBytes = 2048;  // Estimacion (tabla stride)
+
+bool same_line(const CacheLine& a, const CacheLine& b) {
+    return a.state == b.state && a.tag == b.tag && a.recent == b.recent && a.pending == b.pending &&
+           a.fill_state == b.fill_state && a.prefetched == b.prefetched && a.data == b.data;
+}
+
+bool same_mshrs(const Cache::Mshrs& a, const Cache::Mshrs& b) {
+    for (size_t i = 0; i < a.size(); ++i) {
+        const Cache::Mshr& x = a[i];
+        const Cache::Mshr& y = b[i];
+        if (x.valid != y.valid || x.gen != y.gen || x.seq != y.seq) return false;
+        if (x.valid && (x.prefetch != y.prefetch || x.targets != y.targets)) return false;
+    }
+    return true;
+}
+
+bool same_barrier(const Barrier::State& a, const Barrier::State& b) {
+    return a.parties == b.parties && a.arrived == b.arrived && a.generation == b.generation;
+}
+
+} // namespace
+
+// Deltas por palabra de 8 bytes: registros escritos, contadores cambiados...
+template <class T, class P>
+static void diff_words(const T& before, const T& after, uint32_t obj, std::vector<P>& out) {
+    static_assert(std::is_trivially_copyable<T>::value && sizeof(T) % 8 == 0, "Objeto comparable por palabras");
+    const auto* a = reinterpret_cast<const unsigned char*>(&before);
+    const auto* b = reinterpret_cast<const unsigned char*>(&after);
+    for (uint32_t w = 0; w < sizeof(T) / 8; ++w) {
+        uint64_t x, y;
+        std::memcpy(&x, a + 8 * w, 8);
+        std::memcpy(&y, b + 8 * w, 8);
+        if (x != y) out.push_back(P{obj, w, x});
+    }
+}
+
+template <class T, class P>
+static void apply_words(T& x, const P* first, const P* last) {
+    auto* bytes = reinterpret_cast<unsigned char*>(&x);
+    for (const P* p = first; p != last; ++p) std::memcpy(bytes + 8 * p->word, &p->old, 8);
+}
+
+UndoLog::UndoLog(std::vector<std::unique_ptr<PE>>& pes, std::vector<std::unique_ptr<Cache>>& l1,
+                 SharedMemory& shm, Barrier& barrier, L2Cache* l2, NumaMemory* numa, UndoConfig cfg)
+    : pes_(pes), l1_(l1), shm_(shm), barrier_(barrier), l2_(l2), numa_(numa), cfg_(cfg) {
+    if (cfg_.checkpoint_every == 0) cfg_.checkpoint_every = 1;
+    if (cfg_.max_checkpoints == 0) cfg_.max_checkpoints = 1;
+    sync_shadows();
+}
+
+void UndoLog::sync_shadows() {
+    lines_.resize(l1_.size());
+    pf_.resize(l1_.size());
+    cores_.resize(l1_.size());
+    miss_journal_.resize(l1_.size());
+    for (size_t i = 0; i < l1_.size(); ++i) {
+        l1_[i]->save_core(cores_[i]);
+        lines_[i].resize(kLines);
+        for (uint32_t k = 0; k < kLines; ++k) lines_[i][k] = l1_[i]->line_at(k / hw::kWays, k % hw::kWays);
+        pf_[i] = l1_[i]->prefetcher() ? l1_[i]->prefetcher()->clone() : nullptr;
+    }
+}
+
+void UndoLog::clear() {
+    deltas_.clear();
+    ckpts_.clear();
+    sched_.clear();
+    steps_ = sched_base_ = 0;
+    bytes_ = 0;
+    sync_shadows();
+}
+
+uint64_t UndoLog::oldest() const {
+    const uint64_t first_delta = steps_ - deltas_.size();
+    return ckpts_.empty() ? first_delta : std::min(first_delta, ckpts_.front().step);
+}
+
+void UndoLog::step(int p, bool group) {
+    if (steps_ % cfg_.checkpoint_every == 0 && (ckpts_.empty() || ckpts_.back().step != steps_))
+        take_checkpoint();
+
+    PE& pe = *pes_[p];
+    Cache& cache = *l1_[p];
+    pe.save_state(pe_before_);
+    const uint64_t bus = cache.stats().bus_msgs;
+    mshrs_before_ = cache.mshrs();
+    const Barrier::State bar = barrier_.state();
+
+    // Las escrituras a memoria son sincronas: al volver, el diario esta completo
+    shm_.set_journal(&journal_);
+    if (l2_) l2_->set_journal(&l2_journal_);
+    if (numa_) numa_->set_journal(&numa_journal_);
+    for (size_t i = 0; i < l1_.size(); ++i) l1_[i]->set_miss_journal(&miss_journal_[i]);
+    pe.step();
+    for (auto& c : l1_) c->set_miss_journal(nullptr);
+    if (numa_) numa_->set_journal(nullptr);
+    if (l2_) l2_->set_journal(nullptr);
+    shm_.set_journal(nullptr);
+
+    // Se arma en scratch_ (conserva la capacidad) y el delta guardado se
+    // copia con el tamano justo: una reserva por vector no vacio
+    Delta& s = scratch_;
+    s.pe_words.clear();
+    s.core_words.clear();
+    s.lines.clear();
+    s.misses.clear();
+    pe.save_state(pe_after_);
+    diff_words(pe_before_, pe_after_, 0, s.pe_words);
+    // Las demas caches solo cambian por snoops, y todo mensaje al bus lo cuenta
+    // la cache que lo emite
+    const bool snooped = cache.stats().bus_msgs != bus;
+    for (size_t i = 0; i < l1_.size(); ++i) {
+        if (int(i) != p && !snooped) continue;
+        l1_[i]->save_core(core_after_);
+        diff_words(cores_[i], core_after_, uint32_t(i), s.core_words);
+        cores_[i] = core_after_;
+        for (uint32_t k = 0; k < kLines; ++k) {
+            const CacheLine& now = l1_[i]->line_at(k / hw::kWays, k % hw::kWays);
+            if (same_line(now, lines_[i][k])) continue;
+            s.lines.push_back(LinePatch{uint32_t(i), k, lines_[i][k]});
+            lines_[i][k] = now;
+        }
+        for (const MissUndo& u : miss_journal_[i]) s.misses.emplace_back(uint32_t(i), u);
+        miss_journal_[i].clear();
+    }
+
+    Delta d;
+    d.pe = p;
+    d.pe_words.assign(s.pe_words.begin(), s.pe_words.end());
+    d.core_words.assign(s.core_words.begin(), s.core_words.end());
+    d.lines.assign(s.lines.begin(), s.lines.end());
+    d.misses.assign(s.misses.begin(), s.misses.end());
+    d.mem.assign(journal_.begin(), journal_.end());
+    journal_.clear();
+    d.l2.assign(l2_journal_.begin(), l2_journal_.end());
+    l2_journal_.clear();
+    d.numa.assign(numa_journal_.begin(), numa_journal_.end());
+    numa_journal_.clear();
+    if (!same_mshrs(mshrs_before_, cache.mshrs())) d.mshrs = std::make_unique<Cache::Mshrs>(mshrs_before_);
+    if (cache.prefetcher() && pf_[p] && !cache.prefetcher()->same_state(*pf_[p])) {
+        d.prefetcher = std::move(pf_[p]);
+        pf_[p] = cache.prefetcher()->clone();
+    }
+    const Barrier::State bar_now = barrier_.state();
+    if (!same_barrier(bar, bar_now)) {
+        d.barrier_changed = true;
+        d.barrier = bar;
+    }
+
+    d.bytes = sizeof(Delta) + (d.pe_words.size() + d.core_words.size()) * sizeof(Patch) +
+              d.lines.size() * sizeof(LinePatch) + d.misses.size() * sizeof(d.misses[0]) + d.mem.size() * sizeof(d.mem[0]) +
+              d.l2.size() * sizeof(L2Undo) + d.numa.size() * sizeof(NumaUndo) +
+              (d.mshrs ? sizeof(Cache::Mshrs) : 0) + (d.prefetcher ? kPrefetcherBytes : 0);
+    bytes_ += d.bytes;
+    deltas_.push_back(std::move(d));
+    sched_.push_back(uint16_t(p) | (group ? kGroup : 0));
+    steps_++;
+    trim();
+}
+
+void UndoLog::trim() {
+    while (bytes_ > cfg_.max_bytes && !deltas_.empty()) {
+        bytes_ -= deltas_.front().bytes;
+        deltas_.pop_front();
+    }
+    while (ckpts_.size() > cfg_.max_checkpoints) ckpts_.pop_front();
+    for (const uint64_t first = oldest(); sched_base_ < first; ++sched_base_) sched_.pop_front();
+}
+
+uint64_t UndoLog::back(uint64_t n) {
+    const uint64_t from = steps_;
+    rewind(n >= steps_ - oldest() ? oldest() : steps_ - n);
+    return from - steps_;
+}
+
+uint64_t UndoLog::back_group() {
+    const uint64_t first = oldest();
+    if (steps_ == first) return 0;
+    uint64_t t = steps_ - 1;
+    while (t > first && !(sched_[t - sched_base_] & kGroup)) --t;
+    if (!(sched_[t - sched_base_] & kGroup)) return 0;  // El grupo empieza antes del historial
+    const uint64_t from = steps_;
+    rewind(t);
+    return from - steps_;
+}
+
+void UndoLog::rewind(uint64_t target) {
+    if (target >= steps_) return;
+    for (auto& c : l1_) c->wait_fills();  // Sin lecturas de memoria en vuelo
+
+    if (target >= steps_ - deltas_.size()) {
+        while (steps_ > target) undo_last();
+        sched_.resize(steps_ - sched_base_);
+        while (!ckpts_.empty() && ckpts_.back().step > steps_) ckpts_.pop_back();
+        return;
+    }
+
+    // Mas atras que los deltas: el checkpoint mas nuevo que no pase de target
+    // y re-ejecutar (grabando) los pasos que faltan
+    size_t k = ckpts_.size();
+    while (k > 1 && ckpts_[k - 1].step > target) --k;
+    const Checkpoint& c = ckpts_[k - 1];
+    const std::vector<uint16_t> replay(sched_.begin() + (c.step - sched_base_), sched_.begin() + (target - sched_base_));
+    restore(c);
+    steps_ = c.step;
+    deltas_.clear();
+    bytes_ = 0;
+    sched_.resize(steps_ - sched_base_);
+    ckpts_.resize(k);
+    for (uint16_t s : replay) step(s & ~kGroup, s & kGroup);
+}
+
+void UndoLog::undo_last() {
+    Delta& d = deltas_.back();
+    pes_[d.pe]->save_state(pe_after_);
+    apply_words(pe_after_, d.pe_words.data(), d.pe_words.data() + d.pe_words.size());
+    pes_[d.pe]->restore_state(pe_after_);
+
+    // core_words viene agrupado por cache
+    for (size_t a = 0; a < d.core_words.size(); ) {
+        size_t b = a;
+        const uint32_t i = d.core_words[a].obj;
+        while (b < d.core_words.size() && d.core_words[b].obj == i) ++b;
+        l1_[i]->save_core(core_after_);
+        apply_words(core_after_, d.core_words.data() + a, d.core_words.data() + b);
+        l1_[i]->restore_core(core_after_);
+        cores_[i] = core_after_;
+        a = b;
+    }
+    for (auto it = d.misses.rbegin(); it != d.misses.rend(); ++it) l1_[it->first]->undo_miss(it->second);
+    for (const LinePatch& lp : d.lines) {
+        l1_[lp.cache]->restore_line(lp.idx / hw::kWays, lp.idx % hw::kWays, lp.old);
+        lines_[lp.cache][lp.idx] = lp.old;
+    }
+    if (d.mshrs) l1_[d.pe]->restore_mshrs(*d.mshrs);
+    if (d.prefetcher) {
+        pf_[d.pe] = d.prefetcher->clone();
+        l1_[d.pe]->set_prefetcher(std::move(d.prefetcher));
+    }
+    if (d.barrier_changed) barrier_.restore(d.barrier);
+    for (auto it = d.mem.rbegin(); it != d.mem.rend(); ++it) shm_.poke_word(it->first, it->second);
+    for (auto it = d.l2.rbegin(); it != d.l2.rend(); ++it) l2_->undo(*it);
+    for (auto it = d.numa.rbegin(); it != d.numa.rend(); ++it) numa_->undo(*it);
+
+    bytes_ -= d.bytes;
+    deltas_.pop_back();
+    steps_--;
+}
+
+void UndoLog::take_checkpoint() {
+    Checkpoint c;
+    c.step = steps_;
+    c.pes.resize(pes_.size());
+    for (size_t p = 0; p < pes_.size(); ++p) pes_[p]->save_state(c.pes[p]);
+    c.cores.resize(l1_.size());
+    c.mshrs.resize(l1_.size());
+    c.misses.resize(l1_.size());
+    for (size_t i = 0; i < l1_.size(); ++i) {
+        l1_[i]->save_core(c.cores[i]);
+        c.mshrs[i] = l1_[i]->mshrs();
+        l1_[i]->save_misses(c.misses[i]);
+        c.prefetchers.push_back(l1_[i]->prefetcher() ? l1_[i]->prefetcher()->clone() : nullptr);
+    }
+    c.lines = lines_;  // Las sombras estan al dia entre pasos
+    c.barrier = barrier_.state();
+    c.mem.resize(shm_.size_words());
+    for (uint32_t w = 0; w < c.mem.size(); ++w) c.mem[w] = shm_.peek_word(w);
+    if (l2_) l2_->save(c.l2);
+    if (numa_) numa_->save(c.numa);
+    ckpts_.push_back(std::move(c));
+}
+
+void UndoLog::restore(const Checkpoint& c) {
+    for (size_t p = 0; p < pes_.size(); ++p) pes_[p]->restore_state(c.pes[p]);
+    for (size_t i = 0; i < l1_.size(); ++i) {
+        l1_[i]->restore_core(c.cores[i]);
+        l1_[i]->restore_mshrs(c.mshrs[i]);
+        l1_[i]->restore_misses(c.misses[i]);
+        for (uint32_t k = 0; k < kLines; ++k) l1_[i]->restore_line(k / hw::kWays, k % hw::kWays, c.lines[i][k]);
+        l1_[i]->set_prefetcher(c.prefetchers[i] ? c.prefetchers[i]->clone() : nullptr);
+    }
+    barrier_.restore(c.barrier);
+    for (uint32_t w = 0; w < c.mem.size(); ++w)
+        if (shm_.peek_word(w) != c.mem[w]) shm_.poke_word(w, c.mem[w]);
+    if (l2_) l2_->restore(c.l2);
+    if (numa_) numa_->restore(c.numa);
+    sync_shadows();
+}
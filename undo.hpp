@@ -0,0 +1,133 @@
+// undo.hpp
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "barrier.h"
+#include "cache.hpp"
+#include "l2_cache.hpp"
+#include "numa.hpp"
+#include "pe.h"
+#include "shared_memory.h"
+
+// HISTORIAL PARA PASO ATRAS - cada paso de un PE se graba como un delta con
+// el valor anterior de solo lo que cambio:
+//   PE        palabras de PE::State (registros, PC, store buffer, scoreboard)
+//   caches    lineas (estado, tag, datos), palabras de Cache::Core, el diario
+//             del clasificador de fallos y, en la cache del PE, los MSHRs y
+//             el prefetcher si cambiaron
+//   memoria   palabras escritas (diario del worker de SharedMemory)
+//   L2        lineas que cambio (diario de L2Cache), si hay L2
+//   NUMA      palabras del modelo de tiempo y contadores (diario de NumaMemory)
+//   barrera   Barrier::State si cambio
+// Los deltas se acotan por bytes (se descartan los mas viejos) y cada
+// checkpoint_every pasos se toma un checkpoint completo: retroceder mas alla
+// de los deltas restaura el checkpoint anterior y re-ejecuta hacia adelante
+// (paso a paso la simulacion es determinista). Retroceder descarta el futuro.
+// No retroceden los contadores por bloque (heat), el detector de sharing, el
+// trafico de memoria ni los contadores de la L2. Todo con los PEs detenidos (un solo hilo da los pasos)
+struct UndoConfig {
+    size_t max_bytes = size_t(64) << 20;  // Deltas (los checkpoints van aparte)
+    uint64_t checkpoint_every = 1 << 16;  // Pasos entre checkpoints
+    size_t max_checkpoints = 4;
+};
+
+class UndoLog {
+public:
+    UndoLog(std::vector<std::unique_ptr<PE>>& pes, std::vector<std::unique_ptr<Cache>>& l1,
+            SharedMemory& shm, Barrier& barrier, L2Cache* l2 = nullptr, NumaMemory* numa = nullptr,
+            UndoConfig cfg = {});
+    UndoLog(const UndoLog&) = delete;
+    UndoLog& operator=(const UndoLog&) = delete;
+
+    // Un paso grabado de pes[pe], en lugar de pes[pe]->step(). group: abre un
+    // grupo que back_group() deshace entero (la GUI agrupa por ronda)
+    void step(int pe, bool group = true);
+    uint64_t back(uint64_t n);  // Deshace hasta n pasos; devuelve cuantos
+    uint64_t back_group();      // Deshace el ultimo grupo; devuelve los pasos
+    void clear();               // El estado actual pasa a ser el origen
+
+    uint64_t steps() const { return steps_; }  // Pasos grabados desde el origen
+    uint64_t oldest() const;                   // Primer paso al que se puede volver
+    size_t deltas() const { return deltas_.size(); }
+    size_t delta_bytes() const { return bytes_; }
+    size_t checkpoints() const { return ckpts_.size(); }
+
+private:
+    static constexpr uint16_t kGroup = 0x8000;  // En sched_: el paso abre un grupo
+
+    struct Patch {  // Palabra de 8 bytes de un objeto trivialmente copiable
+        uint32_t obj, word;
+        uint64_t old;
+    };
+    struct LinePatch {
+        uint32_t cache, idx;  // idx = set * kWays + via
+        CacheLine old;
+    };
+    struct Delta {
+        int pe = 0;
+        std::vector<Patch> pe_words, core_words;  // core_words: obj = cache
+        std::vector<LinePatch> lines;
+        std::vector<std::pair<uint32_t, MissUndo>> misses;  // (cache, cambio), en orden
+        std::unique_ptr<Cache::Mshrs> mshrs;      // Antes del paso, si cambiaron
+        std::unique_ptr<Prefetcher> prefetcher;   // Idem
+        bool barrier_changed = false;
+        Barrier::State barrier;
+        SharedMemory::Journal mem;                // (palabra, valor anterior)
+        std::vector<L2Undo> l2;                   // En orden
+        std::vector<NumaUndo> numa;               // Idem
+        size_t bytes = 0;
+    };
+    struct Checkpoint {
+        uint64_t step = 0;
+        std::vector<PE::State> pes;
+        std::vector<Cache::Core> cores;
+        std::vector<std::vector<CacheLine>> lines;
+        std::vector<Cache::Mshrs> mshrs;
+        std::vector<Cache::Misses::State> misses;
+        std::vector<std::unique_ptr<Prefetcher>> prefetchers;
+        Barrier::State barrier;
+        std::vector<uint64_t> mem;
+        L2Cache::State l2;
+        NumaMemory::State numa;
+    };
+
+    void rewind(uint64_t target);
+    void undo_last();
+    void take_checkpoint();
+    void restore(const Checkpoint& c);
+    void sync_shadows();
+    void trim();
+
+    std::vector<std::unique_ptr<PE>>& pes_;
+    std::vector<std::unique_ptr<Cache>>& l1_;
+    SharedMemory& shm_;
+    Barrier& barrier_;
+    L2Cache* l2_;
+    NumaMemory* numa_;
+    UndoConfig cfg_;
+
+    uint64_t steps_ = 0;
+    std::deque<Delta> deltas_;     // Deshacen los pasos [steps_ - deltas_.size(), steps_)
+    size_t bytes_ = 0;
+    std::deque<Checkpoint> ckpts_;
+    std::deque<uint16_t> sched_;   // PE de cada paso desde sched_base_ (para re-ejecutar)
+    uint64_t sched_base_ = 0;
+
+    // Sombras del estado actual (lo anterior a cada paso sin copiar todo)
+    std::vector<std::vector<CacheLine>> lines_;
+    std::vector<Cache::Core> cores_;
+    std::vector<std::unique_ptr<Prefetcher>> pf_;
+    // Auxiliares de cada paso
+    PE::State pe_before_{}, pe_after_{};
+    Cache::Core core_after_{};
+    Cache::Mshrs mshrs_before_;
+    SharedMemory::Journal journal_;
+    std::vector<std::vector<MissUndo>> miss_journal_;  // Uno por cache
+    std::vector<L2Undo> l2_journal_;
+    std::vector<NumaUndo> numa_journal_;
+    Delta scratch_;
+};
@@ -0,0 +1,101 @@
+// watch.cpp
+#include "watch.hpp"
+#include "cache.hpp"
+#include <iostream>
+#include <sstream>
+
+const char* watch_kind_str(WatchKind k) {
+    switch (k) {
+        case WatchKind::Read:   return "r";
+        case WatchKind::Write:  return "w";
+        case WatchKind::Access: return "rw";
+        case WatchKind::Mesi:   return "mesi";
+    }
+    return "?";
+}
+
+bool parse_watch_kind(const std::string& s, WatchKind& out) {
+    for (WatchKind k : {WatchKind::Read, WatchKind::Write, WatchKind::Access, WatchKind::Mesi})
+        if (s == watch_kind_str(k)) { out = k; return true; }
+    return false;
+}
+
+int Watchpoints::add(WatchKind k, uint64_t lo, uint64_t hi) {
+    if (k == WatchKind::Mesi) {  // Bloques completos
+        lo -= lo % hw::kBlockBytes;
+        hi += (hw::kBlockBytes - hi % hw::kBlockBytes) % hw::kBlockBytes;
+    }
+    wps_.push_back(Watchpoint{next_id_, k, lo, hi});
+    return next_id_++;
+}
+
+bool Watchpoints::remove(int id) {
+    for (auto it = wps_.begin(); it != wps_.end(); ++it)
+        if (it->id == id) { wps_.erase(it); return true; }
+    return false;
+}
+
+void Watchpoints::on_access(bool write, int pe, uint64_t addr, uint32_t bytes, const double* value) {
+    for (const Watchpoint& w : wps_) {
+        if (w.kind == WatchKind::Mesi || addr >= w.hi || addr + bytes <= w.lo) continue;
+        if (w.kind == (write ? WatchKind::Read : WatchKind::Write)) continue;
+        WatchHit h;
+        h.id = w.id;
+        h.what = write ? WatchKind::Write : WatchKind::Read;
+        h.pe = pe;
+        h.addr = addr;
+        h.bytes = bytes;
+        if (value) { h.has_value = true; h.value = *value; }
+        hit(h);
+    }
+}
+
+void Watchpoints::on_transition(int pe, uint64_t block, MESI from, MESI to) {
+    for (const Watchpoint& w : wps_) {
+        if (w.kind != WatchKind::Mesi || block < w.lo || block >= w.hi) continue;
+        WatchHit h;
+        h.id = w.id;
+        h.what = WatchKind::Mesi;
+        h.pe = pe;
+        h.addr = block;
+        h.bytes = hw::kBlockBytes;
+        h.from = from;
+        h.to = to;
+        hit(h);
+    }
+}
+
+void Watchpoints::hit(const WatchHit& h) {
+    std::lock_guard<std::mutex> lk(m_);
+    if (hits_.size() < kMaxHits) hits_.push_back(h);
+    else dropped_++;
+    triggered_.store(true, std::memory_order_relaxed);
+}
+
+std::vector<WatchHit> Watchpoints::take_hits(uint64_t* dropped) {
+    std::lock_guard<std::mutex> lk(m_);
+    std::vector<WatchHit> out;
+    out.swap(hits_);
+    if (dropped) *dropped = dropped_;
+    dropped_ = 0;
+    triggered_.store(false, std::memory_order_relaxed);
+    return out;
+}
+
+void print_watchpoint(std::ostream& os, const Watchpoint& w) {
+    os << "  #" << w.id << " " << watch_kind_str(w.kind) << " [0x" << std::hex << w.lo
+       << ", 0x" << w.hi << ")" << std::dec << " (M[" << w.lo / 8 << ".." << (w.hi - 1) / 8 << "])\n";
+}
+
+void print_watch_hit(std::ostream& os, const WatchHit& h) {
+    std::ostringstream line;
+    line << "watch #" << h.id << ": " << (h.pe < 0 ? std::string("memoria") : "PE" + std::to_string(h.pe)) << " ";
+    if (h.what == WatchKind::Mesi) {
+        line << "bloque 0x" << std::hex << h.addr << std::dec << " " << mesi_str(h.from) << " -> " << mesi_str(h.to);
+    } else {
+        line << (h.what == WatchKind::Write ? "escribe" : "lee") << " 0x" << std::hex << h.addr << std::dec
+             << " (M[" << h.addr / 8 << "], " << h.bytes << " bytes)";
+        if (h.has_value) line << " = " << h.value;
+    }
+    os << line.str() << "\n";
+}
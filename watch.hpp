@@ -0,0 +1,71 @@
+// watch.hpp
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class MESI : uint8_t;  // cache.hpp
+
+// WATCHPOINTS - los disparan ganchos dentro de Cache (load_from_line,
+// store_into_line, record_transition y expulsiones) y de
+// SharedMemory::process_request. Sin watchpoints los componentes tienen el
+// puntero en nullptr: el costo es un if por gancho
+//   read/write/rw  lectura y/o escritura de algun byte de [lo, hi): en una L1
+//                  (accesos de los PEs) o en la memoria principal (llenados y
+//                  write-backs)
+//   mesi           transicion MESI en cualquier L1 de un bloque de [lo, hi)
+enum class WatchKind : uint8_t { Read, Write, Access, Mesi };
+const char* watch_kind_str(WatchKind k);
+bool parse_watch_kind(const std::string& s, WatchKind& out);  // "r", "w", "rw", "mesi"
+
+struct Watchpoint {
+    int id = 0;
+    WatchKind kind = WatchKind::Access;
+    uint64_t lo = 0, hi = 0;  // Bytes [lo, hi)
+};
+
+struct WatchHit {
+    int id = 0;               // Watchpoint que disparo
+    WatchKind what = WatchKind::Read;  // Read, Write o Mesi
+    int pe = -1;              // L1 que lo vio (-1: memoria principal)
+    uint64_t addr = 0;        // Direccion accedida (base del bloque en Mesi)
+    uint32_t bytes = 0;
+    bool has_value = false;   // Accesos de 8 bytes en una L1
+    double value = 0.0;
+    MESI from{}, to{};        // Solo Mesi
+};
+
+class Watchpoints {
+public:
+    static constexpr size_t kMaxHits = 64;  // Los demas solo se cuentan
+
+    // Altas y bajas: solo con los PEs detenidos (los ganchos leen la lista sin candado)
+    int add(WatchKind k, uint64_t lo, uint64_t hi);  // Devuelve el id
+    bool remove(int id);
+    bool empty() const { return wps_.empty(); }
+    const std::vector<Watchpoint>& list() const { return wps_; }
+
+    // Ganchos (hilo de cualquier PE, snoops o worker de memoria)
+    void on_access(bool write, int pe, uint64_t addr, uint32_t bytes, const double* value = nullptr);
+    void on_transition(int pe, uint64_t block, MESI from, MESI to);
+
+    bool triggered() const { return triggered_.load(std::memory_order_relaxed); }
+    // Disparos desde la llamada anterior; rearma triggered()
+    std::vector<WatchHit> take_hits(uint64_t* dropped = nullptr);
+
+private:
+    void hit(const WatchHit& h);
+
+    std::vector<Watchpoint> wps_;
+    int next_id_ = 1;
+    std::mutex m_;  // Protege hits_ y dropped_
+    std::vector<WatchHit> hits_;
+    uint64_t dropped_ = 0;
+    std::atomic<bool> triggered_{false};
+};
+
+void print_watchpoint(std::ostream& os, const Watchpoint& w);
+void print_watch_hit(std::ostream& os, const WatchHit& h);